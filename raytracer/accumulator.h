@@ -0,0 +1,402 @@
+/* ******************************* ACCUMULATOR ****************************** */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Accumulator
+// DESCRIPTION :    Online mergeable statistics of series
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           accumulator.h
+/// \brief          Online mergeable statistics of series
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef ACCUMULATOR_H_INCLUDED
+#define ACCUMULATOR_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <type_traits>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+// Include libs
+#include <mpi.h>
+// Include project
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Online mergeable statistics of series
+/// \brief          Online mergeable statistics of series.
+/// \details        Accumulates the mean and the variance of series sampled
+///                 on a common grid, one series at a time, without storing
+///                 them. Each point of the grid is updated with the Welford
+///                 algorithm, and two accumulators are merged with the Chan
+///                 formulas, so that partial statistics computed
+///                 independently by several threads and several processes
+///                 can be combined exactly. The memory footprint only
+///                 depends on the size of the grid.
+/// \tparam         Type Data type.
+template <typename Type = double>
+class Accumulator final
+{
+    // Lifecycle
+    /// \name           Lifecycle
+    //@{
+    public:
+        explicit inline Accumulator(const unsigned int length = 0);
+    //@}
+
+    // Data
+    /// \name           Data
+    //@{
+    public:
+        inline unsigned int size() const;
+        inline unsigned long long int count() const;
+        inline Type mean(const unsigned int i) const;
+        inline Type variance(const unsigned int i) const;
+        inline Type deviation(const unsigned int i) const;
+        inline std::vector<Type> mean() const;
+        inline std::vector<Type> deviation() const;
+    //@}
+
+    // Operations
+    /// \name           Operations
+    //@{
+    public:
+        inline Accumulator<Type>& assign(const unsigned int length);
+        template <class Container> inline Accumulator<Type>& add(const Container& values);
+        inline Accumulator<Type>& merge(const Accumulator<Type>& other);
+        inline bool reduce(MPI_Comm communicator = MPI_COMM_WORLD);
+    //@}
+
+    // Reduction
+    /// \name           Reduction
+    //@{
+    protected:
+        static void combine(void* input, void* inoutput, int* length, MPI_Datatype* datatype);
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+
+    // Data members
+    /// \name           Data members
+    //@{
+    protected:
+        unsigned long long int _count;                                          ///< Number of accumulated series.
+        std::vector<Type> _mean;                                                ///< Running mean at each point.
+        std::vector<Type> _m2;                                                  ///< Running sum of squared deviations at each point.
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- LIFECYCLE -------------------------------- //
+// Explicit constructor
+/// \brief          Explicit constructor.
+/// \details        Constructs an empty accumulator for series of the given
+///                 length.
+/// \param[in]      length Number of points of the series.
+template <typename Type>
+inline Accumulator<Type>::Accumulator(const unsigned int length)
+: _count(0)
+, _mean(length, Type())
+, _m2(length, Type())
+{
+    ;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- DATA ---------------------------------- //
+// Size
+/// \brief          Size.
+/// \details        Returns the number of points of the series.
+/// \return         Length of the series.
+template <typename Type>
+inline unsigned int Accumulator<Type>::size() const
+{
+    return _mean.size();
+}
+
+// Count
+/// \brief          Count.
+/// \details        Returns the number of accumulated series.
+/// \return         Number of series.
+template <typename Type>
+inline unsigned long long int Accumulator<Type>::count() const
+{
+    return _count;
+}
+
+// Mean at a point
+/// \brief          Mean at a point.
+/// \details        Returns the mean of the accumulated series at the given
+///                 point.
+/// \param[in]      i Index of the point.
+/// \return         Mean value.
+template <typename Type>
+inline Type Accumulator<Type>::mean(const unsigned int i) const
+{
+    return _mean[i];
+}
+
+// Variance at a point
+/// \brief          Variance at a point.
+/// \details        Returns the unbiased sample variance of the accumulated
+///                 series at the given point.
+/// \param[in]      i Index of the point.
+/// \return         Variance, or zero if less than two series have been
+///                 accumulated.
+template <typename Type>
+inline Type Accumulator<Type>::variance(const unsigned int i) const
+{
+    return (_count > 1) ? (_m2[i]/Type(_count-1)) : (Type());
+}
+
+// Standard deviation at a point
+/// \brief          Standard deviation at a point.
+/// \details        Returns the sample standard deviation of the accumulated
+///                 series at the given point.
+/// \param[in]      i Index of the point.
+/// \return         Standard deviation.
+template <typename Type>
+inline Type Accumulator<Type>::deviation(const unsigned int i) const
+{
+    return std::sqrt(variance(i));
+}
+
+// Mean series
+/// \brief          Mean series.
+/// \details        Returns the mean of the accumulated series at each point.
+/// \return         Mean values.
+template <typename Type>
+inline std::vector<Type> Accumulator<Type>::mean() const
+{
+    return _mean;
+}
+
+// Standard deviation series
+/// \brief          Standard deviation series.
+/// \details        Returns the sample standard deviation of the accumulated
+///                 series at each point.
+/// \return         Standard deviations.
+template <typename Type>
+inline std::vector<Type> Accumulator<Type>::deviation() const
+{
+    std::vector<Type> result(_mean.size());
+    for (unsigned int i = 0; i < result.size(); ++i) {
+        result[i] = deviation(i);
+    }
+    return result;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- OPERATIONS ------------------------------- //
+// Assign
+/// \brief          Assign.
+/// \details        Resets the accumulator for series of the given length.
+/// \param[in]      length Number of points of the series.
+/// \return         Self reference.
+template <typename Type>
+inline Accumulator<Type>& Accumulator<Type>::assign(const unsigned int length)
+{
+    _count = 0;
+    _mean.assign(length, Type());
+    _m2.assign(length, Type());
+    return *this;
+}
+
+// Add a series
+/// \brief          Add a series.
+/// \details        Updates the statistics of each point with the values of
+///                 a new series sampled on the grid of the accumulator.
+/// \tparam         Container Container type.
+/// \param[in]      values Values of the series at each point.
+/// \return         Self reference.
+template <typename Type>
+template <class Container>
+inline Accumulator<Type>& Accumulator<Type>::add(const Container& values)
+{
+    const unsigned int length = std::min(static_cast<unsigned int>(_mean.size()), static_cast<unsigned int>(values.size()));
+    const Type n = Type(++_count);
+    Type delta = Type();
+    for (unsigned int i = 0; i < length; ++i) {
+        delta = values[i]-_mean[i];
+        _mean[i] += delta/n;
+        _m2[i] += delta*(values[i]-_mean[i]);
+    }
+    return *this;
+}
+
+// Merge
+/// \brief          Merge.
+/// \details        Combines the statistics of another accumulator on the
+///                 same grid, as if its series had been added to this one.
+/// \param[in]      other Other accumulator.
+/// \return         Self reference.
+template <typename Type>
+inline Accumulator<Type>& Accumulator<Type>::merge(const Accumulator<Type>& other)
+{
+    const unsigned int length = std::min(_mean.size(), other._mean.size());
+    const unsigned long long int total = _count+other._count;
+    const Type weight = (total > 0) ? (Type(other._count)/Type(total)) : (Type());
+    const Type factor = Type(_count)*weight;
+    Type delta = Type();
+    for (unsigned int i = 0; (other._count > 0) && (i < length); ++i) {
+        delta = other._mean[i]-_mean[i];
+        _mean[i] += delta*weight;
+        _m2[i] += other._m2[i]+delta*delta*factor;
+    }
+    _count = total;
+    return *this;
+}
+
+// Reduce
+/// \brief          Reduce.
+/// \details        Merges the accumulators of all the processes of the
+///                 communicator with a single collective reduction, after
+///                 which every process holds the global statistics. All the
+///                 accumulators should have the same size.
+/// \param[in]      communicator MPI communicator.
+/// \return         True on success, false on error.
+template <typename Type>
+inline bool Accumulator<Type>::reduce(MPI_Comm communicator)
+{
+    const unsigned int length = _mean.size();
+    std::vector<double> input(1+length+length);
+    std::vector<double> output(input.size());
+    MPI_Datatype datatype;
+    MPI_Op op;
+    bool ok = false;
+    input[0] = _count;
+    std::copy(_mean.begin(), _mean.end(), input.begin()+1);
+    std::copy(_m2.begin(), _m2.end(), input.begin()+1+length);
+    MPI_Type_contiguous(input.size(), MPI_DOUBLE, &datatype);
+    MPI_Type_commit(&datatype);
+    MPI_Op_create(&Accumulator<Type>::combine, 1, &op);
+    ok = (MPI_Allreduce(input.data(), output.data(), 1, datatype, op, communicator) == MPI_SUCCESS);
+    MPI_Op_free(&op);
+    MPI_Type_free(&datatype);
+    if (ok) {
+        _count = output[0];
+        std::copy(output.begin()+1, output.begin()+1+length, _mean.begin());
+        std::copy(output.begin()+1+length, output.end(), _m2.begin());
+    }
+    return ok;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// -------------------------------- REDUCTION ------------------------------- //
+// Combine
+/// \brief          Combine.
+/// \details        MPI reduction operator applying the Chan formulas to
+///                 packed accumulators made of the count followed by the
+///                 means and the sums of squared deviations.
+/// \param[in]      input Packed accumulators to be merged.
+/// \param[in,out]  inoutput Packed accumulators receiving the merge.
+/// \param[in]      length Number of packed accumulators.
+/// \param[in]      datatype Datatype of a packed accumulator.
+template <typename Type>
+void Accumulator<Type>::combine(void* input, void* inoutput, int* length, MPI_Datatype* datatype)
+{
+    int bytes = 0;
+    MPI_Type_size(*datatype, &bytes);
+    const unsigned int size = bytes/sizeof(double);
+    const unsigned int npoints = (size-1)/2;
+    const double* source = static_cast<const double*>(input);
+    double* destination = static_cast<double*>(inoutput);
+    double total = 0;
+    double weight = 0;
+    double factor = 0;
+    double delta = 0;
+    for (int iblock = 0; iblock < *length; ++iblock, source += size, destination += size) {
+        total = destination[0]+source[0];
+        weight = (total > 0) ? (source[0]/total) : (0);
+        factor = destination[0]*weight;
+        for (unsigned int i = 1; (source[0] > 0) && (i <= npoints); ++i) {
+            delta = source[i]-destination[i];
+            destination[i] += delta*weight;
+            destination[i+npoints] += source[i+npoints]+delta*delta*factor;
+        }
+        destination[0] = total;
+    }
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Accumulator. MPI should
+///                 have been initialized.
+/// \return         0 if no error.
+template <typename Type>
+int Accumulator<Type>::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Accumulator::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    const std::vector<Type> first({Type(4), Type(8)});
+    const std::vector<Type> second({Type(15), Type(16)});
+    const std::vector<Type> third({Type(23), Type(42)});
+
+    // Construction
+    Accumulator<Type> accumulator(2);
+    Accumulator<Type> other(2);
+
+    // Lifecycle
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Lifecycle : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"Accumulator<>().size() : "                                                          <<Accumulator<>().size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"Accumulator<>(42).size() : "                                                        <<Accumulator<>(42).size()<<std::endl;
+
+    // Operations
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Operations : "                                                                      <<std::endl;
+    std::cout<<std::setw(width*2)<<"accumulator.add(first).count() : "                                                  <<accumulator.add(first).count()<<std::endl;
+    std::cout<<std::setw(width*2)<<"accumulator.add(second).count() : "                                                 <<accumulator.add(second).count()<<std::endl;
+    std::cout<<std::setw(width*2)<<"other.add(third).count() : "                                                        <<other.add(third).count()<<std::endl;
+    std::cout<<std::setw(width*2)<<"accumulator.merge(other).count() : "                                                <<accumulator.merge(other).count()<<std::endl;
+    std::cout<<std::setw(width*2)<<"accumulator.mean(1) : "                                                             <<accumulator.mean(1)<<std::endl;
+    std::cout<<std::setw(width*2)<<"accumulator.variance(1) : "                                                         <<accumulator.variance(1)<<std::endl;
+    std::cout<<std::setw(width*2)<<"accumulator.deviation().size() : "                                                  <<accumulator.deviation().size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"accumulator.reduce() : "                                                            <<accumulator.reduce()<<std::endl;
+    std::cout<<std::setw(width*2)<<"accumulator.mean(1) : "                                                             <<accumulator.mean(1)<<std::endl;
+    std::cout<<std::setw(width*2)<<"accumulator.assign(3).count() : "                                                   <<accumulator.assign(3).count()<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Accumulator::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // ACCUMULATOR_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
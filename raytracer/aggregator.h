@@ -0,0 +1,482 @@
+/* ******************************* AGGREGATOR ******************************* */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Aggregator
+// DESCRIPTION :    Aggregation of the output of all ranks into shared files
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           aggregator.h
+/// \brief          Aggregation of the output of all ranks into shared files
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef AGGREGATOR_H_INCLUDED
+#define AGGREGATOR_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+#include <mutex>
+#include <limits>
+#include <string>
+#include <vector>
+#include <array>
+#include <tuple>
+#include <utility>
+// Include libs
+#include <mpi.h>
+// Include project
+#include "../magrathea/filesystem.h"
+#include "../magrathea/datahandler.h"
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Aggregation of the output of all ranks into shared files
+/// \brief          Aggregation of the output of all ranks into shared files.
+/// \details        Collects named records, typically the content of the
+///                 trajectory files of a configuration, and writes the
+///                 records of all ranks into a single shared file through
+///                 collective MPI-IO, instead of creating one small file per
+///                 record. Each rank writes its records at an offset
+///                 computed with a prefix sum over the ranks. The file
+///                 starts with a header, followed by the records and an
+///                 index giving the name, the offset and the size of each
+///                 record, so that every record stays addressable. Records
+///                 can be pushed concurrently by several threads.
+class Aggregator final
+{
+    // Lifecycle
+    /// \name           Lifecycle
+    //@{
+    public:
+        inline Aggregator();
+        Aggregator(const Aggregator&) = delete;
+        Aggregator& operator=(const Aggregator&) = delete;
+    //@}
+
+    // Data
+    /// \name           Data
+    //@{
+    public:
+        inline unsigned long long int size();
+        inline unsigned long long int bytes();
+    //@}
+
+    // Operations
+    /// \name           Operations
+    //@{
+    public:
+        inline bool push(const std::string& name, std::string&& content, const bool append = false);
+        inline void clear();
+        inline bool write(const std::string& filename, MPI_Comm communicator = MPI_COMM_WORLD);
+    //@}
+
+    // Index
+    /// \name           Index
+    //@{
+    public:
+        static inline std::vector<std::tuple<std::string, unsigned long long int, unsigned long long int> > index(std::istream& stream);
+        static inline bool extract(std::istream& stream, const std::string& name, std::string& content);
+    //@}
+
+    // Constants
+    /// \name           Constants
+    //@{
+    public:
+        static inline const std::string& magic();
+        static constexpr unsigned int version();
+        static constexpr unsigned long long int header();
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+
+    // Data members
+    /// \name           Data members
+    //@{
+    protected:
+        std::vector<std::pair<std::string, std::string> > _records;             ///< Records : name and content.
+        std::mutex _mutex;                                                      ///< Mutex protecting the records.
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- LIFECYCLE -------------------------------- //
+// Implicit empty constructor
+/// \brief          Implicit empty constructor.
+/// \details        Constructs an aggregator without any record.
+inline Aggregator::Aggregator()
+: _records()
+, _mutex()
+{
+    ;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- DATA ---------------------------------- //
+// Size
+/// \brief          Size.
+/// \details        Returns the number of local records.
+/// \return         Number of records.
+inline unsigned long long int Aggregator::size()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _records.size();
+}
+
+// Bytes
+/// \brief          Bytes.
+/// \details        Returns the total size of the local records.
+/// \return         Number of bytes.
+inline unsigned long long int Aggregator::bytes()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    unsigned long long int result = 0;
+    for (auto it = _records.begin(); it != _records.end(); ++it) {
+        result += it->second.size();
+    }
+    return result;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- OPERATIONS ------------------------------- //
+// Push
+/// \brief          Push.
+/// \details        Adds a record, with the same interface as an asynchronous
+///                 writer so that both can be used as output sinks.
+/// \param[in]      name Name of the record.
+/// \param[in]      content Content of the record, moved into the aggregator.
+/// \param[in]      append Appends to the last record of the same name if
+///                 true and if such a record exists.
+/// \return         True.
+inline bool Aggregator::push(const std::string& name, std::string&& content, const bool append)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _records.rbegin();
+    if (append) {
+        it = std::find_if(_records.rbegin(), _records.rend(), [&name](const std::pair<std::string, std::string>& record){return record.first == name;});
+    }
+    if ((append) && (it != _records.rend())) {
+        it->second += content;
+    } else {
+        _records.emplace_back(name, std::move(content));
+    }
+    return true;
+}
+
+// Clear
+/// \brief          Clear.
+/// \details        Removes all local records.
+inline void Aggregator::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _records.clear();
+    _records.shrink_to_fit();
+}
+
+// Write
+/// \brief          Write.
+/// \details        Collectively writes the records of all the ranks of the
+///                 communicator into a shared file, and clears them. Records
+///                 are sorted by name on each rank and stored by increasing
+///                 rank. The records of a rank are described by an indexed
+///                 datatype, so that they are written in a single collective
+///                 call without being copied into a contiguous buffer. This
+///                 function should be called by all the ranks of the
+///                 communicator, even the ones without any record. The
+///                 ranks agree on the opening of the file before any
+///                 collective access, so that they all give up together
+///                 if it failed on one of them.
+/// \param[in]      filename File name.
+/// \param[in]      communicator Communicator.
+/// \return         True on success on all ranks, false otherwise.
+inline bool Aggregator::write(const std::string& filename, MPI_Comm communicator)
+{
+    // Initialization
+    static const unsigned long long int limit = std::numeric_limits<int>::max();
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::ostringstream stream;
+    std::string head;
+    std::string table;
+    std::vector<int> lengths(_records.size());
+    std::vector<MPI_Aint> addresses(_records.size());
+    std::array<unsigned long long int, 3> local = std::array<unsigned long long int, 3>();
+    std::array<unsigned long long int, 3> before = std::array<unsigned long long int, 3>();
+    std::array<unsigned long long int, 3> total = std::array<unsigned long long int, 3>();
+    unsigned long long int offset = 0;
+    MPI_Datatype datatype = MPI_DATATYPE_NULL;
+    MPI_File file = MPI_FILE_NULL;
+    MPI_Status status;
+    int rank = 0;
+    int error = MPI_SUCCESS;
+    int opened = 0;
+    int ok = 1;
+
+    // Compute offsets
+    MPI_Comm_rank(communicator, &rank);
+    std::sort(_records.begin(), _records.end(), [](const std::pair<std::string, std::string>& first, const std::pair<std::string, std::string>& second){return first.first < second.first;});
+    local[0] = _records.size();
+    for (auto it = _records.begin(); it != _records.end(); ++it) {
+        ok = (ok) && (it->second.size() <= limit);
+        local[1] += it->second.size();
+    }
+    MPI_Exscan(local.data(), before.data(), 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, communicator);
+    MPI_Allreduce(local.data(), total.data(), 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, communicator);
+    before[0] = (rank > 0) ? (before[0]) : (0);
+    before[1] = (rank > 0) ? (before[1]) : (0);
+
+    // Build the index
+    offset = header()+before[1];
+    for (auto it = _records.begin(); it != _records.end(); ++it) {
+        magrathea::DataHandler::write(stream, static_cast<unsigned int>(it->first.size()));
+        stream.write(it->first.data(), it->first.size());
+        magrathea::DataHandler::write(stream, offset, static_cast<unsigned long long int>(it->second.size()));
+        offset += it->second.size();
+    }
+    table = stream.str();
+    local[2] = table.size();
+    ok = (ok) && (table.size() <= limit);
+    MPI_Exscan(&local[2], &before[2], 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, communicator);
+    MPI_Allreduce(&local[2], &total[2], 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, communicator);
+    before[2] = (rank > 0) ? (before[2]) : (0);
+
+    // Describe the records
+    for (unsigned int irecord = 0; irecord < _records.size(); ++irecord) {
+        lengths[irecord] = (ok) ? (_records[irecord].second.size()) : (0);
+        MPI_Get_address(const_cast<char*>(_records[irecord].second.data()), &addresses[irecord]);
+    }
+    MPI_Type_create_hindexed(lengths.size(), lengths.data(), addresses.data(), MPI_BYTE, &datatype);
+    MPI_Type_commit(&datatype);
+
+    // Write the header
+    stream.str(std::string());
+    if (rank == 0) {
+        stream.write(magic().data(), magic().size());
+        magrathea::DataHandler::write(stream, magrathea::FileSystem::bom<unsigned int>(), version(), total[0], header()+total[1], total[2]);
+    }
+    head = stream.str();
+    error = MPI_File_open(communicator, const_cast<char*>(filename.c_str()), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+    opened = (error == MPI_SUCCESS);
+    MPI_Allreduce(MPI_IN_PLACE, &opened, 1, MPI_INT, MPI_LAND, communicator);
+    if (opened) {
+        error = MPI_File_set_size(file, 0);
+        ok = (ok) && (error == MPI_SUCCESS);
+        error = MPI_File_write_at_all(file, 0, const_cast<char*>(head.data()), head.size(), MPI_BYTE, &status);
+        ok = (ok) && (error == MPI_SUCCESS);
+
+        // Write the records and the index
+        error = MPI_File_write_at_all(file, header()+before[1], MPI_BOTTOM, 1, datatype, &status);
+        ok = (ok) && (error == MPI_SUCCESS);
+        error = MPI_File_write_at_all(file, header()+total[1]+before[2], const_cast<char*>(table.data()), (ok) ? (table.size()) : (0), MPI_BYTE, &status);
+        ok = (ok) && (error == MPI_SUCCESS);
+        error = MPI_File_close(&file);
+        ok = (ok) && (error == MPI_SUCCESS);
+    } else {
+        if (error == MPI_SUCCESS) {
+            MPI_File_close(&file);
+        }
+        ok = 0;
+    }
+    MPI_Type_free(&datatype);
+
+    // Finalization
+    _records.clear();
+    _records.shrink_to_fit();
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, communicator);
+    return ok;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- INDEX --------------------------------- //
+// Index
+/// \brief          Index.
+/// \details        Reads the index of an aggregated file.
+/// \param[in,out]  stream Input binary stream.
+/// \return         List of records : name, offset from the beginning of the
+///                 file and size, empty if the file is not valid.
+inline std::vector<std::tuple<std::string, unsigned long long int, unsigned long long int> > Aggregator::index(std::istream& stream)
+{
+    std::vector<std::tuple<std::string, unsigned long long int, unsigned long long int> > result;
+    std::string mark(magic().size(), char());
+    std::array<unsigned int, 2> types = std::array<unsigned int, 2>();
+    std::array<unsigned long long int, 3> sizes = std::array<unsigned long long int, 3>();
+    unsigned int length = 0;
+    bool ok = false;
+    stream.seekg(0, std::ios::beg);
+    stream.read(&mark[0], mark.size());
+    magrathea::DataHandler::read(stream, types);
+    magrathea::DataHandler::read(stream, sizes);
+    ok = (stream.good()) && (mark == magic()) && (types[0] == magrathea::FileSystem::bom<unsigned int>()) && (types[1] == version());
+    if (ok) {
+        stream.seekg(sizes[1], std::ios::beg);
+        result.resize(sizes[0]);
+        for (unsigned long long int irecord = 0; (ok) && (irecord < sizes[0]); ++irecord) {
+            ok = magrathea::DataHandler::read(stream, length) && (length <= sizes[2]);
+            std::get<0>(result[irecord]).resize((ok) ? (length) : (0));
+            if ((ok) && (length > 0)) {
+                stream.read(&std::get<0>(result[irecord])[0], length);
+            }
+            ok = (ok) && (magrathea::DataHandler::read(stream, std::get<1>(result[irecord]), std::get<2>(result[irecord])));
+        }
+        if (!ok) {
+            result.clear();
+        }
+    }
+    return result;
+}
+
+// Extract
+/// \brief          Extract.
+/// \details        Reads a single record of an aggregated file.
+/// \param[in,out]  stream Input binary stream.
+/// \param[in]      name Name of the record.
+/// \param[out]     content Content of the record.
+/// \return         True if the record has been found and read, false
+///                 otherwise.
+inline bool Aggregator::extract(std::istream& stream, const std::string& name, std::string& content)
+{
+    const std::vector<std::tuple<std::string, unsigned long long int, unsigned long long int> > table = index(stream);
+    auto it = std::find_if(table.begin(), table.end(), [&name](const std::tuple<std::string, unsigned long long int, unsigned long long int>& record){return std::get<0>(record) == name;});
+    bool ok = (it != table.end());
+    content.clear();
+    if (ok) {
+        content.resize(std::get<2>(*it));
+        stream.clear();
+        stream.seekg(std::get<1>(*it), std::ios::beg);
+        if (!content.empty()) {
+            stream.read(&content[0], content.size());
+        }
+        ok = stream.good();
+    }
+    return ok;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// -------------------------------- CONSTANTS ------------------------------- //
+// Magic
+/// \brief          Magic.
+/// \details        Returns the signature of aggregated files.
+/// \return         Signature.
+inline const std::string& Aggregator::magic()
+{
+    static const std::string signature = "MAGAGGR1";
+    return signature;
+}
+
+// Version
+/// \brief          Version.
+/// \details        Returns the version of the format of aggregated files.
+/// \return         Format version.
+constexpr unsigned int Aggregator::version()
+{
+    return 1;
+}
+
+// Header
+/// \brief          Header.
+/// \details        Returns the size of the header of aggregated files : the
+///                 signature, the byte order mark, the version, the number
+///                 of records, the offset of the index and its size.
+/// \return         Size of the header in bytes.
+constexpr unsigned long long int Aggregator::header()
+{
+    return 8+sizeof(unsigned int)*2+sizeof(unsigned long long int)*3;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Aggregator. MPI should
+///                 have been initialized.
+/// \return         0 if no error.
+int Aggregator::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Aggregator::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    const std::string filename = "aggregator_example.bin";
+    std::ifstream stream;
+    std::string content;
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // Construction
+    Aggregator aggregator;
+
+    // Operations
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Operations : "                                                                      <<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.push(\"b\", \"second\") : "                                              <<aggregator.push("b_"+std::to_string(rank), std::string("second"))<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.push(\"a\", \"first\") : "                                               <<aggregator.push("a_"+std::to_string(rank), std::string("first"))<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.push(\"a\", \" line\", true) : "                                         <<aggregator.push("a_"+std::to_string(rank), std::string(" line"), true)<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.size() : "                                                               <<aggregator.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.bytes() : "                                                              <<aggregator.bytes()<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.write(filename) : "                                                      <<aggregator.write(filename)<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.write(\"/nonexistent/file\") : "                                         <<aggregator.write("/nonexistent/file")<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.size() : "                                                               <<aggregator.size()<<std::endl;
+
+    // Index
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Index : "                                                                           <<std::endl;
+    stream.open(filename, std::ios::binary);
+    std::cout<<std::setw(width*2)<<"aggregator.index(stream).size() : "                                                 <<aggregator.index(stream).size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.extract(stream, \"a\", content) : "                                      <<aggregator.extract(stream, "a_"+std::to_string(rank), content)<<std::endl;
+    std::cout<<std::setw(width*2)<<"content : "                                                                         <<content<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.extract(stream, \"c\", content) : "                                      <<aggregator.extract(stream, "c", content)<<std::endl;
+    stream.close();
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0) {
+        std::remove(filename.c_str());
+    }
+
+    // Constants
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Constants : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.magic() : "                                                              <<aggregator.magic()<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.version() : "                                                            <<aggregator.version()<<std::endl;
+    std::cout<<std::setw(width*2)<<"aggregator.header() : "                                                             <<aggregator.header()<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Aggregator::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // AGGREGATOR_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
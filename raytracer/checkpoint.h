@@ -0,0 +1,518 @@
+/* ******************************* CHECKPOINT ******************************* */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Checkpoint
+// DESCRIPTION :    Checkpoint and restart of propagation runs
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           checkpoint.h
+/// \brief          Checkpoint and restart of propagation runs
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <array>
+#include <random>
+// Include libs
+// Include project
+#include "../magrathea/datahandler.h"
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Checkpoint and restart of propagation runs
+/// \brief          Checkpoint and restart of propagation runs.
+/// \details        Keeps track of the progress of a propagation run: the
+///                 index of the current configuration, the trajectories
+///                 already completed for this configuration with their
+///                 results, and the state of the random engine used to
+///                 launch the photons. It is saved in a versioned binary
+///                 format written through a temporary file, so that an
+///                 interrupted run can skip completed work on restart.
+/// \tparam         Type Data type of the results.
+template <typename Type = double>
+class Checkpoint final
+{
+    // Lifecycle
+    /// \name           Lifecycle
+    //@{
+    public:
+        explicit inline Checkpoint(const unsigned int nconfigurations = 0, const unsigned int ntrajectories = 0);
+    //@}
+
+    // Data
+    /// \name           Data
+    //@{
+    public:
+        inline unsigned int position() const;
+        inline unsigned int configurations() const;
+        inline unsigned int trajectories() const;
+        inline unsigned int count() const;
+        inline bool completed(const unsigned int itrajectory) const;
+        inline const std::array<std::vector<Type>, 2>& result(const unsigned int itrajectory) const;
+    //@}
+
+    // Progress
+    /// \name           Progress
+    //@{
+    public:
+        inline Checkpoint<Type>& advance(const unsigned int iconfiguration);
+        inline Checkpoint<Type>& complete(const unsigned int itrajectory);
+        template <class Container, class = typename std::enable_if<std::is_convertible<typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Container>()[0])>::type>::type, Type>::value>::type> inline Checkpoint<Type>& complete(const unsigned int itrajectory, const Container& x, const Container& y);
+        template <class Engine> inline Checkpoint<Type>& store(const Engine& engine);
+        template <class Engine> inline bool restore(Engine& engine) const;
+    //@}
+
+    // Files
+    /// \name           Files
+    //@{
+    public:
+        inline bool due(const double interval) const;
+        bool save(const std::string& filename);
+        bool load(const std::string& filename);
+    //@}
+
+    // Format
+    /// \name           Format
+    //@{
+    public:
+        static constexpr unsigned long long int magic();
+        static constexpr unsigned int version();
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+
+    // Data members
+    /// \name           Data members
+    //@{
+    protected:
+        unsigned int _position;                                                 ///< Index of the current configuration.
+        unsigned int _nconfigurations;                                          ///< Total number of configurations.
+        unsigned int _ntrajectories;                                            ///< Number of trajectories per configuration.
+        std::string _engine;                                                    ///< Serialized state of the random engine.
+        std::vector<unsigned char> _completed;                                  ///< Completion flags of the trajectories.
+        std::vector<std::array<std::vector<Type>, 2> > _results;                ///< Results of the completed trajectories.
+        std::chrono::steady_clock::time_point _time;                            ///< Time of the last save.
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- LIFECYCLE -------------------------------- //
+// Explicit constructor
+/// \brief          Explicit constructor.
+/// \details        Constructs a checkpoint at the first configuration with
+///                 no completed trajectory.
+/// \param[in]      nconfigurations Total number of configurations.
+/// \param[in]      ntrajectories Number of trajectories per configuration.
+template <typename Type>
+inline Checkpoint<Type>::Checkpoint(const unsigned int nconfigurations, const unsigned int ntrajectories)
+: _position(0)
+, _nconfigurations(nconfigurations)
+, _ntrajectories(ntrajectories)
+, _engine()
+, _completed(ntrajectories)
+, _results(ntrajectories)
+, _time(std::chrono::steady_clock::now())
+{
+    ;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- DATA ---------------------------------- //
+// Position
+/// \brief          Position.
+/// \details        Returns the index of the current configuration: all the
+///                 previous ones are completed.
+/// \return         Configuration index.
+template <typename Type>
+inline unsigned int Checkpoint<Type>::position() const
+{
+    return _position;
+}
+
+// Number of configurations
+/// \brief          Number of configurations.
+/// \details        Returns the total number of configurations of the run.
+/// \return         Number of configurations.
+template <typename Type>
+inline unsigned int Checkpoint<Type>::configurations() const
+{
+    return _nconfigurations;
+}
+
+// Number of trajectories
+/// \brief          Number of trajectories.
+/// \details        Returns the number of trajectories per configuration.
+/// \return         Number of trajectories.
+template <typename Type>
+inline unsigned int Checkpoint<Type>::trajectories() const
+{
+    return _ntrajectories;
+}
+
+// Count of completed trajectories
+/// \brief          Count of completed trajectories.
+/// \details        Counts the completed trajectories of the current
+///                 configuration.
+/// \return         Number of completed trajectories.
+template <typename Type>
+inline unsigned int Checkpoint<Type>::count() const
+{
+    return std::count(_completed.begin(), _completed.end(), static_cast<unsigned char>(1));
+}
+
+// Completion status
+/// \brief          Completion status.
+/// \details        Checks whether a trajectory of the current configuration
+///                 is completed.
+/// \param[in]      itrajectory Trajectory index.
+/// \return         True if completed, false otherwise.
+template <typename Type>
+inline bool Checkpoint<Type>::completed(const unsigned int itrajectory) const
+{
+    return (itrajectory < _completed.size()) && (_completed[itrajectory] != 0);
+}
+
+// Result
+/// \brief          Result.
+/// \details        Returns the abscissae and ordinates recorded for a
+///                 completed trajectory of the current configuration.
+/// \param[in]      itrajectory Trajectory index.
+/// \return         Immutable reference to the result.
+template <typename Type>
+inline const std::array<std::vector<Type>, 2>& Checkpoint<Type>::result(const unsigned int itrajectory) const
+{
+    return _results[itrajectory];
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// -------------------------------- PROGRESS -------------------------------- //
+// Advance
+/// \brief          Advance.
+/// \details        Moves to the provided configuration and forgets the
+///                 trajectories completed for the previous one.
+/// \param[in]      iconfiguration Configuration index.
+/// \return         Self reference.
+template <typename Type>
+inline Checkpoint<Type>& Checkpoint<Type>::advance(const unsigned int iconfiguration)
+{
+    _position = iconfiguration;
+    std::fill(_completed.begin(), _completed.end(), static_cast<unsigned char>(0));
+    std::for_each(_results.begin(), _results.end(), [](std::array<std::vector<Type>, 2>& r){std::get<0>(r).clear(); std::get<1>(r).clear();});
+    return *this;
+}
+
+// Complete
+/// \brief          Complete.
+/// \details        Marks a trajectory of the current configuration as
+///                 completed without any result.
+/// \param[in]      itrajectory Trajectory index.
+/// \return         Self reference.
+template <typename Type>
+inline Checkpoint<Type>& Checkpoint<Type>::complete(const unsigned int itrajectory)
+{
+    if (itrajectory < _completed.size()) {
+        _completed[itrajectory] = 1;
+    }
+    return *this;
+}
+
+// Complete with results
+/// \brief          Complete with results.
+/// \details        Marks a trajectory of the current configuration as
+///                 completed and records its results.
+/// \tparam         Container Container type.
+/// \param[in]      itrajectory Trajectory index.
+/// \param[in]      x Abscissae.
+/// \param[in]      y Ordinates.
+/// \return         Self reference.
+template <typename Type>
+template <class Container, class>
+inline Checkpoint<Type>& Checkpoint<Type>::complete(const unsigned int itrajectory, const Container& x, const Container& y)
+{
+    if (itrajectory < _completed.size()) {
+        _completed[itrajectory] = 1;
+        std::get<0>(_results[itrajectory]).assign(std::begin(x), std::end(x));
+        std::get<1>(_results[itrajectory]).assign(std::begin(y), std::end(y));
+    }
+    return *this;
+}
+
+// Store engine
+/// \brief          Store engine.
+/// \details        Stores the state of a random engine.
+/// \tparam         Engine Random engine type.
+/// \param[in]      engine Random engine.
+/// \return         Self reference.
+template <typename Type>
+template <class Engine>
+inline Checkpoint<Type>& Checkpoint<Type>::store(const Engine& engine)
+{
+    std::ostringstream stream;
+    stream<<engine;
+    _engine = stream.str();
+    return *this;
+}
+
+// Restore engine
+/// \brief          Restore engine.
+/// \details        Restores the state of a random engine if one has been
+///                 stored.
+/// \tparam         Engine Random engine type.
+/// \param[in,out]  engine Random engine.
+/// \return         True on success, false otherwise.
+template <typename Type>
+template <class Engine>
+inline bool Checkpoint<Type>::restore(Engine& engine) const
+{
+    std::istringstream stream(_engine);
+    Engine temporary;
+    bool ok = !_engine.empty();
+    if (ok) {
+        stream>>temporary;
+        ok = !stream.fail();
+        if (ok) {
+            engine = temporary;
+        }
+    }
+    return ok;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- FILES --------------------------------- //
+// Due
+/// \brief          Due.
+/// \details        Checks whether a new save is due.
+/// \param[in]      interval Minimal time between two saves in seconds.
+/// \return         True if the last save is older than the interval.
+template <typename Type>
+inline bool Checkpoint<Type>::due(const double interval) const
+{
+    return !(std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::steady_clock::now()-_time).count() < interval);
+}
+
+// Save
+/// \brief          Save.
+/// \details        Writes the checkpoint to a temporary file which then
+///                 replaces the destination, so that a run killed during the
+///                 write keeps its previous checkpoint.
+/// \param[in]      filename File name.
+/// \return         True on success, false otherwise.
+template <typename Type>
+bool Checkpoint<Type>::save(const std::string& filename)
+{
+    static const std::string extension = ".tmp";
+    const std::string temporary = filename+extension;
+    const unsigned int size = sizeof(Type);
+    std::ofstream stream(temporary, std::ios::binary);
+    bool ok = static_cast<bool>(stream);
+    if (ok) {
+        ok = magrathea::DataHandler::write(stream, magic(), version(), size, _nconfigurations, _ntrajectories, _position, static_cast<unsigned long long int>(_engine.size()));
+        ok = ok && magrathea::DataHandler::rwrite(stream, _engine.data(), _engine.data()+_engine.size());
+        ok = ok && magrathea::DataHandler::rwrite(stream, _completed.data(), _completed.data()+_completed.size());
+        for (unsigned int i = 0; (i < _ntrajectories) && (ok); ++i) {
+            ok = magrathea::DataHandler::write(stream, static_cast<unsigned long long int>(std::get<0>(_results[i]).size()), static_cast<unsigned long long int>(std::get<1>(_results[i]).size()));
+            ok = ok && magrathea::DataHandler::rwrite(stream, std::get<0>(_results[i]).data(), std::get<0>(_results[i]).data()+std::get<0>(_results[i]).size());
+            ok = ok && magrathea::DataHandler::rwrite(stream, std::get<1>(_results[i]).data(), std::get<1>(_results[i]).data()+std::get<1>(_results[i]).size());
+        }
+        ok = ok && magrathea::DataHandler::write(stream, magic());
+        stream.close();
+        ok = ok && (!stream.fail()) && (std::rename(temporary.c_str(), filename.c_str()) == 0);
+    }
+    if (ok) {
+        _time = std::chrono::steady_clock::now();
+    }
+    return ok;
+}
+
+// Load
+/// \brief          Load.
+/// \details        Reads a checkpoint file. The current state is only
+///                 replaced if the file is complete and was written with the
+///                 same format, data type, number of configurations and
+///                 number of trajectories.
+/// \param[in]      filename File name.
+/// \return         True on success, false otherwise.
+template <typename Type>
+bool Checkpoint<Type>::load(const std::string& filename)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    unsigned long long int first = 0;
+    unsigned long long int last = 0;
+    unsigned int format = 0;
+    unsigned int size = 0;
+    unsigned int nconfigurations = 0;
+    unsigned int ntrajectories = 0;
+    unsigned int position = 0;
+    unsigned long long int length = 0;
+    std::array<unsigned long long int, 2> lengths = std::array<unsigned long long int, 2>();
+    std::string engine;
+    std::vector<unsigned char> completed(_ntrajectories);
+    std::vector<std::array<std::vector<Type>, 2> > results(_ntrajectories);
+    bool ok = static_cast<bool>(stream);
+    if (ok) {
+        ok = magrathea::DataHandler::read(stream, first, format, size, nconfigurations, ntrajectories, position, length);
+        ok = ok && (first == magic()) && (format == version()) && (size == sizeof(Type)) && (nconfigurations == _nconfigurations) && (ntrajectories == _ntrajectories) && (position <= nconfigurations);
+        if (ok) {
+            engine.resize(length);
+            ok = magrathea::DataHandler::rread(stream, &engine[0], &engine[0]+length);
+            ok = ok && magrathea::DataHandler::rread(stream, completed.data(), completed.data()+completed.size());
+        }
+        for (unsigned int i = 0; (i < ntrajectories) && (ok); ++i) {
+            ok = magrathea::DataHandler::read(stream, lengths);
+            if (ok) {
+                std::get<0>(results[i]).resize(std::get<0>(lengths));
+                std::get<1>(results[i]).resize(std::get<1>(lengths));
+                ok = magrathea::DataHandler::rread(stream, std::get<0>(results[i]).data(), std::get<0>(results[i]).data()+std::get<0>(results[i]).size());
+                ok = ok && magrathea::DataHandler::rread(stream, std::get<1>(results[i]).data(), std::get<1>(results[i]).data()+std::get<1>(results[i]).size());
+            }
+        }
+        ok = ok && magrathea::DataHandler::read(stream, last) && (last == magic());
+        stream.close();
+    }
+    if (ok) {
+        _position = position;
+        _engine = std::move(engine);
+        _completed = std::move(completed);
+        _results = std::move(results);
+        _time = std::chrono::steady_clock::now();
+    }
+    return ok;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// --------------------------------- FORMAT --------------------------------- //
+// Magic number
+/// \brief          Magic number.
+/// \details        Marker written at the beginning and at the end of a
+///                 checkpoint file.
+/// \return         Magic number.
+template <typename Type>
+constexpr unsigned long long int Checkpoint<Type>::magic()
+{
+    return 0x504B484352545952ULL;
+}
+
+// Format version
+/// \brief          Format version.
+/// \details        Version of the checkpoint file format.
+/// \return         Version number.
+template <typename Type>
+constexpr unsigned int Checkpoint<Type>::version()
+{
+    return 1;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Checkpoint.
+/// \return         0 if no error.
+template <typename Type>
+int Checkpoint<Type>::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Checkpoint::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    const std::string filename = std::tmpnam(nullptr);
+    std::mt19937 engine(42);
+    std::vector<double> x({4., 8., 15.});
+    std::vector<double> y({16., 23., 42.});
+
+    // Construction
+    Checkpoint<double> checkpoint(4, 8);
+    Checkpoint<double> other(4, 8);
+
+    // Lifecycle
+    std::cout<<std::endl;
+    std::cout<<std::setw(width)<<"Lifecycle : "                                 <<std::endl;
+    std::cout<<std::setw(width)<<"Checkpoint<>().trajectories() : "             <<Checkpoint<>().trajectories()<<std::endl;
+    std::cout<<std::setw(width)<<"Checkpoint<>(4, 8).trajectories() : "         <<Checkpoint<>(4, 8).trajectories()<<std::endl;
+
+    // Data
+    std::cout<<std::endl;
+    std::cout<<std::setw(width)<<"Data : "                                      <<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.position() : "                     <<checkpoint.position()<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.configurations() : "               <<checkpoint.configurations()<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.trajectories() : "                 <<checkpoint.trajectories()<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.count() : "                        <<checkpoint.count()<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.completed(2) : "                   <<checkpoint.completed(2)<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.result(2)[0].size() : "            <<checkpoint.result(2)[0].size()<<std::endl;
+
+    // Progress
+    std::cout<<std::endl;
+    std::cout<<std::setw(width)<<"Progress : "                                  <<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.advance(1).position() : "          <<checkpoint.advance(1).position()<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.complete(1).count() : "            <<checkpoint.complete(1).count()<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.complete(2, x, y).count() : "      <<checkpoint.complete(2, x, y).count()<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.store(engine).count() : "          <<checkpoint.store(engine).count()<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.restore(engine) : "                <<checkpoint.restore(engine)<<std::endl;
+
+    // Files
+    std::cout<<std::endl;
+    std::cout<<std::setw(width)<<"Files : "                                     <<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.due(42) : "                        <<checkpoint.due(42)<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.save(filename) : "                 <<checkpoint.save(filename)<<std::endl;
+    std::cout<<std::setw(width)<<"other.load(filename) : "                      <<other.load(filename)<<std::endl;
+    std::cout<<std::setw(width)<<"other.result(2)[1][2] : "                     <<other.result(2)[1][2]<<std::endl;
+    std::remove(filename.c_str());
+
+    // Format
+    std::cout<<std::endl;
+    std::cout<<std::setw(width)<<"Format : "                                    <<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.magic() : "                        <<checkpoint.magic()<<std::endl;
+    std::cout<<std::setw(width)<<"checkpoint.version() : "                      <<checkpoint.version()<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Checkpoint::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // CHECKPOINT_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
@@ -0,0 +1,454 @@
+/* ********************************** CODEC ********************************* */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Codec
+// DESCRIPTION :    Lossless compression of octree elements
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           codec.h
+/// \brief          Lossless compression of octree elements
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef CODEC_H_INCLUDED
+#define CODEC_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <type_traits>
+#include <algorithm>
+#include <limits>
+#include <climits>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+// Include libs
+// Include project
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Lossless compression of octree elements
+/// \brief          Lossless compression of octree elements.
+/// \details        Compresses sequences of octree elements without external
+///                 dependency in three stages. Sorted keys are stored as
+///                 variable length differences, the bytes of the data are
+///                 regrouped by position so that the slowly varying bytes
+///                 of floating point fields are contiguous, and the result
+///                 is compressed by a fast dictionary coder that replaces
+///                 repeated sequences by references to previous ones.
+class Codec final
+{
+    // Elements
+    /// \name           Elements
+    //@{
+    public:
+        template <class Element, class Index = typename std::tuple_element<0, Element>::type, class Data = typename std::tuple_element<1, Element>::type, class Integer = decltype(+std::declval<Index>()), class = typename std::enable_if<!std::is_floating_point<Integer>::value>::type> static unsigned long long int encode(const Element* first, const Element* last, std::vector<char>& output);
+        template <class Element, class Index = typename std::tuple_element<0, Element>::type, class Data = typename std::tuple_element<1, Element>::type, class Integer = decltype(+std::declval<Index>()), class = typename std::enable_if<!std::is_floating_point<Integer>::value>::type> static bool decode(const char* first, const char* last, Element* output, const unsigned long long int count);
+        static inline bool count(const char* first, const char* last, unsigned long long int& size);
+    //@}
+
+    // Stages
+    /// \name           Stages
+    //@{
+    public:
+        static inline void shuffle(const char* first, const char* last, const unsigned int stride, char* output);
+        static inline void unshuffle(const char* first, const char* last, const unsigned int stride, char* output);
+        static inline unsigned long long int compress(const char* first, const char* last, std::vector<char>& output);
+        static inline bool decompress(const char* first, const char* last, std::vector<char>& output, const unsigned long long int limit = std::numeric_limits<unsigned long long int>::max());
+    //@}
+
+    // Integers
+    /// \name           Integers
+    //@{
+    public:
+        template <typename Integer, class = typename std::enable_if<!std::is_floating_point<Integer>::value>::type> static inline void put(std::vector<char>& output, Integer value);
+        template <typename Integer, class = typename std::enable_if<!std::is_floating_point<Integer>::value>::type> static inline bool get(const char*& first, const char* last, Integer& value);
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// -------------------------------- ELEMENTS -------------------------------- //
+// Encode elements
+/// \brief          Encode elements.
+/// \details        Appends to the output the compressed representation of
+///                 a range of elements : the number of elements followed by
+///                 the dictionary coded stream of the key differences and
+///                 of the shuffled data bytes.
+/// \tparam         Element Element type.
+/// \tparam         Index Index type.
+/// \tparam         Data Data type.
+/// \tparam         Integer Underlying integer type of the index.
+/// \param[in]      first Pointer to the first element.
+/// \param[in]      last Pointer past the last element.
+/// \param[in,out]  output Output bytes.
+/// \return         Number of appended bytes.
+template <class Element, class Index, class Data, class Integer, class>
+unsigned long long int Codec::encode(const Element* first, const Element* last, std::vector<char>& output)
+{
+    const unsigned long long int count = (first < last) ? (last-first) : (0);
+    const unsigned long long int original = output.size();
+    std::vector<char> data(count*sizeof(Data));
+    std::vector<char> bytes;
+    Integer previous = Integer();
+    bytes.reserve(count*(sizeof(Integer)+sizeof(Data)));
+    for (unsigned long long int i = 0; i < count; ++i) {
+        put(bytes, static_cast<Integer>(static_cast<Integer>(std::get<0>(first[i]))-previous));
+        previous = static_cast<Integer>(std::get<0>(first[i]));
+        std::memcpy(&data[i*sizeof(Data)], &std::get<1>(first[i]), sizeof(Data));
+    }
+    bytes.resize(bytes.size()+data.size());
+    shuffle(data.data(), data.data()+data.size(), sizeof(Data), bytes.data()+bytes.size()-data.size());
+    put(output, count);
+    compress(bytes.data(), bytes.data()+bytes.size(), output);
+    return output.size()-original;
+}
+
+// Decode elements
+/// \brief          Decode elements.
+/// \details        Reconstructs a range of elements from its compressed
+///                 representation. The number of elements and the sizes
+///                 of all stages are checked.
+/// \tparam         Element Element type.
+/// \tparam         Index Index type.
+/// \tparam         Data Data type.
+/// \tparam         Integer Underlying integer type of the index.
+/// \param[in]      first Pointer to the first byte.
+/// \param[in]      last Pointer past the last byte.
+/// \param[out]     output Pointer to the first element to be written.
+/// \param[in]      count Expected number of elements.
+/// \return         True on success, false otherwise.
+template <class Element, class Index, class Data, class Integer, class>
+bool Codec::decode(const char* first, const char* last, Element* output, const unsigned long long int count)
+{
+    unsigned long long int size = 0;
+    std::vector<char> bytes;
+    std::vector<char> data;
+    const char* iterator = nullptr;
+    Integer key = Integer();
+    Integer delta = Integer();
+    bool ok = (get(first, last, size)) && (size == count) && (decompress(first, last, bytes, count*(((sizeof(Integer)*CHAR_BIT+6)/7)+sizeof(Data))));
+    iterator = bytes.data();
+    for (unsigned long long int i = 0; (ok) && (i < count); ++i) {
+        ok = get(iterator, static_cast<const char*>(bytes.data()+bytes.size()), delta);
+        key = static_cast<Integer>(key+delta);
+        std::get<0>(output[i]) = Index(key);
+    }
+    ok = (ok) && (static_cast<unsigned long long int>(bytes.data()+bytes.size()-iterator) == count*sizeof(Data));
+    if (ok) {
+        data.resize(count*sizeof(Data));
+        unshuffle(iterator, iterator+data.size(), sizeof(Data), data.data());
+        for (unsigned long long int i = 0; i < count; ++i) {
+            std::memcpy(reinterpret_cast<char*>(&std::get<1>(output[i])), &data[i*sizeof(Data)], sizeof(Data));
+        }
+    }
+    return ok;
+}
+
+// Count elements
+/// \brief          Count elements.
+/// \details        Reads the number of elements of a compressed range
+///                 without decoding it, so that the destination can be
+///                 checked before any allocation.
+/// \param[in]      first Pointer to the first byte.
+/// \param[in]      last Pointer past the last byte.
+/// \param[out]     size Number of elements.
+/// \return         True on success, false otherwise.
+inline bool Codec::count(const char* first, const char* last, unsigned long long int& size)
+{
+    size = 0;
+    return get(first, last, size);
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// --------------------------------- STAGES --------------------------------- //
+// Shuffle bytes
+/// \brief          Shuffle bytes.
+/// \details        Regroups the bytes of a sequence of values of the same
+///                 size by position : all the first bytes, then all the
+///                 second bytes, and so on.
+/// \param[in]      first Pointer to the first byte.
+/// \param[in]      last Pointer past the last byte.
+/// \param[in]      stride Size of each value in bytes.
+/// \param[out]     output Pointer to the first shuffled byte.
+inline void Codec::shuffle(const char* first, const char* last, const unsigned int stride, char* output)
+{
+    const unsigned long long int count = (stride > 0) ? ((last-first)/stride) : (0);
+    for (unsigned int ibyte = 0; ibyte < stride; ++ibyte) {
+        for (unsigned long long int i = 0; i < count; ++i) {
+            output[ibyte*count+i] = first[i*stride+ibyte];
+        }
+    }
+}
+
+// Unshuffle bytes
+/// \brief          Unshuffle bytes.
+/// \details        Restores the original order of bytes regrouped by
+///                 position.
+/// \param[in]      first Pointer to the first shuffled byte.
+/// \param[in]      last Pointer past the last shuffled byte.
+/// \param[in]      stride Size of each value in bytes.
+/// \param[out]     output Pointer to the first restored byte.
+inline void Codec::unshuffle(const char* first, const char* last, const unsigned int stride, char* output)
+{
+    const unsigned long long int count = (stride > 0) ? ((last-first)/stride) : (0);
+    for (unsigned int ibyte = 0; ibyte < stride; ++ibyte) {
+        for (unsigned long long int i = 0; i < count; ++i) {
+            output[i*stride+ibyte] = first[ibyte*count+i];
+        }
+    }
+}
+
+// Dictionary compression
+/// \brief          Dictionary compression.
+/// \details        Appends to the output the original size followed by a
+///                 sequence of literal runs and of references to previous
+///                 occurrences. Candidates are found through a hash table
+///                 of four byte sequences and the search accelerates over
+///                 incompressible regions. A null reference length ends
+///                 the sequence.
+/// \param[in]      first Pointer to the first byte.
+/// \param[in]      last Pointer past the last byte.
+/// \param[in,out]  output Output bytes.
+/// \return         Number of appended bytes.
+inline unsigned long long int Codec::compress(const char* first, const char* last, std::vector<char>& output)
+{
+    static const unsigned int minimum = sizeof(std::uint32_t);
+    static const unsigned int bits = 16;
+    const unsigned long long int original = output.size();
+    const unsigned long long int size = (first < last) ? (last-first) : (0);
+    std::vector<unsigned long long int> table(1U << bits, 0);
+    unsigned long long int anchor = 0;
+    unsigned long long int i = 0;
+    unsigned long long int candidate = 0;
+    unsigned long long int length = 0;
+    std::uint32_t word = 0;
+    std::uint32_t other = 0;
+    unsigned int hash = 0;
+    output.reserve(output.size()+size/2);
+    put(output, size);
+    while (i+minimum <= size) {
+        std::memcpy(&word, first+i, minimum);
+        hash = static_cast<std::uint32_t>(word*2654435761U) >> (32-bits);
+        candidate = table[hash];
+        table[hash] = i+1;
+        if (candidate > 0) {
+            std::memcpy(&other, first+candidate-1, minimum);
+        }
+        if ((candidate > 0) && (other == word)) {
+            length = minimum;
+            while ((i+length < size) && (first[candidate-1+length] == first[i+length])) {
+                ++length;
+            }
+            put(output, i-anchor);
+            output.insert(output.end(), first+anchor, first+i);
+            put(output, length-minimum+1);
+            put(output, i-candidate+1);
+            i += length;
+            anchor = i;
+        } else {
+            i += 1+((i-anchor) >> 6);
+        }
+    }
+    put(output, size-anchor);
+    output.insert(output.end(), first+anchor, first+size);
+    put(output, 0);
+    return output.size()-original;
+}
+
+// Dictionary decompression
+/// \brief          Dictionary decompression.
+/// \details        Appends to the output the bytes of a dictionary
+///                 compressed sequence. All lengths and references are
+///                 checked against the input and the original size, and
+///                 the original size is checked against the provided limit
+///                 before any allocation, so that a corrupted size is
+///                 rejected instead of exhausting the memory.
+/// \param[in]      first Pointer to the first compressed byte.
+/// \param[in]      last Pointer past the last compressed byte.
+/// \param[in,out]  output Output bytes.
+/// \param[in]      limit Maximum number of decompressed bytes.
+/// \return         True on success, false otherwise.
+inline bool Codec::decompress(const char* first, const char* last, std::vector<char>& output, const unsigned long long int limit)
+{
+    static const unsigned int minimum = sizeof(std::uint32_t);
+    const unsigned long long int original = output.size();
+    unsigned long long int size = 0;
+    unsigned long long int literals = 0;
+    unsigned long long int length = 1;
+    unsigned long long int offset = 0;
+    unsigned long long int position = 0;
+    bool ok = (get(first, last, size)) && (size <= limit);
+    if (ok) {
+        output.resize(original+size);
+    }
+    while ((ok) && (length > 0)) {
+        ok = (get(first, last, literals)) && (literals <= static_cast<unsigned long long int>(last-first)) && (position+literals <= size);
+        if (ok) {
+            std::memcpy(output.data()+original+position, first, literals);
+            first += literals;
+            position += literals;
+            ok = get(first, last, length);
+        }
+        if ((ok) && (length > 0)) {
+            length += minimum-1;
+            ok = (get(first, last, offset)) && (offset > 0) && (offset <= position) && (position+length <= size);
+            if ((ok) && (offset >= length)) {
+                std::memcpy(output.data()+original+position, output.data()+original+position-offset, length);
+            } else if (ok) {
+                for (unsigned long long int i = 0; i < length; ++i) {
+                    output[original+position+i] = output[original+position+i-offset];
+                }
+            }
+            position += length;
+        }
+    }
+    ok = (ok) && (position == size) && (first == last);
+    if (!ok) {
+        output.resize(original);
+    }
+    return ok;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// -------------------------------- INTEGERS -------------------------------- //
+// Put an integer
+/// \brief          Put an integer.
+/// \details        Appends an unsigned integer to the output using a
+///                 variable number of bytes, seven bits at a time, with the
+///                 high bit marking continuation.
+/// \tparam         Integer Integer type.
+/// \param[in,out]  output Output bytes.
+/// \param[in]      value Value.
+template <typename Integer, class>
+inline void Codec::put(std::vector<char>& output, Integer value)
+{
+    while (value >= Integer(0x80)) {
+        output.push_back(static_cast<char>(static_cast<unsigned char>(value & Integer(0x7F)) | 0x80));
+        value >>= 7;
+    }
+    output.push_back(static_cast<char>(static_cast<unsigned char>(value)));
+}
+
+// Get an integer
+/// \brief          Get an integer.
+/// \details        Reads an unsigned integer stored with a variable number
+///                 of bytes and advances the input pointer.
+/// \tparam         Integer Integer type.
+/// \param[in,out]  first Pointer to the first byte.
+/// \param[in]      last Pointer past the last byte.
+/// \param[out]     value Value.
+/// \return         True on success, false if the input is truncated or the
+///                 value overflows.
+template <typename Integer, class>
+inline bool Codec::get(const char*& first, const char* last, Integer& value)
+{
+    unsigned int shift = 0;
+    unsigned char byte = 0x80;
+    value = Integer();
+    while ((first < last) && (byte & 0x80) && (shift < sizeof(Integer)*8)) {
+        byte = static_cast<unsigned char>(*first++);
+        value |= static_cast<Integer>(Integer(byte & 0x7F) << shift);
+        shift += 7;
+    }
+    return !(byte & 0x80);
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Codec.
+/// \return         0 if no error.
+int Codec::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Codec::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    std::vector<std::pair<unsigned long long int, float> > elements(1000);
+    std::vector<std::pair<unsigned long long int, float> > decoded(elements.size());
+    std::vector<char> bytes;
+    std::vector<char> shuffled(8);
+    std::vector<char> output;
+    std::string text = "abcdabcdabcdabcdabcdabcd";
+    const char* pointer = nullptr;
+    unsigned long long int value = 0;
+    for (unsigned int i = 0; i < elements.size(); ++i) {
+        elements[i] = std::make_pair(42ULL+i*i, 1.f+i/1000.f);
+    }
+
+    // Construction
+    Codec codec;
+
+    // Lifecycle
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Lifecycle : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"Codec() : "                                                                         ; Codec(); std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"codec = Codec() : "                                                                 ; codec = Codec(); std::cout<<std::endl;
+
+    // Integers
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Integers : "                                                                        <<std::endl;
+    std::cout<<std::setw(width*2)<<"codec.put(bytes, 300ULL) : "                                                        ; codec.put(bytes, 300ULL); std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"bytes.size() : "                                                                    <<bytes.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"codec.get(pointer, bytes.data()+bytes.size(), value) : "                            <<codec.get(pointer = bytes.data(), bytes.data()+bytes.size(), value)<<std::endl;
+    std::cout<<std::setw(width*2)<<"value : "                                                                           <<value<<std::endl;
+
+    // Stages
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Stages : "                                                                          <<std::endl;
+    std::cout<<std::setw(width*2)<<"codec.shuffle(text.data(), text.data()+8, 4, shuffled.data()) : "                   ; codec.shuffle(text.data(), text.data()+8, 4, shuffled.data()); std::cout<<std::string(shuffled.begin(), shuffled.end())<<std::endl;
+    std::cout<<std::setw(width*2)<<"codec.compress(text.data(), text.data()+text.size(), bytes) : "                     <<codec.compress(text.data(), text.data()+text.size(), bytes = std::vector<char>())<<std::endl;
+    std::cout<<std::setw(width*2)<<"codec.decompress(bytes.data(), bytes.data()+bytes.size(), output) : "               <<codec.decompress(bytes.data(), bytes.data()+bytes.size(), output)<<std::endl;
+    std::cout<<std::setw(width*2)<<"codec.decompress(bytes.data(), bytes.data()+bytes.size(), output, 1) : "            <<codec.decompress(bytes.data(), bytes.data()+bytes.size(), output, 1)<<std::endl;
+    std::cout<<std::setw(width*2)<<"std::string(output.begin(), output.end()) == text : "                              <<(std::string(output.begin(), output.end()) == text)<<std::endl;
+
+    // Elements
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Elements : "                                                                        <<std::endl;
+    std::cout<<std::setw(width*2)<<"codec.encode(elements.data(), elements.data()+1000, bytes) : "                      <<codec.encode(elements.data(), elements.data()+elements.size(), bytes = std::vector<char>())<<std::endl;
+    std::cout<<std::setw(width*2)<<"codec.decode(bytes.data(), bytes.data()+bytes.size(), decoded.data(), 1000) : "     <<codec.decode(bytes.data(), bytes.data()+bytes.size(), decoded.data(), decoded.size())<<std::endl;
+    std::cout<<std::setw(width*2)<<"codec.count(bytes.data(), bytes.data()+bytes.size(), value) : "                     <<codec.count(bytes.data(), bytes.data()+bytes.size(), value)<<std::endl;
+    std::cout<<std::setw(width*2)<<"value : "                                                                           <<value<<std::endl;
+    std::cout<<std::setw(width*2)<<"decoded == elements : "                                                             <<(decoded == elements)<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Codec::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // CODEC_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
@@ -0,0 +1,392 @@
+/* ******************************** EXPANSION ******************************* */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Expansion
+// DESCRIPTION :    Tabulated cosmological expansion
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           expansion.h
+/// \brief          Tabulated cosmological expansion
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef EXPANSION_H_INCLUDED
+#define EXPANSION_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <type_traits>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <array>
+#include <tuple>
+#include <cmath>
+#include <ratio>
+// Include libs
+// Include project
+#include "utility.h"
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Tabulated cosmological expansion
+/// \brief          Tabulated cosmological expansion.
+/// \details        Container of t, a(t), its first and second derivatives
+///                 sampled on a uniform grid of t, so that lookups reduce to
+///                 index arithmetic followed by a linear or cubic blending.
+///                 It can be used everywhere a cosmology array is expected.
+/// \tparam         Type Data type.
+template <typename Type = double>
+class Expansion final
+: public std::array<std::vector<Type>, 4>
+{
+    // Lifecycle
+    /// \name           Lifecycle
+    //@{
+    public:
+        inline Expansion();
+        inline Expansion(const std::array<std::vector<Type>, 4>& source, const unsigned int size = 0);
+    //@}
+
+    // Tabulation
+    /// \name           Tabulation
+    //@{
+    public:
+        Expansion<Type>& tabulate(const unsigned int size = 0);
+        inline bool tabulated() const;
+        inline Type origin() const;
+        inline Type step() const;
+        Type deviation(const std::array<std::vector<Type>, 4>& source) const;
+    //@}
+
+    // Lookup
+    /// \name           Lookup
+    //@{
+    public:
+        template <unsigned int Column, bool Cubic = false, class = typename std::enable_if<(Column > 0) && (Column+Cubic < 4)>::type> inline Type interpolate(const Type t) const;
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+
+    // Data members
+    /// \name           Data members
+    //@{
+    protected:
+        Type _origin;                                                           ///< First abscissa of the grid.
+        Type _inverse;                                                          ///< Inverse of the grid step or zero if not tabulated.
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- LIFECYCLE -------------------------------- //
+// Implicit empty constructor
+/// \brief          Implicit empty constructor.
+/// \details        Constructs an empty and untabulated expansion.
+template <typename Type>
+inline Expansion<Type>::Expansion()
+: std::array<std::vector<Type>, 4>()
+, _origin(Type())
+, _inverse(Type())
+{
+    ;
+}
+
+// Implicit conversion constructor
+/// \brief          Implicit conversion constructor.
+/// \details        Copies a cosmology array and tabulates it.
+/// \param[in]      source Source cosmology with t, a, dadt and d2adt2.
+/// \param[in]      size Number of points of the grid or zero to size it
+///                 from the source.
+template <typename Type>
+inline Expansion<Type>::Expansion(const std::array<std::vector<Type>, 4>& source, const unsigned int size)
+: std::array<std::vector<Type>, 4>(source)
+, _origin(Type())
+, _inverse(Type())
+{
+    tabulate(size);
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- TABULATION ------------------------------- //
+// Tabulation
+/// \brief          Tabulation.
+/// \details        Resamples the cosmology on a uniform grid of t between
+///                 its first and last abscissae. The a and dadt columns are
+///                 resampled with a cubic spline using their derivatives
+///                 and the d2adt2 column is resampled linearly. If the
+///                 abscissae are already uniform and the size is unchanged,
+///                 only the grid parameters are updated. Without a given
+///                 size, the grid starts with the smallest spacing of the
+///                 abscissae, and its number of intervals is doubled until
+///                 the lookups reproduce the original table with a relative
+///                 deviation below one millionth, or until it reaches
+///                 about one million points.
+/// \param[in]      size Number of points of the grid or zero to size it
+///                 from the current contents.
+/// \return         Self reference.
+template <typename Type>
+Expansion<Type>& Expansion<Type>::tabulate(const unsigned int size)
+{
+    // Initialization
+    static const Type zero = Type();
+    static const Type one = Type(1);
+    static const Type tolerance = std::sqrt(std::numeric_limits<Type>::epsilon());
+    static const Type accuracy = one/Type(std::mega::num);
+    static const unsigned int limit = (1U << 20)+1;
+    std::vector<Type>& t = std::get<0>(*this);
+    const unsigned int n = std::min(std::min(std::get<0>(*this).size(), std::get<1>(*this).size()), std::min(std::get<2>(*this).size(), std::get<3>(*this).size()));
+    const Type first = (n > 0) ? (t.front()) : (zero);
+    const Type last = (n > 0) ? (t[n-1]) : (zero);
+    Type spacing = last-first;
+    unsigned int m = (size > 1) ? (size) : (n);
+    Type h = zero;
+    std::array<std::vector<Type>, 4> source;
+    std::array<std::vector<Type>, 4> table;
+    bool uniform = false;
+    bool done = false;
+
+    // Size the grid
+    if ((size <= 1) && (n > 1) && (last > first)) {
+        for (unsigned int i = 1; i < n; ++i) {
+            spacing = (t[i] > t[i-1]) ? (std::min(spacing, t[i]-t[i-1])) : (spacing);
+        }
+        m = std::max(n, static_cast<unsigned int>(std::min(Type(limit-1), std::ceil((last-first)/spacing-tolerance))+one));
+    }
+    h = (m > 1) ? ((last-first)/Type(m-1)) : (zero);
+    uniform = (m == n) && (n == t.size());
+
+    // Tabulate
+    _origin = first;
+    _inverse = zero;
+    if ((n > 1) && (h > zero)) {
+        for (unsigned int i = 0; (i < n) && (uniform); ++i) {
+            uniform = !(std::abs(t[i]-(first+Type(i)*h)) > tolerance*h);
+        }
+        if (!uniform) {
+            source = static_cast<const std::array<std::vector<Type>, 4>&>(*this);
+            for (done = false; !done; m = std::min(m+m-1, limit)) {
+                h = (last-first)/Type(m-1);
+                Utility::parallelize(table.begin(), table.end(), [=](std::vector<Type>& v){v.resize(m);});
+                Utility::parallelize(m, [=, &table](const unsigned int i){std::get<0>(table)[i] = (i+1 < m) ? (first+Type(i)*h) : (last);});
+                Utility::parallelize(m, [=, &table, &source](const unsigned int i){std::get<1>(table)[i] = Utility::interpolate(std::get<0>(table)[i], std::get<0>(source), std::get<1>(source), std::get<2>(source)); std::get<2>(table)[i] = Utility::interpolate(std::get<0>(table)[i], std::get<0>(source), std::get<2>(source), std::get<3>(source)); std::get<3>(table)[i] = Utility::interpolate(std::get<0>(table)[i], std::get<0>(source), std::get<3>(source));});
+                static_cast<std::array<std::vector<Type>, 4>&>(*this) = table;
+                _inverse = one/h;
+                done = (size > 1) || (m >= limit) || (!(deviation(source) > accuracy));
+            }
+        }
+        _inverse = one/((last-first)/Type(std::get<0>(*this).size()-1));
+    }
+    return *this;
+}
+
+// Tabulation status
+/// \brief          Tabulation status.
+/// \details        Checks whether the grid parameters are valid for the
+///                 current contents.
+/// \return         True if lookups can use index arithmetic.
+template <typename Type>
+inline bool Expansion<Type>::tabulated() const
+{
+    return (_inverse > Type()) && (std::get<0>(*this).size() > 1) && (std::get<1>(*this).size() == std::get<0>(*this).size()) && (std::get<2>(*this).size() == std::get<0>(*this).size()) && (std::get<3>(*this).size() == std::get<0>(*this).size());
+}
+
+// Grid origin
+/// \brief          Grid origin.
+/// \details        Returns the first abscissa of the grid.
+/// \return         Copy of the origin.
+template <typename Type>
+inline Type Expansion<Type>::origin() const
+{
+    return _origin;
+}
+
+// Grid step
+/// \brief          Grid step.
+/// \details        Returns the step of the uniform grid.
+/// \return         Step or zero if not tabulated.
+template <typename Type>
+inline Type Expansion<Type>::step() const
+{
+    return (_inverse > Type()) ? (Type(1)/_inverse) : (Type());
+}
+
+// Deviation from a table
+/// \brief          Deviation from a table.
+/// \details        Computes the largest deviation of the lookups from the
+///                 values of a cosmology table at its own abscissae,
+///                 relative to the largest magnitude of each column. The
+///                 columns are interpolated as in the integration : a and
+///                 d2adt2 linearly, and dadt with a cubic spline.
+/// \param[in]      source Source cosmology with t, a, dadt and d2adt2.
+/// \return         Largest relative deviation over all columns.
+template <typename Type>
+Type Expansion<Type>::deviation(const std::array<std::vector<Type>, 4>& source) const
+{
+    static const Type zero = Type();
+    const unsigned int n = std::min(std::min(std::get<0>(source).size(), std::get<1>(source).size()), std::min(std::get<2>(source).size(), std::get<3>(source).size()));
+    std::array<Type, 3> scale = std::array<Type, 3>();
+    std::array<Type, 3> error = std::array<Type, 3>();
+    Type result = zero;
+    for (unsigned int i = 0; i < n; ++i) {
+        scale[0] = std::max(scale[0], std::abs(std::get<1>(source)[i]));
+        scale[1] = std::max(scale[1], std::abs(std::get<2>(source)[i]));
+        scale[2] = std::max(scale[2], std::abs(std::get<3>(source)[i]));
+        error[0] = std::max(error[0], std::abs(interpolate<1>(std::get<0>(source)[i])-std::get<1>(source)[i]));
+        error[1] = std::max(error[1], std::abs(interpolate<2, true>(std::get<0>(source)[i])-std::get<2>(source)[i]));
+        error[2] = std::max(error[2], std::abs(interpolate<3>(std::get<0>(source)[i])-std::get<3>(source)[i]));
+    }
+    for (unsigned int icolumn = 0; icolumn < error.size(); ++icolumn) {
+        result = std::max(result, (scale[icolumn] > zero) ? (error[icolumn]/scale[icolumn]) : (error[icolumn]));
+    }
+    return result;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// --------------------------------- LOOKUP --------------------------------- //
+// Interpolation
+/// \brief          Interpolation.
+/// \details        Interpolates the value of a column at the given time. On
+///                 a tabulated expansion the segment is found by index
+///                 arithmetic, otherwise it falls back on a binary search.
+///                 Values outside the grid are extrapolated with the
+///                 polynomial of the nearest end segment, linear or cubic.
+///                 The cubic spline is only accurate if the next column
+///                 is the derivative of the interpolated one.
+/// \tparam         Column Index of the interpolated column.
+/// \tparam         Cubic Uses a cubic spline with the next column as
+///                 derivative if true.
+/// \param[in]      t Time.
+/// \return         Interpolated value.
+template <typename Type>
+template <unsigned int Column, bool Cubic, class>
+inline Type Expansion<Type>::interpolate(const Type t) const
+{
+    static const Type zero = Type();
+    static const Type one = Type(1);
+    const long long int n = std::get<0>(*this).size();
+    const std::vector<Type>& y = std::get<Column>(*this);
+    const std::vector<Type>& dydt = std::get<Column+Cubic>(*this);
+    Type u = zero;
+    long long int i = 0;
+    if (!tabulated()) {
+        return (Cubic) ? (Utility::interpolate(t, std::get<0>(*this), y, dydt)) : (Utility::interpolate(t, std::get<0>(*this), y));
+    }
+    u = (t-_origin)*_inverse;
+    i = (u > zero) ? ((u < Type(n-2)) ? (static_cast<long long int>(u)) : (n-2)) : (0);
+    u -= Type(i);
+    return (Cubic) ? ((one-u)*y[i]+u*y[i+1]+u*(one-u)*((dydt[i]/_inverse-(y[i+1]-y[i]))*(one-u)+(-dydt[i+1]/_inverse+(y[i+1]-y[i]))*u)) : (y[i]+(y[i+1]-y[i])*u);
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Expansion.
+/// \return         0 if no error.
+template <typename Type>
+int Expansion<Type>::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Expansion::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    std::array<std::vector<double>, 4> cosmology;
+    for (unsigned int i = 0; i < 42; ++i) {
+        std::get<0>(cosmology).push_back(i*i);
+        std::get<1>(cosmology).push_back(1./(1.+i*i));
+        std::get<2>(cosmology).push_back(-1./((1.+i*i)*(1.+i*i)));
+        std::get<3>(cosmology).push_back(2./((1.+i*i)*(1.+i*i)*(1.+i*i)));
+    }
+
+    // Construction
+    Expansion<double> expansion(cosmology);
+
+    // Lifecycle
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Lifecycle : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"Expansion<>().size() : "                                                            <<Expansion<>().size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"Expansion<double>(cosmology)[0].size() : "                                          <<Expansion<double>(cosmology)[0].size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"Expansion<double>(cosmology, 100)[0].size() : "                                     <<Expansion<double>(cosmology, 100)[0].size()<<std::endl;
+
+    // Tabulation
+    std::cout<<std::endl;
+    std::cout<<std::setw(width)<<"Tabulation : "                                <<std::endl;
+    std::cout<<std::setw(width)<<"expansion.tabulated() : "                     <<expansion.tabulated()<<std::endl;
+    std::cout<<std::setw(width)<<"expansion.origin() : "                        <<expansion.origin()<<std::endl;
+    std::cout<<std::setw(width)<<"expansion.step() : "                          <<expansion.step()<<std::endl;
+    std::cout<<std::setw(width)<<"expansion[0].size() : "                       <<expansion[0].size()<<std::endl;
+    std::cout<<std::setw(width)<<"expansion.deviation(cosmology) : "            <<expansion.deviation(cosmology)<<std::endl;
+    std::cout<<std::setw(width)<<"expansion.tabulate(420)[0].size() : "         <<expansion.tabulate(420)[0].size()<<std::endl;
+    std::cout<<std::setw(width)<<"expansion.step() : "                          <<expansion.step()<<std::endl;
+
+    // Lookup
+    std::cout<<std::endl;
+    std::cout<<std::setw(width)<<"Lookup : "                                    <<std::endl;
+    std::cout<<std::setw(width)<<"expansion.interpolate<1>(42.) : "             <<expansion.interpolate<1>(42.)<<std::endl;
+    std::cout<<std::setw(width)<<"expansion.interpolate<1, true>(42.) : "       <<expansion.interpolate<1, true>(42.)<<std::endl;
+    std::cout<<std::setw(width)<<"expansion.interpolate<2>(42.) : "             <<expansion.interpolate<2>(42.)<<std::endl;
+    std::cout<<std::setw(width)<<"expansion.interpolate<3>(42.) : "             <<expansion.interpolate<3>(42.)<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Expansion::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------ SPECIALIZATION ---------------------------- //
+namespace std {
+// Tuple size
+/// \brief          Tuple size.
+/// \details        Number of columns of an expansion.
+/// \tparam         Type Data type.
+template <typename Type>
+struct tuple_size<Expansion<Type> >
+: public tuple_size<array<vector<Type>, 4> >
+{
+};
+
+// Tuple element
+/// \brief          Tuple element.
+/// \details        Type of the columns of an expansion.
+/// \tparam         Index Column index.
+/// \tparam         Type Data type.
+template <size_t Index, typename Type>
+struct tuple_element<Index, Expansion<Type> >
+: public tuple_element<Index, array<vector<Type>, 4> >
+{
+};
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // EXPANSION_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
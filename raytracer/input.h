@@ -38,6 +38,7 @@
 #include <cctype>
 #include <mutex>
 #include <atomic>
+#include <memory>
 // Include libs
 // Include project
 #include "../magrathea/simplehyperoctree.h"
@@ -49,9 +50,13 @@
 #include "../magrathea/hypercube.h"
 #include "../magrathea/hypersphere.h"
 #include "cone.h"
+#include "queue.h"
+#include "mapping.h"
+#include "codec.h"
 #include "utility.h"
 #include "gravity.h"
 #include "photon.h"
+#include "expansion.h"
 // Misc
 // -------------------------------------------------------------------------- //
 
@@ -70,10 +75,15 @@ class Input final
     public:
         static inline std::string trim(const std::string& text, const std::string& comment = "#");
         static inline std::pair<std::string, std::string> partition(const std::string& text, const std::string& separator = "=");
+        static inline unsigned long long int checksum(const char* first, const char* last, const unsigned long long int seed = 14695981039346656037ULL);
         template <class Octree, class Source, class Data = typename std::tuple_element<1, decltype(Octree::element())>::type, class Element = decltype(Source::element()), class = typename std::enable_if<(Octree::dimension() == Source::dimension()) && (std::is_integral<Data>::value)>::type> static inline unsigned int count(Octree& octree, const Source& source);
         template <class Octree, class Sphere, class Conic, typename Type = decltype(Octree::type()), class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class Position = decltype(Octree::position()), class Extent = decltype(Octree::extent()), class = typename std::enable_if<(Dimension == 3) && (Dimension == Sphere::dimension())>::type> static inline bool collide(const Octree& octree, const Index& index, const Sphere& sphere, const Conic& conic);
+        template <class Octree, class Iterator, class Sphere, class Conic, class Output, typename Type = decltype(Octree::type()), class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class Position = decltype(Octree::position()), class Extent = decltype(Octree::extent()), class = typename std::enable_if<(Dimension == 3) && (Dimension == Sphere::dimension()) && (std::is_convertible<decltype(*std::declval<Iterator>()), Index>::value)>::type> static inline unsigned long long int collide(const Octree& octree, Iterator first, Iterator last, const Sphere& sphere, const Conic& conic, Output result);
+        template <class Octree, class Sphere, class Conic, typename Type = decltype(Octree::type()), class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class Position = decltype(Octree::position()), class Extent = decltype(Octree::extent()), class = typename std::enable_if<(Dimension == 3) && (Dimension == Sphere::dimension())>::type> static inline int classify(const Octree& octree, const Index& index, const Sphere& sphere, const Conic& conic);
         template <unsigned int Selection = 0, class Octree, unsigned int Dimension = Octree::dimension(), class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, class Data = typename std::tuple_element<1, Element>::type, class Type = decltype(Data::template type<Selection>()), class = typename std::enable_if<(Dimension == 3)>::type> static inline Type mean(const Octree& octree, const Element& element, int level = -1);
         template <typename Type, class Cosmology = std::array<std::vector<double>, 4>, class = typename std::enable_if<std::is_convertible<Type, typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Cosmology>()[0][0])>::type>::type>::value>::type> static inline Cosmology constantify(const unsigned int size, const Type tmin, const Type tmax, const Type a = Type(1), const Type dadt = Type(), const Type d2adt2 = Type());
+        template <class Cosmology, class = typename std::enable_if<std::tuple_size<Cosmology>::value != 0>::type> static inline Cosmology& tabulate(Cosmology& cosmology, const unsigned int size = 0);
+        template <typename Type> static inline Expansion<Type>& tabulate(Expansion<Type>& cosmology, const unsigned int size = 0);
         template <class Data, typename Type, class = typename std::enable_if<Data::types() != 0>::type> static inline Data sistemize(const Data& data, const Type a, const Type h, const Type omegam, const Type lboxmpch, const Type mpc = Type(std::mega::num*magrathea::Constants<Type>::pc()), const Type rhoch2 = Type(3)/Type(8*magrathea::Constants<Type>::pi()*magrathea::Constants<Type>::g()*magrathea::Constants<Type>::pc()*magrathea::Constants<Type>::pc()*std::hecto::num));
         template <class Octree, typename Type, class Element = decltype(Octree::element()), class Data = typename std::tuple_element<1, Element>::type, class = typename std::enable_if<(!std::is_void<Data>::value) && (Octree::dimension() != 0)>::type> static inline unsigned int sistemize(Octree& octree, const Type h, const Type omegam, const Type lboxmpch, const Type mpc = Type(std::mega::num*magrathea::Constants<Type>::pc()), const Type rhoch2 = Type(3)/Type(8*magrathea::Constants<Type>::pi()*magrathea::Constants<Type>::g()*magrathea::Constants<Type>::pc()*magrathea::Constants<Type>::pc()*std::hecto::num));
         template <class Data, class = typename std::enable_if<Data::types() != 0>::type> static inline Data homogenize(const Data& data);
@@ -88,6 +98,10 @@ class Input final
     public:
         template <class Octree, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, class Data = typename std::tuple_element<1, Element>::type, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<Dimension != 0>::type> static unsigned int filetree(Octree& octree, const std::string& directory, const std::string& format);
         template <class List, class Octree, class Sphere, class Conic, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<(Dimension == 3) && (Dimension == Sphere::dimension())>::type> static bool prepare(List& list, const Octree& octree, const Sphere& sphere, const Conic& conic);
+        template <class Octree, class Sphere, class Cones, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<(Dimension == 3) && (Dimension == Sphere::dimension())>::type> static unsigned int distribute(std::vector<std::vector<unsigned int> >& candidates, const Octree& octree, const Sphere& sphere, const Cones& cones);
+        template <class Octree, class Sphere, class Conic, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, class Integer = decltype(Index::type()), unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<(Dimension == 3) && (Dimension == Sphere::dimension())>::type> static std::vector<std::tuple<Index, Index, int> > cull(const Octree& octree, const Sphere& sphere, const Conic& conic, const unsigned int level = 6);
+        template <class Index> static inline int decide(const std::vector<std::tuple<Index, Index, int> >& culling, const Index& index);
+        template <class Octree, class Sphere, class Conic, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<(Dimension == 3) && (Dimension == Sphere::dimension())>::type> static std::vector<unsigned char> select(const Octree& octree, const Sphere& sphere, const Conic& conic);
     //@}
     
     // Data
@@ -95,7 +109,11 @@ class Input final
     //@{
     public:
         template <typename Integral = unsigned int, typename Real = float, class Octree, class Function, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, class Data = typename std::tuple_element<1, Element>::type, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<std::is_convertible<typename std::result_of<Function(Element)>::type, bool>::value>::type> static bool import(Octree& octree, const std::string& filename, const unsigned int level, Function&& filter);
-        template <typename Type, class Cosmology = std::array<std::vector<Type>, 4>, class Element = typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Cosmology>()[0])>::type>::type, class = typename std::enable_if<std::is_convertible<Element, typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Cosmology>()[0])>::type>::type>::value>::type> static Cosmology acquire(const std::string& simfile, const std::string& paramfile, const std::string& evolfile, Type& h, Type& omegam, Type& lboxmpch, const Type mpc = Type(std::mega::num*magrathea::Constants<Type>::pc()), const std::string& outfile = std::string());
+        template <typename Integral = unsigned int, typename Real = float, class Octree, class Function, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, class Data = typename std::tuple_element<1, Element>::type, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<std::is_convertible<typename std::result_of<Function(Element)>::type, bool>::value>::type> static bool import(Octree& octree, const std::vector<std::string>& filenames, const unsigned int level, Function&& filter, const unsigned int nreaders = 2, const unsigned int depth = 4);
+        template <typename Integral = unsigned int, typename Real = float, class Octree, class Filter, class Consumer, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, class Data = typename std::tuple_element<1, Element>::type, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<std::is_convertible<typename std::result_of<Filter(unsigned int, Element)>::type, bool>::value>::type> static bool pipeline(const Octree& octree, const std::vector<std::string>& filenames, const unsigned int level, Filter&& filter, Consumer&& consumer, const unsigned int nreaders = 2, const unsigned int depth = 4);
+        template <class Element, typename Real = float, class Index = typename std::tuple_element<0, Element>::type, class Data = typename std::tuple_element<1, Element>::type, unsigned int Dimension = Index::dimension(), class = typename std::enable_if<Dimension == 3>::type> static inline Element decode(const Mapping& mapping, const unsigned int record, const unsigned int level, const unsigned long long int i);
+        template <typename Integral = unsigned int, typename Real = float, class Octree, class Buffers, class Sphere, class Cones, class Function, class Element = decltype(Octree::element()), unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<(Dimension == 3) && (Dimension == Sphere::dimension())>::type> static bool scatter(const Octree& octree, Buffers& buffers, const std::vector<std::string>& filenames, const unsigned int level, const Sphere& sphere, const Cones& cones, const std::vector<std::vector<unsigned int> >& candidates, Function&& function, const unsigned int nreaders = 2, const unsigned int depth = 4);
+        template <typename Type, class Cosmology = Expansion<Type>, class Element = typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Cosmology>()[0])>::type>::type, class = typename std::enable_if<std::is_convertible<Element, typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Cosmology>()[0])>::type>::type>::value>::type> static Cosmology acquire(const std::string& simfile, const std::string& paramfile, const std::string& evolfile, Type& h, Type& omegam, Type& lboxmpch, const Type mpc = Type(std::mega::num*magrathea::Constants<Type>::pc()), const std::string& outfile = std::string());
         template <class Container = std::map<std::string, std::string>, class Element = std::pair<std::string, std::string>, class = typename std::enable_if<(std::is_convertible<Container, std::map<std::string, std::string> >::value) && (std::is_convertible<Element, std::pair<std::string, std::string> >::value)>::type> static Container parse(const std::string& filename, const std::string& separator = "=", const std::string& comment = "#");
     //@}
     
@@ -105,6 +123,17 @@ class Input final
     public:
         template <class Octree, class = typename std::enable_if<Octree::dimension() != 0>::type> static bool save(Octree& octree, const std::string& filename);
         template <class Octree, class = typename std::enable_if<Octree::dimension() != 0>::type> static bool load(Octree& octree, const std::string& filename);
+        template <class Octree, class Ranges, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<(Dimension != 0) && (std::is_convertible<typename Ranges::value_type, std::pair<Index, Index> >::value)>::type> static bool load(Octree& octree, const std::string& filename, const Ranges& ranges);
+        template <class Octree, class Region, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class Sphere = magrathea::HyperSphere<Dimension>, class = decltype(Utility::collide(std::declval<const Sphere&>(), std::declval<const Region&>()))> static bool load(Octree& octree, const std::string& filename, const Region& region, const unsigned int level = 6);
+        template <class Buffer, class = typename std::enable_if<!std::is_void<typename Buffer::value_type>::value>::type> static bool flush(Buffer& buffer, const std::string& filename);
+        template <class Octree, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class Position = decltype(Octree::position()), class Extent = decltype(Octree::extent()), class = typename std::enable_if<Dimension != 0>::type> static bool write(Octree& octree, const std::string& filename, const unsigned long long int chunk = 65536, const bool compression = false);
+        template <class Octree, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<Dimension != 0>::type> static bool inspect(const Octree& octree, std::istream& stream, unsigned int& version, std::pair<unsigned int, unsigned int>& levels, std::array<double, Dimension+Dimension>& region, std::vector<std::tuple<Index, Index, unsigned long long int, unsigned long long int, unsigned long long int> >& footer);
+        template <class Octree, class Ranges, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<(Dimension != 0) && (std::is_convertible<typename Ranges::value_type, std::pair<Index, Index> >::value)>::type> static bool read(Octree& octree, const std::string& filename, const Ranges& ranges);
+        template <class Octree, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<Dimension != 0>::type> static bool read(Octree& octree, const std::string& filename, const Index& first, const Index& last);
+        template <class Octree, class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, unsigned int Dimension = Octree::dimension(), class = typename std::enable_if<Dimension != 0>::type> static bool verify(const Octree& octree, const std::string& filename);
+        template <class Index, class Ranges, class Integer = decltype(Index::type()), class = typename std::enable_if<std::is_convertible<typename Ranges::value_type, std::pair<Index, Index> >::value>::type> static std::vector<std::pair<Index, Index> > normalize(const Ranges& ranges);
+        template <class Index> static inline bool overlap(const std::vector<std::pair<Index, Index> >& ranges, const Index& first, const Index& last);
+        template <class Octree, class Region, typename Type = decltype(Octree::type()), class Element = decltype(Octree::element()), class Index = typename std::tuple_element<0, Element>::type, class Integer = decltype(Index::type()), unsigned int Dimension = Octree::dimension(), class Position = decltype(Octree::position()), class Extent = decltype(Octree::extent()), class Sphere = magrathea::HyperSphere<Dimension>, class = decltype(Utility::collide(std::declval<const Sphere&>(), std::declval<const Region&>()))> static std::vector<std::pair<Index, Index> > cover(const Octree& octree, const Region& region, const unsigned int level = 6);
     //@}
     
     // Correction
@@ -156,6 +185,25 @@ inline std::pair<std::string, std::string> Input::partition(const std::string& t
     return (text.find(separator) == std::string::npos) ? (std::make_pair(text, std::string())) : (std::make_pair(std::string(text.begin(), text.begin()+text.find(separator)), std::string(text.begin()+text.find(separator)+separator.size(), text.end())));
 }
 
+// Checksum
+/// \brief          Checksum.
+/// \details        Computes the 64 bits FNV-1a hash of a range of bytes. A
+///                 previous result can be passed as seed to hash several
+///                 ranges in sequence.
+/// \param[in]      first Pointer to the first byte.
+/// \param[in]      last Pointer past the last byte.
+/// \param[in]      seed Initial value of the hash.
+/// \return         Hash value.
+inline unsigned long long int Input::checksum(const char* first, const char* last, const unsigned long long int seed)
+{
+    static const unsigned long long int prime = 1099511628211ULL;
+    unsigned long long int result = seed;
+    for (const char* byte = first; byte < last; ++byte) {
+        result = (result^static_cast<unsigned char>(*byte))*prime;
+    }
+    return result;
+}
+
 // Count tree
 /// \brief          Count tree.
 /// \details        Counts the number of input cells in each output cells.
@@ -202,6 +250,127 @@ inline bool Input::collide(const Octree& octree, const Index& index, const Spher
     return ((Utility::collide(spherified, sphere)) || (Utility::collide(spherified, conic)));
 }
 
+// Batch collision between octree indices and a sphere or a cone
+/// \brief          Batch collision between octree indices and a sphere or a
+///                 cone.
+/// \details        Detects collision between a range of indices of an 
+///                 octree and a sphere or a cone, with the same criterion 
+///                 as the collision of a single index. The centers and radii
+///                 of the cells are first stored by coordinate, so that the
+///                 geometrical tests run as a single branchless loop which 
+///                 can be vectorized.
+/// \tparam         Octree Octree type.
+/// \tparam         Iterator Iterator to indices.
+/// \tparam         Sphere Sphere type.
+/// \tparam         Conic Cone type.
+/// \tparam         Output Output iterator of booleans.
+/// \tparam         Type Scalar position type.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Dimension Number of dimensions.
+/// \tparam         Position Position of the hyperoctree center.
+/// \tparam         Extent Extent of the hyperoctree.
+/// \param[in]      octree Input octree.
+/// \param[in]      first Iterator to the first index.
+/// \param[in]      last Iterator past the last index.
+/// \param[in]      sphere Geometrical sphere.
+/// \param[in]      cone Three dimensional cone.
+/// \param[out]     result Iterator to the collision flag of the first index.
+/// \return         Number of collisions.
+template <class Octree, class Iterator, class Sphere, class Conic, class Output, typename Type, class Element, class Index, unsigned int Dimension, class Position, class Extent, class>
+inline unsigned long long int Input::collide(const Octree& octree, Iterator first, Iterator last, const Sphere& sphere, const Conic& conic, Output result)
+{
+    // Initialization
+    const unsigned long long int size = std::distance(first, last);
+    const Type factor = std::sqrt(Type(3))/Type(2*(sizeof(octree)/sizeof(octree)));
+    const Type norm = conic.length();
+    const Type tangent = std::tan(conic.angle());
+    const Type microradius = Utility::radius(sphere);
+    std::array<Type, Dimension> center = std::array<Type, Dimension>();
+    std::array<Type, Dimension> vertex = std::array<Type, Dimension>();
+    std::array<Type, Dimension> axis = std::array<Type, Dimension>();
+    std::array<std::vector<Type>, Dimension> positions;
+    std::vector<Type> radii(size);
+    std::vector<unsigned char> flags(size);
+    Type length = Type();
+    Type distance = Type();
+    Type separation = Type();
+    Iterator iterator = first;
+
+    // Decompose the cells by coordinate
+    for (unsigned int idim = 0; idim < Dimension; ++idim) {
+        center[idim] = sphere.position(idim);
+        vertex[idim] = conic.vertex(idim);
+        axis[idim] = conic.base(idim)-conic.vertex(idim);
+        positions[idim].resize(size);
+    }
+    for (unsigned long long int i = 0; i < size; ++i, ++iterator) {
+        const Index index = *iterator;
+        for (unsigned int idim = 0; idim < Dimension; ++idim) { 
+            positions[idim][i] = index.template position<Type, Position, Extent>(idim); 
+        }
+        radii[i] = index.template extent<Type, Position, Extent>()*factor;
+    }
+
+    // Branchless collision tests
+    for (unsigned long long int i = 0; i < size; ++i) {
+        length = Type();
+        distance = Type();
+        separation = Type();
+        for (unsigned int idim = 0; idim < Dimension; ++idim) {
+            length += axis[idim]*(positions[idim][i]-vertex[idim]);
+        }
+        length /= norm;
+        for (unsigned int idim = 0; idim < Dimension; ++idim) {
+            distance += (positions[idim][i]-(vertex[idim]+axis[idim]*(length/norm)))*(positions[idim][i]-(vertex[idim]+axis[idim]*(length/norm)));
+        }
+        for (unsigned int idim = Dimension; idim > 0; --idim) {
+            separation = (positions[idim-1][i]-center[idim-1])*(positions[idim-1][i]-center[idim-1])+separation;
+        }
+        flags[i] = (std::sqrt(separation) < radii[i]+microradius) | ((std::sqrt(distance) < radii[i]+std::max(length, Type())*tangent) & !(length < -radii[i]) & (length < norm+radii[i]*Type(2)));
+    }
+
+    // Finalization
+    std::copy(flags.begin(), flags.end(), result);
+    return std::accumulate(flags.begin(), flags.end(), 0ULL);
+}
+
+// Classification of an octree index relatively to a sphere or a cone
+/// \brief          Classification of an octree index relatively to a sphere
+///                 or a cone.
+/// \details        Classifies an index of an octree and all its descendants
+///                 relatively to a sphere or a cone, with the same criterion
+///                 as the collision.
+/// \tparam         Octree Octree type.
+/// \tparam         Sphere Sphere type.
+/// \tparam         Conic Cone type.
+/// \tparam         Type Scalar position type.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Dimension Number of dimensions.
+/// \tparam         Position Position of the hyperoctree center.
+/// \tparam         Extent Extent of the hyperoctree.
+/// \param[in]      octree Input octree.
+/// \param[in]      index Index of one element.
+/// \param[in]      sphere Geometrical sphere.
+/// \param[in]      cone Three dimensional cone.
+/// \return         One if the cell and all its descendants collide, minus 
+///                 one if none of them collide, zero otherwise.
+template <class Octree, class Sphere, class Conic, typename Type, class Element, class Index, unsigned int Dimension, class Position, class Extent, class>
+inline int Input::classify(const Octree& octree, const Index& index, const Sphere& sphere, const Conic& conic)
+{
+    Sphere spherified = Sphere();
+    int first = 0;
+    int second = 0;
+    for (unsigned int idim = 0; idim < Dimension; ++idim) { 
+        spherified.position(idim) = index.template position<Type, Position, Extent>(idim); 
+    }
+    spherified.extent() = index.template extent<Type, Position, Extent>()*std::sqrt(Type(3))/Type(2*(sizeof(octree)/sizeof(octree)));
+    first = Utility::classify(spherified, sphere);
+    second = Utility::classify(spherified, conic);
+    return ((first > 0) || (second > 0))-((first < 0) && (second < 0));
+}
+
 // Mean value over cells
 /// \brief          Mean value over cells.
 /// \details        Computes the average of the provided data in all 
@@ -272,6 +441,36 @@ inline Cosmology Input::constantify(const unsigned int size, const Type tmin, co
     return result;
 }
 
+// Generic cosmology tabulation
+/// \brief          Generic cosmology tabulation.
+/// \details        Does nothing for generic cosmology containers which are
+///                 always interpolated with a binary search.
+/// \tparam         Cosmology Cosmology container type.
+/// \param[in,out]  cosmology Cosmology.
+/// \param[in]      size Number of points of the grid.
+/// \return         Reference to the cosmology.
+template <class Cosmology, class>
+inline Cosmology& Input::tabulate(Cosmology& cosmology, const unsigned int)
+{
+    return cosmology;
+}
+
+// Expansion tabulation
+/// \brief          Expansion tabulation.
+/// \details        Resamples an expansion on a uniform grid so that the
+///                 integrator can look it up without any search.
+/// \tparam         Type Data type.
+/// \param[in,out]  cosmology Cosmology.
+/// \param[in]      size Number of points of the grid or zero to size it
+///                 from the cosmology within a relative deviation of one
+///                 millionth.
+/// \return         Reference to the cosmology.
+template <typename Type>
+inline Expansion<Type>& Input::tabulate(Expansion<Type>& cosmology, const unsigned int size)
+{
+    return cosmology.tabulate(size);
+}
+
 // Data conversion to SI units
 /// \brief          Data conversion to SI units.
 /// \details        Converts a data to one expressed in SI units.
@@ -495,7 +694,7 @@ unsigned int Input::filetree(Octree& octree, const std::string& directory, const
 // File list preparation
 /// \brief          File list preparation.
 /// \details        Adds to the list, the octree files which intersects the
-///                 provided sphere and cone.
+///                 provided sphere and cone, selected hierarchically.
 /// \tparam         List File list type.
 /// \tparam         Octree Octree type.
 /// \tparam         Sphere Sphere type.
@@ -513,18 +712,170 @@ bool Input::prepare(List& list, const Octree& octree, const Sphere& sphere, cons
     // Initialization
     const unsigned int size = octree.size();
     const unsigned int original = list.size();
+    const std::vector<unsigned char> selected = select(octree, sphere, conic);
     std::vector<unsigned int> selection(size);
-    unsigned int n = original;
 
     // Compute files to be read
-    Utility::parallelize(size, [=, &octree, &sphere, &conic, &selection](const unsigned int i){selection[i] = (std::get<1>(octree[i]).empty()) ? (0) : (collide(octree, std::get<0>(octree[i]), sphere, conic));});
-    list.resize(original+std::accumulate(selection.begin(), selection.end(), 0));
-    std::for_each(selection.begin(), selection.end(), [=, &n](unsigned int& i){i = i ? ++n : i;}); 
+    Utility::parallelize(size, [=, &octree, &selected, &selection](const unsigned int i){selection[i] = (std::get<1>(octree[i]).empty()) ? (0) : (selected[i]);});
+    list.resize(original+Utility::compact(selection.begin(), selection.end(), original));
     Utility::parallelize(size, [=, &list, &octree, &selection](const unsigned int i){if (selection[i]) list[selection[i]-1] = std::get<1>(octree[i]);});
     
     // Finalization
     return (list.size() > original);
 }
+
+// Cone candidates of each file
+/// \brief          Cone candidates of each file.
+/// \details        Computes, for each element of the octree of files, the
+///                 list of cones intersecting the file. It is the inverse of
+///                 the preparation of a file list and serves as acceleration
+///                 structure when cells are distributed to the cones : a cell
+///                 only needs to be tested against the candidates of its file.
+///                 Files are selected hierarchically for each cone.
+/// \tparam         Octree Octree type.
+/// \tparam         Sphere Sphere type.
+/// \tparam         Cones Container of cones.
+/// \tparam         Dimension Number of dimensions.
+/// \param[out]     candidates Indices of the candidate cones of each file.
+/// \param[in]      octree Input octree.
+/// \param[in]      sphere Geometrical sphere.
+/// \param[in]      cones Three dimensional cones.
+/// \return         Number of files intersecting at least one cone.
+template <class Octree, class Sphere, class Cones, unsigned int Dimension, class>
+unsigned int Input::distribute(std::vector<std::vector<unsigned int> >& candidates, const Octree& octree, const Sphere& sphere, const Cones& cones)
+{
+    // Initialization
+    const unsigned int size = octree.size();
+    const unsigned int ncones = cones.size();
+    std::vector<unsigned char> selected;
+    candidates.assign(size, std::vector<unsigned int>());
+
+    // Compute cones intersecting each file
+    for (unsigned int icone = 0; icone < ncones; ++icone) {
+        selected = select(octree, sphere, cones[icone]);
+        Utility::parallelize(size, [=, &candidates, &octree, &selected](const unsigned int i){if ((selected[i]) && (!std::get<1>(octree[i]).empty())) {candidates[i].push_back(icone);}});
+    }
+
+    // Finalization
+    return std::count_if(candidates.begin(), candidates.end(), [](const std::vector<unsigned int>& list){return !list.empty();});
+}
+
+// Hierarchical culling
+/// \brief          Hierarchical culling.
+/// \details        Classifies the cells of the octree relatively to a sphere
+///                 or a cone, from the root down to the provided level, and
+///                 returns the key ranges of the subtrees which entirely 
+///                 collide or entirely miss. The children of such a cell are
+///                 never tested, and cells straddling the boundary at the 
+///                 finest level are not part of the result. 
+/// \tparam         Octree Octree type.
+/// \tparam         Sphere Sphere type.
+/// \tparam         Conic Cone type.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Integer Integer type of the index.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in]      octree Input octree.
+/// \param[in]      sphere Geometrical sphere.
+/// \param[in]      cone Three dimensional cone.
+/// \param[in]      level Finest level of the classification.
+/// \return         Sorted key ranges of the decided subtrees associated with
+///                 one if they collide and minus one otherwise.
+template <class Octree, class Sphere, class Conic, class Element, class Index, class Integer, unsigned int Dimension, class>
+std::vector<std::tuple<Index, Index, int> > Input::cull(const Octree& octree, const Sphere& sphere, const Conic& conic, const unsigned int level)
+{
+    static const Integer one = Integer(1);
+    const unsigned int finest = std::min(level, Index::refinements());
+    std::vector<std::tuple<Index, Index, int> > culling;
+    std::vector<Index> stack(1, Index());
+    Index index = Index();
+    int state = 0;
+    while (!stack.empty()) {
+        index = stack.back();
+        stack.pop_back();
+        state = classify(octree, index, sphere, conic);
+        if (state != 0) {
+            culling.push_back(std::make_tuple(index, Index(static_cast<Integer>(index) | ((index.level() > 0) ? ((one << (Index::bits()-index.level()*(Dimension+1)))-one) : (~Integer()))), state));
+        } else if (index.level() < finest) {
+            for (unsigned int isite = (1U << Dimension); isite > 0; --isite) {
+                stack.push_back(index.child(isite-1));
+            }
+        }
+    }
+    return culling;
+}
+
+// Decision of the hierarchical culling
+/// \brief          Decision of the hierarchical culling.
+/// \details        Finds the decided subtree containing the provided index.
+/// \tparam         Index Index type.
+/// \param[in]      culling Result of the hierarchical culling.
+/// \param[in]      index Index of one element.
+/// \return         One if the cell collides, minus one if it misses, zero
+///                 if it should be tested.
+template <class Index>
+inline int Input::decide(const std::vector<std::tuple<Index, Index, int> >& culling, const Index& index)
+{
+    typename std::vector<std::tuple<Index, Index, int> >::const_iterator iterator = std::upper_bound(culling.begin(), culling.end(), index, [](const Index& key, const std::tuple<Index, Index, int>& range){return key < std::get<0>(range);});
+    int state = 0;
+    if (iterator != culling.begin()) {
+        --iterator;
+        state = (std::get<1>(*iterator) < index) ? (0) : (std::get<2>(*iterator));
+    }
+    return state;
+}
+
+// Hierarchical selection of octree elements
+/// \brief          Hierarchical selection of octree elements.
+/// \details        Selects the elements of the octree colliding with a 
+///                 sphere or a cone. Cells are decided by the hierarchical 
+///                 culling down to the finest level of the octree, and the
+///                 remaining ones are tested in a single batch.
+/// \tparam         Octree Octree type.
+/// \tparam         Sphere Sphere type.
+/// \tparam         Conic Cone type.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in]      octree Input octree.
+/// \param[in]      sphere Geometrical sphere.
+/// \param[in]      cone Three dimensional cone.
+/// \return         Collision flag of each element.
+template <class Octree, class Sphere, class Conic, class Element, class Index, unsigned int Dimension, class>
+std::vector<unsigned char> Input::select(const Octree& octree, const Sphere& sphere, const Conic& conic)
+{
+    // Initialization
+    const unsigned int size = octree.size();
+    std::vector<unsigned char> selection(size);
+    std::vector<int> states(size);
+    std::vector<std::tuple<Index, Index, int> > culling;
+    std::vector<unsigned int> undecided;
+    std::vector<Index> indices;
+    std::vector<unsigned char> flags;
+    unsigned int finest = 0;
+
+    // Cull hierarchically
+    for (unsigned int i = 0; i < size; ++i) {
+        finest = std::max(finest, std::get<0>(octree[i]).level());
+    }
+    culling = cull(octree, sphere, conic, finest);
+    Utility::parallelize(size, [=, &octree, &culling, &states](const unsigned int i){states[i] = decide(culling, std::get<0>(octree[i]));});
+
+    // Test undecided cells in batch
+    for (unsigned int i = 0; i < size; ++i) {
+        if (states[i] == 0) {
+            undecided.push_back(i);
+            indices.push_back(std::get<0>(octree[i]));
+        }
+    }
+    flags.resize(indices.size());
+    collide(octree, indices.begin(), indices.end(), sphere, conic, flags.begin());
+
+    // Finalization
+    Utility::parallelize(size, [=, &states, &selection](const unsigned int i){selection[i] = (states[i] > 0);});
+    Utility::parallelize(undecided.size(), [=, &undecided, &flags, &selection](const unsigned int i){selection[undecided[i]] = flags[i];});
+    return selection;
+}
 // -------------------------------------------------------------------------- //
 
 
@@ -638,9 +989,9 @@ bool Input::import(Octree& octree, const std::string& filename, const unsigned i
             
             // Destination
             n = octree.size();
-            size = std::accumulate(selection.begin(), selection.end(), n);
+            size = Utility::reduce(selection.begin(), selection.end(), n);
             thread = std::thread([=, &octree, &size](){octree.resize(size);});
-            std::for_each(selection.begin(), selection.end(), [=, &n](Integral& i){i = i ? ++n : i;});
+            Utility::compact(selection.begin(), selection.end(), n);
             thread.join();
             Utility::parallelize(index.begin(), index.end(), [=, &octree, &filter, &center, &force, &a, &phi, &rho, &son, &selection](Integral& i){if (selection[i]) octree[selection[i]-1] = Element(Index::compute(ilevel, center[Dimension*i], center[Dimension*i+1], center[Dimension*i+2]), Data(rho[i], phi[i], std::array<Real, 3>({{force[Dimension*i], force[Dimension*i+1], force[Dimension*i+2]}}), a[i]));});
         }
@@ -653,6 +1004,241 @@ bool Input::import(Octree& octree, const std::string& filename, const unsigned i
     return stream.good();
 }
 
+// Pipelined ramses importation
+/// \brief          Pipelined ramses importation.
+/// \details        Imports raw data from a list of ramses gravity files, as
+///                 the single file version, through the importation 
+///                 pipeline.
+/// \tparam         Integral Integral type of the file.
+/// \tparam         Real Real type of the file.
+/// \tparam         Octree Octree type.
+/// \tparam         Function Function type taking an element as argument and
+///                 returning a boolean.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Data Data type.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in,out]  octree Octree of data.
+/// \param[in]      filenames Input file names.
+/// \param[in]      coarse Refinement level corresponding to the coarse level.
+/// \param[in]      filter Filtering algorithm of cells.
+/// \param[in]      nreaders Number of reading threads.
+/// \param[in]      depth Capacity of the queues between stages.
+/// \return         True on success, false on error.
+template <typename Integral, typename Real, class Octree, class Function, class Element, class Index, class Data, unsigned int Dimension, class> 
+bool Input::import(Octree& octree, const std::vector<std::string>& filenames, const unsigned int coarse, Function&& filter, const unsigned int nreaders, const unsigned int depth)
+{
+    return pipeline<Integral, Real>(octree, filenames, coarse, [=, &filter](const unsigned int, const Element& element){return filter(element);}, [=, &octree](const unsigned int, std::vector<Element>& elements){const unsigned long long int n = octree.size(); octree.resize(n+elements.size()); std::copy(elements.begin(), elements.end(), octree.begin()+n);}, nreaders, depth);
+}
+
+// Ramses importation pipeline
+/// \brief          Ramses importation pipeline.
+/// \details        Imports raw data from a list of ramses gravity files in
+///                 three concurrent stages connected by bounded queues. 
+///                 Reading threads map the next files in memory, validate
+///                 their records and let the kernel read them ahead, the
+///                 calling thread decodes the cells straight from the mapped
+///                 pages and applies the filter in parallel, and an 
+///                 appending thread passes the selected cells to the 
+///                 consumer. The queues bound the number of levels in 
+///                 flight, while several files are read concurrently to 
+///                 sustain the bandwidth of parallel filesystems. The order
+///                 of the cells of different files is unspecified.
+/// \tparam         Integral Integral type of the file.
+/// \tparam         Real Real type of the file.
+/// \tparam         Octree Octree type.
+/// \tparam         Filter Function type taking a file number and an element
+///                 as arguments and returning a boolean.
+/// \tparam         Consumer Function type taking a file number and a vector
+///                 of elements as arguments.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Data Data type.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in]      octree Octree defining the element type.
+/// \param[in]      filenames Input file names.
+/// \param[in]      coarse Refinement level corresponding to the coarse level.
+/// \param[in]      filter Filtering algorithm of cells.
+/// \param[in]      consumer Consumer of the selected cells of each level.
+/// \param[in]      nreaders Number of reading threads.
+/// \param[in]      depth Capacity of the queues between stages.
+/// \return         True on success, false on error.
+template <typename Integral, typename Real, class Octree, class Filter, class Consumer, class Element, class Index, class Data, unsigned int Dimension, class> 
+bool Input::pipeline(const Octree& octree, const std::vector<std::string>& filenames, const unsigned int coarse, Filter&& filter, Consumer&& consumer, const unsigned int nreaders, const unsigned int depth)
+{
+    // Initialization
+    typedef std::tuple<unsigned int, unsigned int, std::shared_ptr<Mapping>, unsigned int> Block;
+    typedef std::pair<unsigned int, std::vector<Element> > Cells;
+    static const unsigned int nheader = 3;
+    static const unsigned int nrecords = 6;
+    const unsigned int nfiles = filenames.size();
+    const unsigned int nthreads = std::max(1U, std::min(nreaders, nfiles));
+    Queue<Block> blocks(depth);
+    Queue<Cells> cells(depth);
+    std::atomic<unsigned int> next(0);
+    std::atomic<unsigned int> active(nthreads);
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> readers;
+    std::thread appender;
+    std::vector<Integral> selection;
+    Block block;
+    Cells current;
+    unsigned long long int size = 0;
+    unsigned long long int n = 0;
+
+    // Reading stage
+    auto reader = [=, &filenames, &blocks, &next, &active, &ok](){
+        std::shared_ptr<Mapping> mapping;
+        unsigned long long int nlevels = 0;
+        unsigned long long int ncells = 0;
+        bool valid = false;
+        for (unsigned int ifile = next++; ifile < nfiles; ifile = next++) {
+            mapping = std::make_shared<Mapping>(filenames[ifile]);
+            valid = (mapping->index<Integral>() >= nheader);
+            nlevels = (valid) ? (mapping->size<Integral>(0)) : (0);
+            valid = (valid) && (mapping->count() >= nheader+nlevels*nrecords);
+            for (unsigned int ilevel = 0; (valid) && (ilevel < nlevels); ++ilevel) {
+                ncells = mapping->at<Integral>(0, ilevel);
+                valid = (mapping->size<Real>(nheader+ilevel*nrecords) == Dimension*ncells) && (mapping->size<Real>(nheader+ilevel*nrecords+1) == Dimension*ncells);
+                for (unsigned int irecord = 2; (valid) && (irecord < nrecords-1); ++irecord) {
+                    valid = (mapping->size<Real>(nheader+ilevel*nrecords+irecord) == ncells);
+                }
+                if (valid) {
+                    blocks.push(Block(ifile, coarse+ilevel, mapping, nheader+ilevel*nrecords));
+                }
+            }
+            if (!valid) {
+                ok = false;
+            }
+        }
+        if (--active == 0) {
+            blocks.close();
+        }
+    };
+
+    // Appending stage
+    appender = std::thread([=, &cells, &consumer](){Cells received; while (cells.pop(received)) {consumer(received.first, received.second);}});
+    for (unsigned int ithread = 0; ithread < nthreads; ++ithread) {
+        readers.push_back(std::thread(reader));
+    }
+
+    // Decoding stage
+    while (blocks.pop(block)) {
+        const unsigned int ifile = std::get<0>(block);
+        const unsigned int ilevel = std::get<1>(block);
+        const Mapping& mapping = *std::get<2>(block);
+        const unsigned int irecord = std::get<3>(block);
+        auto element = [=, &mapping](const unsigned long long int i){return decode<Element, Real>(mapping, irecord, ilevel, i);};
+        size = mapping.size<Real>(irecord+2);
+        selection.resize(size);
+        Utility::parallelize(size, [=, &filter, &element, &selection](const unsigned long long int i){selection[i] = filter(ifile, element(i));});
+        n = Utility::compact(selection.begin(), selection.end(), Integral());
+        current.first = ifile;
+        current.second.resize(n);
+        Utility::parallelize(size, [=, &element, &selection, &current](const unsigned long long int i){if (selection[i]) current.second[selection[i]-1] = element(i);});
+        cells.push(std::move(current));
+        std::get<2>(block).reset();
+    }
+
+    // Finalization
+    std::for_each(readers.begin(), readers.end(), [](std::thread& current){current.join();});
+    cells.close();
+    appender.join();
+    static_cast<void>(octree);
+    return ok;
+}
+
+// Decode a mapped ramses cell
+/// \brief          Decode a mapped ramses cell.
+/// \details        Builds the element of a cell of a mapped ramses gravity
+///                 file directly from the mapped pages. The level is 
+///                 described by six consecutive records containing the 
+///                 centers, the forces, the scale factors, the potentials,
+///                 the densities and the sons of its cells.
+/// \tparam         Element Underlying element type.
+/// \tparam         Real Real type of the file.
+/// \tparam         Index Index type.
+/// \tparam         Data Data type.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in]      mapping Mapped and indexed file.
+/// \param[in]      record First record of the level.
+/// \param[in]      level Refinement level.
+/// \param[in]      i Cell number in the level.
+/// \return         Element of the cell.
+template <class Element, typename Real, class Index, class Data, unsigned int Dimension, class> 
+inline Element Input::decode(const Mapping& mapping, const unsigned int record, const unsigned int level, const unsigned long long int i)
+{
+    return Element(Index::compute(level, mapping.at<Real>(record, Dimension*i), mapping.at<Real>(record, Dimension*i+1), mapping.at<Real>(record, Dimension*i+2)), Data(mapping.at<Real>(record+4, i), mapping.at<Real>(record+3, i), std::array<Real, 3>({{mapping.at<Real>(record+1, Dimension*i), mapping.at<Real>(record+1, Dimension*i+1), mapping.at<Real>(record+1, Dimension*i+2)}}), mapping.at<Real>(record+2, i)));
+}
+
+// Ramses scattering
+/// \brief          Ramses scattering.
+/// \details        Imports a list of ramses gravity files through the 
+///                 importation pipeline, reading each file once, and 
+///                 appends each cell to the buffer of every cone it 
+///                 intersects. Only the candidate cones of each file are 
+///                 tested, and each buffer is filled by a single thread. 
+///                 Cells inside or outside the coarse cells decided by the
+///                 hierarchical culling of each cone are not tested, and
+///                 the remaining ones are tested in batch.
+///                 After the cells of a level have been appended, the 
+///                 function is called on the buffers of the candidate 
+///                 cones, typically to flush them.
+/// \tparam         Integral Integral type of the file.
+/// \tparam         Real Real type of the file.
+/// \tparam         Octree Octree type.
+/// \tparam         Buffers Container of one buffer of elements per cone.
+/// \tparam         Sphere Sphere type.
+/// \tparam         Cones Container of cones.
+/// \tparam         Function Function type taking a buffer and a cone index
+///                 as arguments.
+/// \tparam         Element Underlying element type.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in]      octree Octree defining the element type.
+/// \param[in,out]  buffers Buffers of elements of each cone.
+/// \param[in]      filenames Input file names.
+/// \param[in]      coarse Refinement level corresponding to the coarse level.
+/// \param[in]      sphere Geometrical sphere.
+/// \param[in]      cones Three dimensional cones.
+/// \param[in]      candidates Indices of the cones intersecting each file.
+/// \param[in]      function Function applied to the buffers.
+/// \param[in]      nreaders Number of reading threads.
+/// \param[in]      depth Capacity of the queues between stages.
+/// \return         True on success, false on error.
+template <typename Integral, typename Real, class Octree, class Buffers, class Sphere, class Cones, class Function, class Element, unsigned int Dimension, class> 
+bool Input::scatter(const Octree& octree, Buffers& buffers, const std::vector<std::string>& filenames, const unsigned int coarse, const Sphere& sphere, const Cones& cones, const std::vector<std::vector<unsigned int> >& candidates, Function&& function, const unsigned int nreaders, const unsigned int depth)
+{
+    // Initialization
+    typedef typename std::tuple_element<0, Element>::type Index;
+    const unsigned int ncones = cones.size();
+    std::vector<std::vector<std::tuple<Index, Index, int> > > cullings(ncones);
+
+    // Hierarchical culling of the candidate cones
+    Utility::parallelize(ncones, [=, &octree, &sphere, &cones, &candidates, &cullings](const unsigned int icone){if (std::any_of(candidates.begin(), candidates.end(), [=](const std::vector<unsigned int>& list){return std::find(list.begin(), list.end(), icone) != list.end();})) {cullings[icone] = cull(octree, sphere, cones[icone]);}});
+
+    // Scattering
+    auto filter = [=, &cullings, &candidates](const unsigned int ifile, const Element& element){bool selected = false; for (unsigned int icandidate = 0; (!selected) && (icandidate < candidates[ifile].size()); ++icandidate) {selected = (decide(cullings[candidates[ifile][icandidate]], std::get<0>(element)) >= 0);} return selected;};
+    auto distributor = [=, &octree, &buffers, &sphere, &cones, &cullings](const unsigned int icone, const std::vector<Element>& elements){
+        std::vector<int> states(elements.size());
+        std::vector<Index> indices;
+        std::vector<unsigned char> flags;
+        for (unsigned long long int ielem = 0; ielem < elements.size(); ++ielem) {
+            states[ielem] = decide(cullings[icone], std::get<0>(elements[ielem]));
+            if (states[ielem] == 0) {
+                indices.push_back(std::get<0>(elements[ielem]));
+            }
+        }
+        flags.resize(indices.size());
+        collide(octree, indices.begin(), indices.end(), sphere, cones[icone], flags.begin());
+        for (unsigned long long int ielem = 0, iflag = 0; ielem < elements.size(); ++ielem) {
+            if ((states[ielem] > 0) || ((states[ielem] == 0) && (flags[iflag++]))) {
+                buffers[icone].push_back(elements[ielem]);
+            }
+        }
+    };
+    return pipeline<Integral, Real>(octree, filenames, coarse, filter, [=, &buffers, &candidates, &function, &distributor](const unsigned int ifile, std::vector<Element>& elements){Utility::parallelize(candidates[ifile].size(), [=, &candidates, &elements, &distributor](const unsigned int i){distributor(candidates[ifile][i], elements);}); std::for_each(candidates[ifile].begin(), candidates[ifile].end(), [=, &buffers, &function](const unsigned int icone){function(buffers[icone], icone);});}, nreaders, depth);
+}
+
 // Cosmology acquisition
 /// \brief          Cosmology acquisition.
 /// \details        Acquires cosmology parameters and cosmology from
@@ -660,7 +1246,8 @@ bool Input::import(Octree& octree, const std::string& filename, const unsigned i
 ///                 parameter of matter and the size of the box. It
 ///                 returns a container with t, a(t), its first and
 ///                 second derivatives (where t can be either the
-///                 cosmic time or the conformal time eta).
+///                 cosmic time or the conformal time eta). Expansions are
+///                 tabulated on a uniform grid of t before being returned.
 /// \tparam         Type Arithmetic type.
 /// \tparam         Cosmology Cosmology container type.
 /// \tparam         Element Element type of the container.
@@ -801,7 +1388,7 @@ Cosmology Input::acquire(const std::string& simfile, const std::string& paramfil
             }
         }
     }
-    return result;
+    return tabulate(result);
 }
 
 // Parameter file parsing
@@ -870,7 +1457,8 @@ bool Input::save(Octree& octree, const std::string& filename)
 
 // Load temporary cone file
 /// \brief          Load temporary cone file.
-/// \details        Loads a temporary cone file into an octree.
+/// \details        Loads a temporary cone file into an octree. Both raw 
+///                 dumps and indexed cone files are detected and loaded.
 /// \tparam         Octree Octree type.
 /// \param[in,out]  octree Destination octree.
 /// \param[in]      filename File name.
@@ -879,11 +1467,20 @@ template <class Octree, class>
 bool Input::load(Octree& octree, const std::string& filename)
 {
     static const unsigned long long int factor = sizeof(unsigned long long int)*sizeof(unsigned long long int);
+    static const std::string magic = "MAGCONE2";
     const unsigned long long int original = octree.size();
     std::ifstream stream(filename);
     long long int size = magrathea::FileSystem::size(stream);
+    std::string mark(magic.size(), char());
     bool ok = (stream) && (size >= 0);
-    if (ok) {
+    if ((ok) && (size >= static_cast<long long int>(magic.size()))) {
+        stream.read(&mark[0], mark.size());
+        stream.seekg(0, std::ios::beg);
+    }
+    if ((ok) && (mark == magic)) {
+        stream.close();
+        ok = read(octree, filename, std::vector<std::pair<typename std::tuple_element<0, decltype(Octree::element())>::type, typename std::tuple_element<0, decltype(Octree::element())>::type> >());
+    } else if (ok) {
         octree.reserve(original+(size/sizeof(*(octree.data())))+((size/sizeof(*(octree.data())))/factor));
         octree.resize(original+size/sizeof(*(octree.data())));
         ok = magrathea::DataHandler::rread(stream, octree.data()+original, octree.data()+octree.size());
@@ -891,6 +1488,509 @@ bool Input::load(Octree& octree, const std::string& filename)
     }
     return ok;
 }
+
+// Load key ranges of a temporary cone file
+/// \brief          Load key ranges of a temporary cone file.
+/// \details        Loads the elements of a temporary cone file whose keys 
+///                 belong to one of the provided inclusive ranges. Indexed
+///                 cone files are read chunk by chunk, so that only the
+///                 chunks overlapping a range are accessed, whereas raw 
+///                 dumps are fully loaded and then filtered. An empty list 
+///                 of ranges selects the whole file.
+/// \tparam         Octree Octree type.
+/// \tparam         Ranges Container of pairs of first and last keys.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in,out]  octree Destination octree.
+/// \param[in]      filename File name.
+/// \param[in]      ranges Ranges of keys.
+/// \return         True on success, false otherwise.
+template <class Octree, class Ranges, class Element, class Index, unsigned int Dimension, class> 
+bool Input::load(Octree& octree, const std::string& filename, const Ranges& ranges)
+{
+    static const std::string magic = "MAGCONE2";
+    const unsigned long long int original = octree.size();
+    const std::vector<std::pair<Index, Index> > selection = normalize<Index>(ranges);
+    std::ifstream stream(filename, std::ios::binary);
+    std::string mark(magic.size(), char());
+    bool ok = static_cast<bool>(stream);
+    if (ok) {
+        stream.read(&mark[0], mark.size());
+        stream.close();
+    }
+    if ((ok) && (mark == magic)) {
+        ok = read(octree, filename, selection);
+    } else if (ok) {
+        ok = load(octree, filename);
+        if ((ok) && (!ranges.empty())) {
+            octree.resize(std::distance(octree.data(), std::remove_if(octree.data()+original, octree.data()+octree.size(), [=, &selection](const Element& element){return !overlap(selection, std::get<0>(element), std::get<0>(element));})));
+        }
+    }
+    return ok;
+}
+
+// Load a region of a temporary cone file
+/// \brief          Load a region of a temporary cone file.
+/// \details        Loads the elements of a temporary cone file that are 
+///                 needed to interpolate the data inside a geometrical 
+///                 region : the region is first converted into key ranges,
+///                 including the neighbouring and coarser cells used by 
+///                 the interpolation fallbacks, and only these ranges are
+///                 loaded.
+/// \tparam         Octree Octree type.
+/// \tparam         Region Region type : hypersphere, hypercube or cone.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Dimension Number of dimensions.
+/// \tparam         Sphere Sphere type used for collisions.
+/// \param[in,out]  octree Destination octree.
+/// \param[in]      filename File name.
+/// \param[in]      region Geometrical region.
+/// \param[in]      level Level at which the region is resolved.
+/// \return         True on success, false otherwise.
+template <class Octree, class Region, class Element, class Index, unsigned int Dimension, class Sphere, class> 
+bool Input::load(Octree& octree, const std::string& filename, const Region& region, const unsigned int level)
+{
+    const std::vector<std::pair<Index, Index> > ranges = cover<Octree, Region>(octree, region, level);
+    return (ranges.empty()) ? (magrathea::FileSystem::exist(filename)) : (load(octree, filename, ranges));
+}
+
+// Flush a cone buffer
+/// \brief          Flush a cone buffer.
+/// \details        Appends the contents of a buffer of elements to a 
+///                 temporary cone file, with the same layout as saved 
+///                 octrees, and empties the buffer while keeping its 
+///                 capacity.
+/// \tparam         Buffer Buffer type.
+/// \param[in,out]  buffer Buffer of elements.
+/// \param[in]      filename File name.
+/// \return         True on success, false otherwise.
+template <class Buffer, class> 
+bool Input::flush(Buffer& buffer, const std::string& filename)
+{
+    std::ofstream stream(filename, std::ios::binary | std::ios::app);
+    bool ok = (stream) && (magrathea::DataHandler::rwrite(stream, buffer.data(), buffer.data()+buffer.size()));
+    stream.close();
+    buffer.clear();
+    return ok;
+}
+
+// Write indexed cone file
+/// \brief          Write indexed cone file.
+/// \details        Writes the octree in the version 2 cone format. The 
+///                 header contains a magic string, a byte order mark, the
+///                 version, the dimension, the sizes of the index, data and
+///                 element types, the range of levels, the bounding region,
+///                 the number of elements, the chunk size, the number of 
+///                 chunks and the offset of the footer. It is followed by 
+///                 the elements sorted by index in chunks of fixed size, 
+///                 and by a footer giving for each chunk its first and last
+///                 keys, its byte offset, its number of elements and its
+///                 checksum. The octree is updated before writing. With 
+///                 compression, the version is set to 3 and each chunk is
+///                 stored as its size in bytes followed by its encoded 
+///                 elements, chunks being encoded in parallel by batches.
+/// \tparam         Octree Octree type.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Dimension Number of dimensions.
+/// \tparam         Position Position of the hyperoctree center.
+/// \tparam         Extent Extent of the hyperoctree.
+/// \param[in,out]  octree Source octree.
+/// \param[in]      filename File name.
+/// \param[in]      chunk Number of elements per chunk.
+/// \param[in]      compression Compression of the chunks.
+/// \return         True on success, false otherwise.
+template <class Octree, class Element, class Index, unsigned int Dimension, class Position, class Extent, class> 
+bool Input::write(Octree& octree, const std::string& filename, const unsigned long long int chunk, const bool compression)
+{
+    // Initialization
+    static const std::string magic = "MAGCONE2";
+    const unsigned int version = 2+compression;
+    const unsigned long long int length = std::max(1ULL, chunk);
+    const unsigned long long int batch = std::max(1U, std::thread::hardware_concurrency())*4;
+    std::vector<std::vector<char> > encoded;
+    std::pair<unsigned int, unsigned int> levels(std::numeric_limits<unsigned int>::max(), 0);
+    std::array<double, Dimension+Dimension> region;
+    std::vector<std::tuple<Index, Index, unsigned long long int, unsigned long long int, unsigned long long int> > footer;
+    std::ofstream stream;
+    unsigned long long int size = 0;
+    unsigned long long int nchunks = 0;
+    unsigned long long int offset = 0;
+    std::streampos position;
+    bool ok = false;
+
+    // Compute the levels and the bounding region
+    size = octree.update().size();
+    nchunks = size/length+(size%length > 0);
+    std::fill(region.begin(), region.begin()+Dimension, std::numeric_limits<double>::max());
+    std::fill(region.begin()+Dimension, region.end(), -std::numeric_limits<double>::max());
+    for (unsigned long long int ielem = 0; ielem < size; ++ielem) {
+        levels.first = std::min(levels.first, static_cast<unsigned int>(std::get<0>(octree[ielem]).level()));
+        levels.second = std::max(levels.second, static_cast<unsigned int>(std::get<0>(octree[ielem]).level()));
+        for (unsigned int idim = 0; idim < Dimension; ++idim) {
+            region[idim] = std::min(region[idim], std::get<0>(octree[ielem]).template position<double, Position, Extent>(idim)-std::get<0>(octree[ielem]).template extent<double, Position, Extent>()/2);
+            region[Dimension+idim] = std::max(region[Dimension+idim], std::get<0>(octree[ielem]).template position<double, Position, Extent>(idim)+std::get<0>(octree[ielem]).template extent<double, Position, Extent>()/2);
+        }
+    }
+    levels.first = std::min(levels.first, levels.second);
+
+    // Write header, chunks and footer
+    if (!magrathea::FileSystem::exist(filename)) {
+        stream.open(filename, std::ios::binary);
+        if (stream) {
+            stream.write(magic.data(), magic.size());
+            magrathea::DataHandler::write(stream, magrathea::FileSystem::bom<unsigned int>(), version, Dimension, static_cast<unsigned int>(sizeof(Index)), static_cast<unsigned int>(sizeof(typename std::tuple_element<1, Element>::type)), static_cast<unsigned int>(sizeof(Element)), levels.first, levels.second);
+            magrathea::DataHandler::write(stream, region);
+            magrathea::DataHandler::write(stream, size, length, nchunks);
+            position = stream.tellp();
+            magrathea::DataHandler::write(stream, offset);
+            for (unsigned long long int ibatch = 0; ibatch < nchunks; ibatch += batch) {
+                encoded.assign((compression) ? (std::min(batch, nchunks-ibatch)) : (0), std::vector<char>());
+                Utility::parallelize(encoded.size(), [=, &octree, &encoded](const unsigned long long int i){Codec::encode(octree.data()+(ibatch+i)*length, octree.data()+std::min(size, (ibatch+i+1)*length), encoded[i]);});
+                for (unsigned long long int ichunk = ibatch; ichunk < std::min(nchunks, ibatch+batch); ++ichunk) {
+                    const Element* first = octree.data()+ichunk*length;
+                    const Element* last = octree.data()+std::min(size, (ichunk+1)*length);
+                    footer.push_back(std::make_tuple(std::get<0>(*first), std::get<0>(*(last-1)), static_cast<unsigned long long int>(stream.tellp()), static_cast<unsigned long long int>(last-first), checksum(reinterpret_cast<const char*>(first), reinterpret_cast<const char*>(last))));
+                    if (compression) {
+                        magrathea::DataHandler::write(stream, static_cast<unsigned long long int>(encoded[ichunk-ibatch].size()));
+                        stream.write(encoded[ichunk-ibatch].data(), encoded[ichunk-ibatch].size());
+                    } else {
+                        magrathea::DataHandler::rwrite(stream, first, last);
+                    }
+                }
+            }
+            offset = stream.tellp();
+            std::for_each(footer.begin(), footer.end(), [=, &stream](const std::tuple<Index, Index, unsigned long long int, unsigned long long int, unsigned long long int>& entry){magrathea::DataHandler::write(stream, entry);});
+            stream.seekp(position);
+            magrathea::DataHandler::write(stream, offset);
+            ok = stream.good();
+            stream.close();
+        }
+    }
+
+    // Finalization
+    return ok;
+}
+
+// Inspect indexed cone file
+/// \brief          Inspect indexed cone file.
+/// \details        Reads and checks the header of a version 2 or 3 cone 
+///                 file and its footer index. The magic string, the byte 
+///                 order, the dimension and the type sizes should match the
+///                 ones of the octree. The number of chunks is checked
+///                 against the file length and the number of elements of
+///                 each chunk against the chunk length, before anything is
+///                 allocated from these values.
+/// \tparam         Octree Octree type.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in]      octree Octree defining the element type.
+/// \param[in,out]  stream Input stream.
+/// \param[out]     version Version : 2 for raw chunks, 3 for compressed ones.
+/// \param[out]     levels Minimum and maximum levels.
+/// \param[out]     region Minimum and maximum coordinates of the cells.
+/// \param[out]     footer First key, last key, offset, number of elements
+///                 and checksum of each chunk.
+/// \return         True if the file is a valid indexed cone file, false 
+///                 otherwise.
+template <class Octree, class Element, class Index, unsigned int Dimension, class> 
+bool Input::inspect(const Octree& octree, std::istream& stream, unsigned int& version, std::pair<unsigned int, unsigned int>& levels, std::array<double, Dimension+Dimension>& region, std::vector<std::tuple<Index, Index, unsigned long long int, unsigned long long int, unsigned long long int> >& footer)
+{
+    // Initialization
+    static const std::string magic = "MAGCONE2";
+    std::string mark(magic.size(), char());
+    std::array<unsigned int, 6> types;
+    unsigned long long int size = 0;
+    unsigned long long int length = 0;
+    unsigned long long int nchunks = 0;
+    unsigned long long int offset = 0;
+    unsigned long long int end = 0;
+    bool ok = false;
+
+    // Read header
+    static_cast<void>(octree);
+    stream.seekg(0, std::ios::end);
+    end = stream.tellg();
+    stream.seekg(0, std::ios::beg);
+    stream.read(&mark[0], mark.size());
+    magrathea::DataHandler::read(stream, types);
+    magrathea::DataHandler::read(stream, levels.first, levels.second);
+    magrathea::DataHandler::read(stream, region);
+    magrathea::DataHandler::read(stream, size, length, nchunks, offset);
+    ok = (stream.good()) && (mark == magic) && (types[0] == magrathea::FileSystem::bom<unsigned int>()) && ((types[1] == 2) || (types[1] == 3)) && (types[2] == Dimension) && (types[3] == sizeof(Index)) && (types[4] == sizeof(typename std::tuple_element<1, Element>::type)) && (types[5] == sizeof(Element));
+
+    // Read footer
+    footer.clear();
+    version = (ok) ? (types[1]) : (0);
+    ok = (ok) && (offset <= end) && (nchunks <= (end-offset)/(sizeof(Index)+sizeof(Index)+3*sizeof(unsigned long long int)));
+    if (ok) {
+        footer.resize(nchunks);
+        stream.seekg(offset, std::ios::beg);
+        for (unsigned long long int ichunk = 0; (ok) && (ichunk < nchunks); ++ichunk) {
+            ok = (magrathea::DataHandler::read(stream, footer[ichunk])) && (std::get<3>(footer[ichunk]) <= length) && (std::get<2>(footer[ichunk]) < offset);
+            ok = (ok) && ((version != 2) || (std::get<3>(footer[ichunk]) <= (offset-std::get<2>(footer[ichunk]))/sizeof(Element)));
+        }
+        ok = (ok) && (std::accumulate(footer.begin(), footer.end(), 0ULL, [](const unsigned long long int sum, const std::tuple<Index, Index, unsigned long long int, unsigned long long int, unsigned long long int>& entry){return sum+std::get<3>(entry);}) == size);
+    }
+
+    // Finalization
+    if (!ok) {
+        version = 0;
+        footer.clear();
+    }
+    return ok;
+}
+
+// Read key ranges of an indexed cone file
+/// \brief          Read key ranges of an indexed cone file.
+/// \details        Appends to the octree the elements of a version 2 cone
+///                 file whose keys belong to one of the provided inclusive
+///                 ranges. Only the chunks overlapping a range are read,
+///                 using the footer index to seek them, and ranges are 
+///                 sorted and merged so that each selection test is a 
+///                 binary search. Compressed chunks are read by batches
+///                 and decoded in parallel. An empty list of ranges 
+///                 selects the whole file.
+/// \tparam         Octree Octree type.
+/// \tparam         Ranges Container of pairs of first and last keys.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in,out]  octree Destination octree.
+/// \param[in]      filename File name.
+/// \param[in]      ranges Ranges of keys.
+/// \return         True on success, false otherwise.
+template <class Octree, class Ranges, class Element, class Index, unsigned int Dimension, class> 
+bool Input::read(Octree& octree, const std::string& filename, const Ranges& ranges)
+{
+    // Initialization
+    const unsigned long long int original = octree.size();
+    std::ifstream stream(filename, std::ios::binary);
+    std::pair<unsigned int, unsigned int> levels;
+    std::array<double, Dimension+Dimension> region;
+    std::vector<std::tuple<Index, Index, unsigned long long int, unsigned long long int, unsigned long long int> > footer;
+    const std::vector<std::pair<Index, Index> > selection = normalize<Index>(ranges);
+    auto selected = [=, &ranges, &selection](const Index& first, const Index& last){return (ranges.empty()) || (overlap(selection, first, last));};
+    const unsigned long long int batch = std::max(1U, std::thread::hardware_concurrency())*4;
+    const long long int length = magrathea::FileSystem::size(stream);
+    std::vector<unsigned long long int> chunks;
+    std::vector<unsigned long long int> positions;
+    std::vector<std::vector<char> > encoded;
+    std::vector<unsigned int> decoded;
+    unsigned long long int size = original;
+    unsigned long long int nbytes = 0;
+    unsigned long long int count = 0;
+    unsigned int version = 0;
+    bool ok = (stream) && (inspect(octree, stream, version, levels, region, footer));
+
+    // Read selected chunks
+    if (ok) {
+        octree.reserve(original+(version == 2)*std::accumulate(footer.begin(), footer.end(), 0ULL, [=](const unsigned long long int sum, const std::tuple<Index, Index, unsigned long long int, unsigned long long int, unsigned long long int>& entry){return sum+std::get<3>(entry)*selected(std::get<0>(entry), std::get<1>(entry));}));
+        for (unsigned long long int ichunk = 0; ichunk < footer.size(); ++ichunk) {
+            if (selected(std::get<0>(footer[ichunk]), std::get<1>(footer[ichunk]))) {
+                chunks.push_back(ichunk);
+            }
+        }
+        for (unsigned long long int ibatch = 0; (ok) && (ibatch < chunks.size()); ibatch += batch) {
+            positions.assign(1, size);
+            for (unsigned long long int i = ibatch; i < std::min(static_cast<unsigned long long int>(chunks.size()), ibatch+batch); ++i) {
+                positions.push_back(positions.back()+std::get<3>(footer[chunks[i]]));
+            }
+            encoded.resize(positions.size()-1);
+            decoded.assign(positions.size()-1, version == 2);
+            for (unsigned long long int i = 0; (ok) && (version != 2) && (i < encoded.size()); ++i) {
+                stream.seekg(std::get<2>(footer[chunks[ibatch+i]]), std::ios::beg);
+                ok = (magrathea::DataHandler::read(stream, nbytes)) && (length >= 0) && (nbytes <= static_cast<unsigned long long int>(length));
+                encoded[i].resize(nbytes*ok);
+                ok = (ok) && (stream.read(encoded[i].data(), encoded[i].size())) && (Codec::count(encoded[i].data(), encoded[i].data()+encoded[i].size(), count)) && (count == positions[i+1]-positions[i]);
+            }
+            if (ok) {
+                octree.resize(positions.back());
+            }
+            for (unsigned long long int i = 0; (ok) && (version == 2) && (i < encoded.size()); ++i) {
+                stream.seekg(std::get<2>(footer[chunks[ibatch+i]]), std::ios::beg);
+                ok = magrathea::DataHandler::rread(stream, octree.data()+positions[i], octree.data()+positions[i+1]);
+            }
+            Utility::parallelize(encoded.size()*((ok) && (version != 2)), [=, &octree, &encoded, &decoded, &positions](const unsigned long long int i){decoded[i] = Codec::decode(encoded[i].data(), encoded[i].data()+encoded[i].size(), octree.data()+positions[i], positions[i+1]-positions[i]);});
+            ok = (ok) && (std::all_of(decoded.begin(), decoded.end(), [](const unsigned int flag){return flag != 0;}));
+            if (!ranges.empty()) {
+                size = std::distance(octree.data(), std::remove_if(octree.data()+size, octree.data()+octree.size(), [=](const Element& element){return !selected(std::get<0>(element), std::get<0>(element));}));
+                octree.resize(size);
+            }
+            size = octree.size();
+        }
+        stream.close();
+    }
+
+    // Finalization
+    return ok;
+}
+
+// Read a key range of an indexed cone file
+/// \brief          Read a key range of an indexed cone file.
+/// \details        Appends to the octree the elements of a version 2 cone
+///                 file whose keys are between the first and the last ones.
+/// \tparam         Octree Octree type.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in,out]  octree Destination octree.
+/// \param[in]      filename File name.
+/// \param[in]      first First key of the range.
+/// \param[in]      last Last key of the range.
+/// \return         True on success, false otherwise.
+template <class Octree, class Element, class Index, unsigned int Dimension, class> 
+bool Input::read(Octree& octree, const std::string& filename, const Index& first, const Index& last)
+{
+    return read(octree, filename, std::vector<std::pair<Index, Index> >(1, std::make_pair(first, last)));
+}
+
+// Verify indexed cone file
+/// \brief          Verify indexed cone file.
+/// \details        Checks the integrity of a version 2 cone file by reading
+///                 and decoding each chunk and comparing its checksum and 
+///                 its keys with the footer index.
+/// \tparam         Octree Octree type.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Dimension Number of dimensions.
+/// \param[in]      octree Octree defining the element type.
+/// \param[in]      filename File name.
+/// \return         True if the file is valid, false otherwise.
+template <class Octree, class Element, class Index, unsigned int Dimension, class> 
+bool Input::verify(const Octree& octree, const std::string& filename)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    const long long int length = magrathea::FileSystem::size(stream);
+    std::pair<unsigned int, unsigned int> levels;
+    std::array<double, Dimension+Dimension> region;
+    std::vector<std::tuple<Index, Index, unsigned long long int, unsigned long long int, unsigned long long int> > footer;
+    std::vector<Element> elements;
+    std::vector<char> encoded;
+    unsigned long long int nbytes = 0;
+    unsigned long long int count = 0;
+    unsigned int version = 0;
+    bool ok = (stream) && (inspect(octree, stream, version, levels, region, footer));
+    for (unsigned long long int ichunk = 0; (ok) && (ichunk < footer.size()); ++ichunk) {
+        stream.seekg(std::get<2>(footer[ichunk]), std::ios::beg);
+        if (version == 2) {
+            elements.resize(std::get<3>(footer[ichunk]));
+            ok = magrathea::DataHandler::rread(stream, elements.data(), elements.data()+elements.size());
+        } else {
+            ok = (magrathea::DataHandler::read(stream, nbytes)) && (length >= 0) && (nbytes <= static_cast<unsigned long long int>(length));
+            encoded.resize(nbytes*ok);
+            ok = (ok) && (stream.read(encoded.data(), encoded.size())) && (Codec::count(encoded.data(), encoded.data()+encoded.size(), count)) && (count == std::get<3>(footer[ichunk]));
+            elements.resize(count*ok);
+            ok = (ok) && (Codec::decode(encoded.data(), encoded.data()+encoded.size(), elements.data(), elements.size()));
+        }
+        ok = (ok) && (!elements.empty());
+        ok = (ok) && (checksum(reinterpret_cast<const char*>(elements.data()), reinterpret_cast<const char*>(elements.data()+elements.size())) == std::get<4>(footer[ichunk]));
+        ok = (ok) && (std::get<0>(elements.front()) == std::get<0>(footer[ichunk])) && (std::get<0>(elements.back()) == std::get<1>(footer[ichunk]));
+    }
+    return ok;
+}
+
+// Normalize key ranges
+/// \brief          Normalize key ranges.
+/// \details        Sorts inclusive ranges of keys, drops the empty ones and
+///                 merges the overlapping or adjacent ones.
+/// \tparam         Index Index type.
+/// \tparam         Ranges Container of pairs of first and last keys.
+/// \tparam         Integer Underlying integer type of the index.
+/// \param[in]      ranges Ranges of keys.
+/// \return         Sorted disjoint ranges.
+template <class Index, class Ranges, class Integer, class> 
+std::vector<std::pair<Index, Index> > Input::normalize(const Ranges& ranges)
+{
+    std::vector<std::pair<Index, Index> > result(std::begin(ranges), std::end(ranges));
+    unsigned long long int size = 0;
+    result.erase(std::remove_if(result.begin(), result.end(), [](const std::pair<Index, Index>& range){return std::get<1>(range) < std::get<0>(range);}), result.end());
+    std::sort(result.begin(), result.end(), [](const std::pair<Index, Index>& lhs, const std::pair<Index, Index>& rhs){return std::get<0>(lhs) < std::get<0>(rhs);});
+    for (unsigned long long int i = 0; i < result.size(); ++i) {
+        if ((size > 0) && ((!(std::get<1>(result[size-1]) < std::get<0>(result[i]))) || (static_cast<Integer>(std::get<0>(result[i]))-static_cast<Integer>(std::get<1>(result[size-1])) == Integer(1)))) {
+            std::get<1>(result[size-1]) = std::max(std::get<1>(result[size-1]), std::get<1>(result[i]));
+        } else {
+            result[size++] = result[i];
+        }
+    }
+    result.resize(size);
+    return result;
+}
+
+// Overlap with key ranges
+/// \brief          Overlap with key ranges.
+/// \details        Checks whether an inclusive interval of keys overlaps 
+///                 one of the normalized ranges using a binary search.
+/// \tparam         Index Index type.
+/// \param[in]      ranges Normalized ranges of keys.
+/// \param[in]      first First key of the interval.
+/// \param[in]      last Last key of the interval.
+/// \return         True if overlap, false otherwise.
+template <class Index> 
+inline bool Input::overlap(const std::vector<std::pair<Index, Index> >& ranges, const Index& first, const Index& last)
+{
+    const typename std::vector<std::pair<Index, Index> >::const_iterator iterator = std::lower_bound(ranges.begin(), ranges.end(), first, [](const std::pair<Index, Index>& range, const Index& key){return std::get<1>(range) < key;});
+    return (iterator != ranges.end()) && (!(last < std::get<0>(*iterator)));
+}
+
+// Key ranges covering a region
+/// \brief          Key ranges covering a region.
+/// \details        Computes the ranges of keys of the cells needed to 
+///                 interpolate the data inside a geometrical region. The 
+///                 tree is walked from the root and a cell is kept when its
+///                 bounding sphere, enlarged by one cell in each direction
+///                 to include the interpolation neighbours, collides with 
+///                 the region. Kept cells coarser than the provided level 
+///                 contribute their own key, so that coarse fallbacks 
+///                 remain available, and kept cells at this level 
+///                 contribute the key range of their whole subtree.
+/// \tparam         Octree Octree type.
+/// \tparam         Region Region type : hypersphere, hypercube or cone.
+/// \tparam         Type Scalar position type.
+/// \tparam         Element Underlying element type.
+/// \tparam         Index Index type.
+/// \tparam         Integer Underlying integer type of the index.
+/// \tparam         Dimension Number of dimensions.
+/// \tparam         Position Position of the hyperoctree center.
+/// \tparam         Extent Extent of the hyperoctree.
+/// \tparam         Sphere Sphere type used for collisions.
+/// \param[in]      octree Octree defining the geometry.
+/// \param[in]      region Geometrical region.
+/// \param[in]      level Level at which the region is resolved.
+/// \return         Normalized ranges of keys.
+template <class Octree, class Region, typename Type, class Element, class Index, class Integer, unsigned int Dimension, class Position, class Extent, class Sphere, class> 
+std::vector<std::pair<Index, Index> > Input::cover(const Octree& octree, const Region& region, const unsigned int level)
+{
+    static const Integer one = Integer(1);
+    const unsigned int finest = std::min(level, Index::refinements());
+    const Type factor = Type(3)*std::sqrt(Type(Dimension))/Type(2*(sizeof(octree)/sizeof(octree)));
+    std::vector<std::pair<Index, Index> > ranges;
+    std::vector<Index> stack(1, Index());
+    Sphere spherified = Sphere();
+    Index index = Index();
+    while (!stack.empty()) {
+        index = stack.back();
+        stack.pop_back();
+        for (unsigned int idim = 0; idim < Dimension; ++idim) { 
+            spherified.position(idim) = index.template position<Type, Position, Extent>(idim); 
+        }
+        spherified.extent() = index.template extent<Type, Position, Extent>()*factor;
+        if (Utility::collide(spherified, region)) {
+            if (index.level() < finest) {
+                ranges.push_back(std::make_pair(index, index));
+                for (unsigned int isite = (1U << Dimension); isite > 0; --isite) {
+                    stack.push_back(index.child(isite-1));
+                }
+            } else {
+                ranges.push_back(std::make_pair(index, Index(static_cast<Integer>(index) | ((index.level() > 0) ? ((one << (Index::bits()-index.level()*(Dimension+1)))-one) : (~Integer())))));
+            }
+        }
+    }
+    return normalize<Index>(ranges);
+}
 // -------------------------------------------------------------------------- //
 
 
@@ -899,7 +1999,8 @@ bool Input::load(Octree& octree, const std::string& filename)
 // Cosmology correction
 /// \brief          Cosmology correction.
 /// \details        Produces another cosmology based on interpolation of an 
-///                 homogeneous trajectory.
+///                 homogeneous trajectory. The abscissae are kept so that
+///                 a tabulated cosmology remains tabulated.
 /// \tparam         Cosmology Cosmology container type.
 /// \tparam         Trajectory Trajectory container.
 /// \tparam         Type Data type.
@@ -935,12 +2036,20 @@ Cosmology Input::correct(const Cosmology& cosmology, const Trajectory& trajector
     }
     
     // Finalization
-    return result;
+    return tabulate(result);
 }
 
 // Octree correction
 /// \brief          Octree correction.
-/// \details        Corrects uncomplete tree and zones with empty rho.
+/// \details        Corrects uncomplete tree and zones with empty rho. The
+///                 sorted elements are swept once by parallel chunks with 
+///                 a stack of the last element met at each level, which
+///                 gives the nearest ancestor of each element and its 
+///                 corrected value without any search. A refined element 
+///                 is incomplete when one of its children is missing after
+///                 the one holding its first descendant, which is the set 
+///                 of elements the search based detection refines or 
+///                 coarsens.
 /// \tparam         Check Check mode.
 /// \tparam         Selection Index of the data to be corrected.
 /// \tparam         Octree Octree type.
@@ -966,6 +2075,7 @@ Octree& Input::correct(Octree& octree, bool complete, bool coarse, const bool ac
     static const unsigned int reservation = 1<<20;
     static const int zero = 0;
     static const int one = 1;
+    static const int two = 2;
     unsigned int size = octree.update().size();
     unsigned int ncoarse = (!octree.empty()) ? (std::get<0>(*std::min_element(octree.begin(), octree.end(), [](const Element& x, const Element& y){return std::get<0>(x).level() < std::get<0>(y).level();})).level()) : (zero);
     unsigned int nmax = (!octree.empty()) ? (std::get<0>(*std::max_element(octree.begin(), octree.end(), [](const Element& x, const Element& y){return std::get<0>(x).level() < std::get<0>(y).level();})).level()) : (zero);
@@ -977,12 +2087,15 @@ Octree& Input::correct(Octree& octree, bool complete, bool coarse, const bool ac
     std::vector<Type> a;
     std::mutex mutex;
     std::atomic<unsigned int> distance(static_cast<unsigned int>(zero));
+    const unsigned int full = (Index::sites() < sizeof(unsigned int)*std::numeric_limits<unsigned char>::digits) ? ((1U << Index::sites())-one) : (~0U);
+    const unsigned int nchunks = std::max(1U, std::thread::hardware_concurrency())*4;
+    std::vector<unsigned int> parents;
     
     // Correct coarse level
     if (Check >= zero) {
         if (coarse) {
             Utility::parallelize(size, [=, &ncoarse, &count, &octree](const unsigned int i){count[i] = ((std::get<0>(octree[i]).level() == ncoarse) && (!std::isnormal(std::get<1>(octree[i]).template data<Selection>())));});
-            std::for_each(count.begin(), count.end(), [=, &counter](unsigned int& i){i = (i > zero) ? (++counter) : (zero);});
+            counter = Utility::compact(count.begin(), count.end());
             index.resize(counter);
             Utility::parallelize(size, [=, &count, &index](const unsigned int i){if (count[i] > zero) {index[count[i]-one] = i;}});
             data.resize(counter);
@@ -992,15 +2105,59 @@ Octree& Input::correct(Octree& octree, bool complete, bool coarse, const bool ac
         }
     }
     
+    // Sweep the sorted elements once with a stack of ancestors per level
+    auto sweep = [=, &octree, &parents, &data](const bool fill){
+        const unsigned int length = octree.size()/nchunks+one;
+        parents.assign(octree.size(), zero);
+        data.resize(octree.size()*fill);
+        Utility::parallelize(nchunks, [=, &octree, &parents, &data](const unsigned int ichunk){
+            const unsigned int first = std::min(static_cast<unsigned int>(octree.size()), ichunk*length);
+            const unsigned int last = std::min(static_cast<unsigned int>(octree.size()), first+length);
+            std::vector<unsigned int> stack(nmax+one, zero);
+            std::vector<Type> values(nmax+one);
+            std::vector<Index> chain;
+            unsigned int level = zero;
+            auto ancestor = [=, &octree, &stack](const unsigned int j, const unsigned int l){
+                unsigned int result = zero;
+                for (unsigned int k = l; (result == zero) && (k > zero); --k) {
+                    result = ((stack[k-one] > zero) && (std::get<0>(octree[stack[k-one]-one]).containing(std::get<0>(octree[j])))) ? (stack[k-one]) : (zero);
+                }
+                return result;
+            };
+            auto resolve = [=, &octree, &values](const unsigned int j, const unsigned int l, const unsigned int p){
+                const Type value = std::get<1>(octree[j]).template data<Selection>();
+                return ((fill) && (!std::isnormal(value)) && (l > ncoarse) && (p > zero)) ? (values[std::get<0>(octree[p-one]).level()]) : (value);
+            };
+            if (first < last) {
+                for (chain.assign(one, std::get<0>(octree[first])); chain.back().level() > ncoarse; chain.push_back(chain.back().parent())) {
+                    ;
+                }
+                for (unsigned int i = chain.size()-one; i > zero; --i) {
+                    level = chain[i].level();
+                    stack[level] = ((octree.find(chain[i]) != octree.end()) && (std::get<0>(*octree.find(chain[i])) == chain[i])) ? (std::distance(octree.begin(), octree.find(chain[i]))+one) : (zero);
+                    values[level] = (stack[level] > zero) ? (resolve(stack[level]-one, level, ancestor(stack[level]-one, level))) : (Type());
+                }
+            }
+            for (unsigned int i = first; i < last; ++i) {
+                level = std::get<0>(octree[i]).level();
+                parents[i] = ancestor(i, level);
+                values[level] = resolve(i, level, parents[i]);
+                stack[level] = i+one;
+                if (fill) {
+                    data[i] = values[level];
+                }
+            }
+        });
+    };
+    
     // Correct refined levels
     if (Check >= zero) {
         if (complete) {
-            for (unsigned int n = ncoarse; n <= nmax; ++n) {
-                Utility::parallelize(size, [=, &count, &octree](const unsigned int i){count[i] = ((std::get<0>(octree[i]).level() == n) && (!std::isnormal(std::get<1>(octree[i]).template data<Selection>())));});
-                Utility::parallelize(size, [=, &count, &octree](const unsigned int i){if (count[i] > zero) {std::get<1>(octree[i]).template data<Selection>() = std::get<1>(*octree.find(std::get<0>(octree[i]).parent())).template data<Selection>();}});
-            }
+            sweep(true);
+            Utility::parallelize(size, [=, &data, &octree](const unsigned int i){std::get<1>(octree[i]).template data<Selection>() = data[i];});
         } else {
-            Utility::parallelize(size, [=, &ncoarse, &count, &octree](const unsigned int i){if ((std::get<0>(octree[i]).level() > ncoarse) && (!std::isnormal(std::get<1>(octree[i]).template data<Selection>()))) {count[i] = std::distance(octree.begin(), octree.find(std::get<0>(octree[i]).parent()))+one;}});
+            sweep(false);
+            Utility::parallelize(size, [=, &ncoarse, &count, &parents, &octree](const unsigned int i){if ((std::get<0>(octree[i]).level() > ncoarse) && (!std::isnormal(std::get<1>(octree[i]).template data<Selection>()))) {count[i] = parents[i];}});
             count.erase(std::remove(count.begin(), count.end(), zero), count.end());
             Utility::parallelize(count.begin(), count.end(), [](unsigned int& i){--i;});
             std::sort(count.begin(), count.end());
@@ -1019,15 +2176,22 @@ Octree& Input::correct(Octree& octree, bool complete, bool coarse, const bool ac
     }
     
     // Detect non complete zones
+    if ((Check < zero) || (!complete)) {
+        sweep(false);
+    }
+    for (unsigned int i = 0; i < size; ++i) {
+        if ((parents[i] > zero) && (std::get<0>(octree[parents[i]-one]).level()+one == std::get<0>(octree[i]).level())) {
+            count[parents[i]-one] |= (one << std::get<0>(octree[i]).site());
+        }
+    }
+    Utility::parallelize(size, [=, &count, &octree](const unsigned int i){Index next = (i+one < size) ? (std::get<0>(octree[i+one])) : (Index()); if (!octree.leaf(octree.begin()+i)) {while (next.level() > std::get<0>(octree[i]).level()+one) {next = next.parent();} count[i] = ((count[i] | ((two << next.site())-one)) != full);} else {count[i] = zero;}});
     if (complete) {
-        Utility::parallelize(size, [=, &count, &octree](const unsigned int i){if (!octree.leaf(octree.begin()+i)) {for (unsigned int j = 0; j < Index::sites(); ++j) {count[i] += (octree.find(std::get<0>(octree[i]).child(j)) == octree.end());}}});
         for (unsigned int i = 0; i < size; ++i) {
             if (count[i] > zero) {
                 octree.refine(octree.begin()+i);
             }
         }
     } else {
-        Utility::parallelize(size, [=, &count, &octree](const unsigned int i){if (!octree.leaf(octree.begin()+i)) {for (unsigned int j = 0; j < Index::sites(); ++j) {count[i] += (octree.find(std::get<0>(octree[i]).child(j)) == octree.end());}}});
         for (unsigned int i = 0; i < size; ++i) {
             if (count[i] > zero) {
                 if (!std::get<0>(octree[i]).invalidated()) {
@@ -1090,9 +2254,14 @@ int Input::example()
     magrathea::HyperSphere<3> sphere = magrathea::HyperSphere<3>::unit();
     Cone<> cone(first, second, 0.42);
     std::vector<std::string> list;
+    std::vector<Cone<> > cones(2, cone);
+    std::vector<std::vector<unsigned int> > candidates;
+    std::vector<std::vector<decltype(octree.element())> > buffers(cones.size());
+    Mapping mapping("/tmp/file_00001");
     std::array<std::vector<double>, 4> cosmology;
     std::vector<Photon<double, 3> > trajectory;
     std::string string;
+    bool flag = false;
     
     // Construction
     Input input;
@@ -1108,8 +2277,11 @@ int Input::example()
     std::cout<<std::setw(width*3)<<"Utilities : "                                                                                                               <<std::endl;
     std::cout<<std::setw(width*3)<<"input.trim(string) : "                                                                                                      <<input.trim(string)<<std::endl;
     std::cout<<std::setw(width*3)<<"input.partition(string).first : "                                                                                           <<input.partition(string).first<<std::endl;
+    std::cout<<std::setw(width*3)<<"input.checksum(string.data(), string.data()) : "                                                                            <<input.checksum(string.data(), string.data())<<std::endl;
     std::cout<<std::setw(width*3)<<"input.count(counter, ftree) : "                                                                                             <<input.count(counter, ftree)<<std::endl;
     std::cout<<std::setw(width*3)<<"input.collide(octree, std::get<0>(octree[0]), sphere, cone) : "                                                             <<input.collide(octree, std::get<0>(octree[0]), sphere, cone)<<std::endl;
+    std::cout<<std::setw(width*3)<<"input.collide(octree, &std::get<0>(octree[0]), &std::get<0>(octree[0])+1, sphere, cone, &flag) : "                       <<input.collide(octree, &std::get<0>(octree[0]), &std::get<0>(octree[0])+1, sphere, cone, &flag)<<std::endl;
+    std::cout<<std::setw(width*3)<<"input.classify(octree, std::get<0>(octree[0]), sphere, cone) : "                                                            <<input.classify(octree, std::get<0>(octree[0]), sphere, cone)<<std::endl;
     std::cout<<std::setw(width*3)<<"input.mean(octree, octree[1]) : "                                                                                           <<input.mean(octree, octree[1])<<std::endl;
     std::cout<<std::setw(width*3)<<"input.constantify(100, 0., 42., 1., 0., 0.).size() : "                                                                      <<input.constantify(100, 0., 42., 1., 0., 0.).size()<<std::endl;
     std::cout<<std::setw(width*3)<<"input.sistemize(std::get<1>(octree[0]), 0.5, 0.72, 0.3, 21000.) : "                                                         <<input.sistemize(std::get<1>(octree[0]), 0.5, 0.72, 0.3, 21000.)<<std::endl;
@@ -1124,19 +2296,38 @@ int Input::example()
     std::cout<<std::setw(width*2)<<"Files : "                                                                           <<std::endl;
     std::cout<<std::setw(width*2)<<"input.filetree(ftree, \"/tmp/\", \"file_%05d\") : "                                 <<input.filetree(ftree, "/tmp/", "file_%05d")<<std::endl;
     std::cout<<std::setw(width*2)<<"input.prepare(list, ftree, sphere, cone) : "                                        <<input.prepare(list, ftree, sphere, cone)<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.distribute(candidates, ftree, sphere, cones) : "                              <<input.distribute(candidates, ftree, sphere, cones)<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.cull(ftree, sphere, cone, 2).size() : "                                       <<input.cull(ftree, sphere, cone, 2).size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.decide(input.cull(ftree, sphere, cone, 2), std::get<0>(ftree[0])) : "        <<input.decide(input.cull(ftree, sphere, cone, 2), std::get<0>(ftree[0]))<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.select(ftree, sphere, cone).size() : "                                        <<input.select(ftree, sphere, cone).size()<<std::endl;
 
     // Data
     std::cout<<std::endl;
     std::cout<<std::setw(width*3)<<"Data : "                                                                                                                    <<std::endl;
     std::cout<<std::setw(width*3)<<"input.import(octree, \"/tmp/file_00001\", 13, [](const decltype(octree.element())&){return true;}) : "                      <<input.import(octree, "/tmp/file_00001", 13, [](const decltype(octree.element())&){return true;})<<std::endl;
+    std::cout<<std::setw(width*3)<<"input.import(octree, {\"/tmp/file_00001\"}, 13, [](const decltype(octree.element())&){return true;}) : "                    <<input.import(octree, std::vector<std::string>({"/tmp/file_00001"}), 13, [](const decltype(octree.element())&){return true;})<<std::endl;
+    std::cout<<std::setw(width*3)<<"input.pipeline(octree, list, 13, [](unsigned int, const decltype(octree.element())&){return true;}, consumer) : "           <<input.pipeline(octree, list, 13, [](unsigned int, const decltype(octree.element())&){return true;}, [](unsigned int, std::vector<decltype(octree.element())>&){;})<<std::endl;
+    std::cout<<std::setw(width*3)<<"input.decode<decltype(octree.element())>(mapping, 3, 13, 0) : "                                                             <<((mapping.index() > 3) ? (std::get<0>(input.decode<decltype(octree.element())>(mapping, 3, 13, 0))) : (std::get<0>(octree.element())))<<std::endl;
+    std::cout<<std::setw(width*3)<<"input.scatter(octree, buffers, list, 13, sphere, cones, candidates, function) : "                                           <<input.scatter(octree, buffers, list, 13, sphere, cones, candidates, [](std::vector<decltype(octree.element())>&, unsigned int){;})<<std::endl;
     std::cout<<std::setw(width*3)<<"input.acquire(string, string, string, first[0], first[1], first[2]).size() : "                                              <<input.acquire(string, string, string, first[0], first[1], first[2]).size()<<std::endl;
     std::cout<<std::setw(width*3)<<"input.parse(string, \"=\", \"#\").size() : "                                                                                <<input.parse(string, "=", "#").size()<<std::endl;
     
     // Cones
     std::cout<<std::endl;
-    std::cout<<std::setw(width)<<"Cones : "                                     <<std::endl;
-    std::cout<<std::setw(width)<<"input.save(counter, \"/tmp/file_00000\") : "  <<input.save(counter, "/tmp/file_00000")<<std::endl;
-    std::cout<<std::setw(width)<<"input.load(counter, \"/tmp/file_00000\") : "  <<input.load(counter, "/tmp/file_00000")<<std::endl;
+    std::cout<<std::setw(width*2)<<"Cones : "                                                                           <<std::endl;
+    std::cout<<std::setw(width*2)<<"input.save(counter, \"/tmp/file_00000\") : "                                        <<input.save(counter, "/tmp/file_00000")<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.load(counter, \"/tmp/file_00000\") : "                                        <<input.load(counter, "/tmp/file_00000")<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.flush(buffers[0], \"/tmp/file_00002\") : "                                    <<input.flush(buffers[0], "/tmp/file_00002")<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.write(octree, \"/tmp/file_00004\", 2) : "                                     <<input.write(octree, "/tmp/file_00004", 2)<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.write(octree, \"/tmp/file_00005\", 2, true) : "                               <<input.write(octree, "/tmp/file_00005", 2, true)<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.verify(octree, \"/tmp/file_00005\") : "                                       <<input.verify(octree, "/tmp/file_00005")<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.read(octree, \"/tmp/file_00004\", first, last) : "                            <<input.read(octree, "/tmp/file_00004", std::get<0>(octree[0]), std::get<0>(octree[1]))<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.verify(octree, \"/tmp/file_00004\") : "                                       <<input.verify(octree, "/tmp/file_00004")<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.load(octree, \"/tmp/file_00004\", ranges) : "                               <<input.load(octree, "/tmp/file_00004", input.cover(octree, sphere, 2))<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.load(octree, \"/tmp/file_00004\", sphere, 2) : "                            <<input.load(octree, "/tmp/file_00004", sphere, 2)<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.normalize<index>(input.cover(octree, cone, 2)).size() : "                     <<input.normalize<std::tuple_element<0, decltype(octree.element())>::type>(input.cover(octree, cone, 2)).size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.overlap(input.cover(octree, cone, 2), first, last) : "                        <<input.overlap(input.cover(octree, cone, 2), std::get<0>(octree[0]), std::get<0>(octree[1]))<<std::endl;
+    std::cout<<std::setw(width*2)<<"input.cover(octree, cone, 2).size() : "                                             <<input.cover(octree, cone, 2).size()<<std::endl;
     
     // Correction
     std::cout<<std::endl;
@@ -24,6 +24,7 @@
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <sstream>
 #include <type_traits>
 #include <limits>
 #include <string>
@@ -32,6 +33,8 @@
 #include <array>
 #include <cmath>
 #include <random>
+#include <atomic>
+#include <mutex>
 // Include libs
 // Include project
 #include "../magrathea/simplehyperoctree.h"
@@ -44,6 +47,10 @@
 #include "photon.h"
 #include "cone.h"
 #include "output.h"
+#include "expansion.h"
+#include "pool.h"
+#include "timeline.h"
+#include "writer.h"
 // Misc
 // -------------------------------------------------------------------------- //
 
@@ -70,6 +77,14 @@ class Integrator final
     /// \name           Computation
     //@{
     public:
+        template <unsigned int Column, class Cosmology, typename Type, class = typename std::enable_if<(Column > 0) && (Column < std::tuple_size<Cosmology>::value)>::type> static inline Type evaluate(const Cosmology& cosmology, const Type t);
+        template <unsigned int Column, typename Kind, typename Type, class = typename std::enable_if<(Column > 0) && (Column < std::tuple_size<Expansion<Kind> >::value)>::type> static inline Type evaluate(const Expansion<Kind>& cosmology, const Type t);
+        template <class Trajectory> static constexpr bool halt(std::nullptr_t, const Trajectory&);
+        template <class Predicate, class Trajectory, class = typename std::enable_if<!std::is_same<typename std::decay<Predicate>::type, std::nullptr_t>::value>::type> static inline bool halt(Predicate&& predicate, const Trajectory& trajectory);
+        template <int Order = 1, class Octree, typename Type, class Data = typename std::tuple_element<1, decltype(Octree::element())>::type> static inline Data sample(const Octree& octree, const Type x, const Type y, const Type z, const Type t);
+        template <int Order = 1, class Octree, typename Kind, typename Type, class Data = typename std::tuple_element<1, decltype(Octree::element())>::type> static inline Data sample(const Timeline<Octree, Kind>& timeline, const Type x, const Type y, const Type z, const Type t);
+        template <class Function> static inline void execute(std::nullptr_t, const unsigned int nsteps, Function&& function);
+        template <class Executor, class Function, class = typename std::enable_if<!std::is_same<typename std::decay<Executor>::type, std::nullptr_t>::value>::type> static inline void execute(Executor&& executor, const unsigned int nsteps, Function&& function);
         template <int Order = 1, class Array, class Cosmology, class Octree, class Type, class Schwarzschild = std::true_type, unsigned int Dimension = Octree::dimension(), class Data = typename std::tuple_element<1, decltype(Octree::element())>::type, class Position = decltype(Octree::position()), class Extent = decltype(Octree::extent()), class = typename std::enable_if<((std::is_arithmetic<Schwarzschild>::value) || (std::is_same<Schwarzschild, std::true_type>::value)) && (Dimension == 3) && (std::is_convertible<Type, typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Array>()[0])>::type>::type>::value)>::type> static Array& dphotondl(Array& output, const Array& input, const Cosmology& cosmology, const Octree& octree, const Type length, const Type dl, const Type phi, const Schwarzschild mass = Schwarzschild());
     //@}
 
@@ -77,8 +92,10 @@ class Integrator final
     /// \name           Evolution
     //@{
     public:
-        template <int Order = 1, bool RK4 = true, bool Verbose = false, class Cosmology, class Octree, class Type, class Trajectory, class Schwarzschild = std::true_type, unsigned int Dimension = Octree::dimension(), class Element = typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Trajectory>()[0])>::type>::type, class Data = typename std::tuple_element<1, decltype(Octree::element())>::type, class Core = decltype(Element::template type<1>()), unsigned int Size = std::tuple_size<Core>::value, class Position = decltype(Octree::position()), class Extent = decltype(Octree::extent()), class = typename std::enable_if<((std::is_arithmetic<Schwarzschild>::value) || (std::is_same<Schwarzschild, std::true_type>::value)) && (Dimension == 3)>::type> static Trajectory& integrate(Trajectory& trajectory, const Cosmology& cosmology, const Octree& octree, const Type length, const unsigned int nsteps = 1, const Schwarzschild mass = Schwarzschild());
-        template <int Order = 1, bool RK4 = true, bool Verbose = false, class Cosmology, class Octree, class Type, unsigned int Dimension, class Homogeneous = std::vector<Photon<Type, Dimension> >, class = typename std::enable_if<(Dimension == 3) && (Dimension == Octree::dimension())>::type> static magrathea::Evolution<Photon<Type, Dimension> > propagate(const Photon<Type, Dimension>& photon, const unsigned int count, const Type angle, const Type rotation, const std::string& interpolation, const Cosmology& cosmology, const Octree& octree, const Type length, const unsigned int nsteps = 1, const Type amin = Type(), const std::string& filenames = std::string(), const Homogeneous& homogeneous = Homogeneous());
+        template <int Order = 1, bool RK4 = true, bool Verbose = false, class Cosmology, class Octree, class Type, class Trajectory, class Schwarzschild = std::true_type, class Predicate = std::nullptr_t, unsigned int Dimension = Octree::dimension(), class Element = typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Trajectory>()[0])>::type>::type, class Data = typename std::tuple_element<1, decltype(Octree::element())>::type, class Core = decltype(Element::template type<1>()), unsigned int Size = std::tuple_size<Core>::value, class Position = decltype(Octree::position()), class Extent = decltype(Octree::extent()), class = typename std::enable_if<((std::is_arithmetic<Schwarzschild>::value) || (std::is_same<Schwarzschild, std::true_type>::value)) && (Dimension == 3)>::type> static Trajectory& integrate(Trajectory& trajectory, const Cosmology& cosmology, const Octree& octree, const Type length, const unsigned int nsteps = 1, const Schwarzschild mass = Schwarzschild(), Predicate&& predicate = Predicate());
+        template <int Order = 1, bool RK4 = true, bool Verbose = false, bool Incremental = true, class Cosmology, class Octree, class Type, unsigned int Dimension, class Homogeneous = std::vector<Photon<Type, Dimension> >, class Executor = std::nullptr_t, class Sink = Writer, class = typename std::enable_if<(Dimension == 3) && (Dimension == Octree::dimension())>::type> static magrathea::Evolution<Photon<Type, Dimension> > propagate(const Photon<Type, Dimension>& photon, const unsigned int count, const Type angle, const Type rotation, const std::string& interpolation, const Cosmology& cosmology, const Octree& octree, const Type length, const unsigned int nsteps = 1, const Type amin = Type(), const std::string& filenames = std::string(), const Homogeneous& homogeneous = Homogeneous(), Executor&& executor = Executor(), const unsigned int format = 0, Sink* const writer = nullptr);
+        template <int Order = 1, bool RK4 = true, bool Verbose = false, bool Incremental = true, class Cosmology, class Octree, class Type, unsigned int Dimension, class Homogeneous = std::vector<Photon<Type, Dimension> >, class Executor = std::nullptr_t, class Sink = Writer, class = typename std::enable_if<(Dimension == 3) && (Dimension == Octree::dimension())>::type> static std::vector<magrathea::Evolution<Photon<Type, Dimension> > > propagate(const Photon<Type, Dimension>& photon, const unsigned int count, const Type angle, const Type rotation, const std::vector<std::string>& interpolations, const Cosmology& cosmology, const Octree& octree, const Type length, const unsigned int nsteps = 1, const Type amin = Type(), const std::vector<std::string>& filenames = std::vector<std::string>(), const Homogeneous& homogeneous = Homogeneous(), Executor&& executor = Executor(), const unsigned int format = 0, Sink* const writer = nullptr);
+        template <class Octree, class Type, unsigned int Dimension, class Homogeneous = std::vector<Photon<Type, Dimension> >, class Sink = Writer, class = typename std::enable_if<(Dimension == 3) && (Dimension == Octree::dimension())>::type> static magrathea::Evolution<Photon<Type, Dimension> > measure(std::vector<magrathea::Evolution<Photon<Type, Dimension> > >& trajectories, const Octree& octree, const Type angle, const std::string& interpolation, const Type length, const Type amin = Type(), const std::string& filenames = std::string(), const Homogeneous& homogeneous = Homogeneous(), const unsigned int format = 0, Sink* const writer = nullptr);
     //@}         
     
     // Test
@@ -326,6 +343,147 @@ Container Integrator::launch(const Photon<Type, Dimension>& photon, const unsign
 
 
 // ------------------------------- COMPUTATION ------------------------------ //
+// Generic cosmology evaluation
+/// \brief          Generic cosmology evaluation.
+/// \details        Interpolates a column of a generic cosmology container at
+///                 the given time using a binary search.
+/// \tparam         Column Index of the column : 1 for a, 2 for dadt and
+///                 3 for d2adt2.
+/// \tparam         Cosmology Cosmology evolution type.
+/// \tparam         Type Scalar type.
+/// \param[in]      cosmology Cosmology evolution.
+/// \param[in]      t Time.
+/// \return         Interpolated value.
+template <unsigned int Column, class Cosmology, typename Type, class> 
+inline Type Integrator::evaluate(const Cosmology& cosmology, const Type t)
+{
+    return Utility::interpolate(t, std::get<0>(cosmology), std::get<Column>(cosmology));
+}
+
+// Expansion evaluation
+/// \brief          Expansion evaluation.
+/// \details        Interpolates a column of an expansion at the given time
+///                 without any search when the expansion is tabulated. The
+///                 dadt column is interpolated with a cubic spline using
+///                 d2adt2 as derivative. The a column is interpolated
+///                 linearly, because the cosmology correction modifies a
+///                 without updating dadt, which therefore cannot be used
+///                 as its derivative.
+/// \tparam         Column Index of the column : 1 for a, 2 for dadt and
+///                 3 for d2adt2.
+/// \tparam         Kind Expansion data type.
+/// \tparam         Type Scalar type.
+/// \param[in]      cosmology Cosmology evolution.
+/// \param[in]      t Time.
+/// \return         Interpolated value.
+template <unsigned int Column, typename Kind, typename Type, class> 
+inline Type Integrator::evaluate(const Expansion<Kind>& cosmology, const Type t)
+{
+    return cosmology.template interpolate<Column, (Column == 2)>(t);
+}
+
+// Default stop condition
+/// \brief          Default stop condition.
+/// \details        Never stops the integration when no predicate is 
+///                 provided.
+/// \tparam         Trajectory Trajectory type.
+/// \return         False.
+template <class Trajectory> 
+constexpr bool Integrator::halt(std::nullptr_t, const Trajectory&)
+{
+    return false;
+}
+
+// Stop condition
+/// \brief          Stop condition.
+/// \details        Calls the predicate on the trajectory being integrated to
+///                 check whether the integration should be aborted.
+/// \tparam         Predicate Predicate type.
+/// \tparam         Trajectory Trajectory type.
+/// \param[in]      predicate Function returning true to abort.
+/// \param[in]      trajectory Trajectory.
+/// \return         True if the integration should be aborted.
+template <class Predicate, class Trajectory, class> 
+inline bool Integrator::halt(Predicate&& predicate, const Trajectory& trajectory)
+{
+    return predicate(trajectory);
+}
+
+// Octree sampling
+/// \brief          Octree sampling.
+/// \details        Interpolates the octree data at the provided position. 
+///                 The time is ignored for a static octree.
+/// \tparam         Order Octree interpolation order :  0 for NGP, 1 for CIC
+///                 or -1 for an homogeneous universe.
+/// \tparam         Octree Octree type.
+/// \tparam         Type Scalar type.
+/// \tparam         Data Data type.
+/// \param[in]      octree Octree.
+/// \param[in]      x Position along the first dimension.
+/// \param[in]      y Position along the second dimension.
+/// \param[in]      z Position along the third dimension.
+/// \param[in]      t Time.
+/// \return         Interpolated data, or empty data for an homogeneous 
+///                 universe.
+template <int Order, class Octree, typename Type, class Data> 
+inline Data Integrator::sample(const Octree& octree, const Type x, const Type y, const Type z, const Type)
+{
+    return (Order == 0) ? (octree.ngp(x, y, z)) : ((Order == 1) ? (octree.cic(x, y, z)) : (Data()));
+}
+
+// Timeline sampling
+/// \brief          Timeline sampling.
+/// \details        Interpolates the data of the two snapshots bracketing the
+///                 provided time, and then linearly in time.
+/// \tparam         Order Octree interpolation order :  0 for NGP, 1 for CIC
+///                 or -1 for an homogeneous universe.
+/// \tparam         Octree Octree type.
+/// \tparam         Kind Time type of the timeline.
+/// \tparam         Type Scalar type.
+/// \tparam         Data Data type.
+/// \param[in]      timeline Timeline.
+/// \param[in]      x Position along the first dimension.
+/// \param[in]      y Position along the second dimension.
+/// \param[in]      z Position along the third dimension.
+/// \param[in]      t Time.
+/// \return         Interpolated data, or empty data for an homogeneous 
+///                 universe.
+template <int Order, class Octree, typename Kind, typename Type, class Data> 
+inline Data Integrator::sample(const Timeline<Octree, Kind>& timeline, const Type x, const Type y, const Type z, const Type t)
+{
+    return (Order == 0) ? (timeline.ngp(x, y, z, t)) : ((Order == 1) ? (timeline.cic(x, y, z, t)) : (Data()));
+}
+
+// Sequential execution
+/// \brief          Sequential execution.
+/// \details        Executes a function for each loop index in the calling
+///                 thread when no pool is provided.
+/// \tparam         Function Function type taking a loop index as argument.
+/// \param[in]      nsteps Total number of steps.
+/// \param[in]      function Function.
+template <class Function> 
+inline void Integrator::execute(std::nullptr_t, const unsigned int nsteps, Function&& function)
+{
+    for (unsigned int istep = 0; istep < nsteps; ++istep) {
+        function(istep);
+    }
+}
+
+// Pool execution
+/// \brief          Pool execution.
+/// \details        Executes a function for each loop index on a pool of
+///                 threads.
+/// \tparam         Executor Pool type.
+/// \tparam         Function Function type taking a loop index as argument.
+/// \param[in,out]  executor Pool of threads.
+/// \param[in]      nsteps Total number of steps.
+/// \param[in]      function Function.
+template <class Executor, class Function, class> 
+inline void Integrator::execute(Executor&& executor, const unsigned int nsteps, Function&& function)
+{
+    executor.schedule(nsteps, std::forward<Function>(function));
+}
+
 // Derivative of a photon
 /// \brief          Derivative of a photon.
 /// \details        Computes the derivative of the core components of a photon.
@@ -371,9 +529,9 @@ Array& Integrator::dphotondl(Array& output, const Array& input, const Cosmology&
     static const Type two = 2;
     static const Type c2 = magrathea::Constants<Type>::c2();
     static const Type g = magrathea::Constants<Type>::g();
-    Data data = (Order == 0) ? (octree.ngp(input[x], input[y], input[z])) : ((Order == 1) ? (octree.cic(input[x], input[y], input[z])) : (Data()));
+    Data data = sample<Order>(octree, input[x], input[y], input[z], input[t]);
     const Type dphidl = ((dl > zero) || (dl < zero)) ? ((data.phi()-phi)/dl) : (phi);
-    const Type dadt = Utility::interpolate(input[t], std::get<0>(cosmology), std::get<2>(cosmology));
+    const Type dadt = evaluate<2>(cosmology, input[t]);
     const Type scale = length/extent;
     const Type distance = (std::is_arithmetic<Schwarzschild>::value) ? (Utility::distance<Dimension>(center, std::array<Type, Dimension>({{input[x], input[y], input[z]}}))*scale) : (zero);
 
@@ -408,7 +566,10 @@ Array& Integrator::dphotondl(Array& output, const Array& input, const Cosmology&
 // -------------------------------- EVOLUTION ------------------------------- //
 // Geodesics integration
 /// \brief          Geodesics integration.
-/// \details        Integrates the geodesics equation of a photon.
+/// \details        Integrates the geodesics equation of a photon. If the
+///                 trajectory already contains several steps, for example
+///                 after an interruption by the predicate, the integration
+///                 resumes from the last one.
 /// \tparam         Order Octree interpolation order :  0 for NGP, 1 for CIC
 ///                 or -1 for an homogeneous universe.
 /// \tparam         RK4 Runge-kutta of fourth order or euler.
@@ -418,6 +579,7 @@ Array& Integrator::dphotondl(Array& output, const Array& input, const Cosmology&
 /// \tparam         Type Scalar type.
 /// \tparam         Trajectory Trajectory type.
 /// \tparam         Schwarzschild Optional schwarzschild type.
+/// \tparam         Predicate Optional stop predicate type.
 /// \tparam         Dimension Number of space dimension.
 /// \tparam         Element Photon type.
 /// \tparam         Data Data type.
@@ -432,9 +594,11 @@ Array& Integrator::dphotondl(Array& output, const Array& input, const Cosmology&
 /// \param[in]      nsteps Number of lambda steps per grid.
 /// \param[in]      mass Optional schwarzschild mass put in the center of the 
 ///                 the hyperoctree.
+/// \param[in]      predicate Optional function called on the trajectory after
+///                 each step and returning true to abort the integration.
 /// \return         Reference to the trajectory data.
-template <int Order, bool RK4, bool Verbose, class Cosmology, class Octree, class Type, class Trajectory, class Schwarzschild, unsigned int Dimension, class Element, class Data, class Core, unsigned int Size, class Position, class Extent, class> 
-Trajectory& Integrator::integrate(Trajectory& trajectory, const Cosmology& cosmology, const Octree& octree, const Type length, const unsigned int nsteps, const Schwarzschild mass)
+template <int Order, bool RK4, bool Verbose, class Cosmology, class Octree, class Type, class Trajectory, class Schwarzschild, class Predicate, unsigned int Dimension, class Element, class Data, class Core, unsigned int Size, class Position, class Extent, class> 
+Trajectory& Integrator::integrate(Trajectory& trajectory, const Cosmology& cosmology, const Octree& octree, const Type length, const unsigned int nsteps, const Schwarzschild mass, Predicate&& predicate)
 {
     // Initialization
     static const Type zero = 0;
@@ -465,7 +629,7 @@ Trajectory& Integrator::integrate(Trajectory& trajectory, const Cosmology& cosmo
     if (!trajectory.empty()) {
         
         // Get initial data
-        data = (Order == 0) ? (octree.ngp(trajectory.back().x(), trajectory.back().y(), trajectory.back().z())) : ((Order == 1) ? (octree.cic(trajectory.back().x(), trajectory.back().y(), trajectory.back().z())) : (homogeneous));
+        data = ((Order == 0) || (Order == 1)) ? (sample<Order>(octree, trajectory.back().x(), trajectory.back().y(), trajectory.back().z(), trajectory.back().t())) : (homogeneous);
         if (std::is_arithmetic<Schwarzschild>::value) {
             distance = Utility::distance<Dimension>(center, std::array<Type, Dimension>({{trajectory.back().x(), trajectory.back().y(), trajectory.back().z()}}))*scale;
             data.rho() = zero;
@@ -475,30 +639,32 @@ Trajectory& Integrator::integrate(Trajectory& trajectory, const Cosmology& cosmo
             data.dphidz() = (distance > zero) ? (((g*mass)/(distance*distance))*((trajectory.back().z()-center[2])*(scale/distance))) : (zero);
             data.a() = one;
         }
-        norm = std::sqrt((c2*(one+two/c2*data.phi())*trajectory.back().dtdl()*trajectory.back().dtdl())/((one-two/c2*data.phi())*(trajectory.back().dxdl()*trajectory.back().dxdl()+trajectory.back().dydl()*trajectory.back().dydl()+trajectory.back().dzdl()*trajectory.back().dzdl())));
-        trajectory.back().dxdl() *= norm;
-        trajectory.back().dydl() *= norm;
-        trajectory.back().dzdl() *= norm;
-        trajectory.back().a() = Utility::interpolate(trajectory.back().t(), std::get<0>(cosmology), std::get<1>(cosmology));
-        trajectory.back().level() = std::get<0>(*octree.locate(trajectory.back().x(), trajectory.back().y(), trajectory.back().z())).level();
-        trajectory.back().ah() = data.a();
-        trajectory.back().rho() = data.rho();
-        trajectory.back().phi() = data.phi();
-        trajectory.back().dphidx() = data.dphidx();
-        trajectory.back().dphidy() = data.dphidy();
-        trajectory.back().dphidz() = data.dphidz();
-        trajectory.back().dphidl() = zero;
-        trajectory.back().laplacian() = zero;
-        trajectory.back().redshift() = zero;
-        trajectory.back().dsdl2() = (trajectory.back().a()*trajectory.back().a())*(-(c2*(one+two/c2*trajectory.back().phi())*trajectory.back().dtdl()*trajectory.back().dtdl())+((one-two/c2*trajectory.back().phi())*(trajectory.back().dxdl()*trajectory.back().dxdl()+trajectory.back().dydl()*trajectory.back().dydl()+trajectory.back().dzdl()*trajectory.back().dzdl())));
-        trajectory.back().error() = one-((one-two/c2*trajectory.back().phi())*(trajectory.back().dxdl()*trajectory.back().dxdl()+trajectory.back().dydl()*trajectory.back().dydl()+trajectory.back().dzdl()*trajectory.back().dzdl()))/(c2*(one+two/c2*trajectory.back().phi())*trajectory.back().dtdl()*trajectory.back().dtdl());
-        trajectory.back().distance() = zero;
-        trajectory.back().major() = zero;
-        trajectory.back().minor() = zero;
-        trajectory.back().rotation() = zero;
+        if (trajectory.size() == 1) {
+            norm = std::sqrt((c2*(one+two/c2*data.phi())*trajectory.back().dtdl()*trajectory.back().dtdl())/((one-two/c2*data.phi())*(trajectory.back().dxdl()*trajectory.back().dxdl()+trajectory.back().dydl()*trajectory.back().dydl()+trajectory.back().dzdl()*trajectory.back().dzdl())));
+            trajectory.back().dxdl() *= norm;
+            trajectory.back().dydl() *= norm;
+            trajectory.back().dzdl() *= norm;
+            trajectory.back().a() = evaluate<1>(cosmology, trajectory.back().t());
+            trajectory.back().level() = std::get<0>(*octree.locate(trajectory.back().x(), trajectory.back().y(), trajectory.back().z())).level();
+            trajectory.back().ah() = data.a();
+            trajectory.back().rho() = data.rho();
+            trajectory.back().phi() = data.phi();
+            trajectory.back().dphidx() = data.dphidx();
+            trajectory.back().dphidy() = data.dphidy();
+            trajectory.back().dphidz() = data.dphidz();
+            trajectory.back().dphidl() = zero;
+            trajectory.back().laplacian() = zero;
+            trajectory.back().redshift() = zero;
+            trajectory.back().dsdl2() = (trajectory.back().a()*trajectory.back().a())*(-(c2*(one+two/c2*trajectory.back().phi())*trajectory.back().dtdl()*trajectory.back().dtdl())+((one-two/c2*trajectory.back().phi())*(trajectory.back().dxdl()*trajectory.back().dxdl()+trajectory.back().dydl()*trajectory.back().dydl()+trajectory.back().dzdl()*trajectory.back().dzdl())));
+            trajectory.back().error() = one-((one-two/c2*trajectory.back().phi())*(trajectory.back().dxdl()*trajectory.back().dxdl()+trajectory.back().dydl()*trajectory.back().dydl()+trajectory.back().dzdl()*trajectory.back().dzdl()))/(c2*(one+two/c2*trajectory.back().phi())*trajectory.back().dtdl()*trajectory.back().dtdl());
+            trajectory.back().distance() = zero;
+            trajectory.back().major() = zero;
+            trajectory.back().minor() = zero;
+            trajectory.back().rotation() = zero;
+        }
         ratio = (Order == 0) ? (data.a()*data.a()*(scale/c)/nsteps) : ((Order == 1) ? (data.a()*data.a()*(scale/c)/nsteps) : (trajectory.back().a()*trajectory.back().a()*(scale/c)/nsteps));
         dl = std::get<0>(*octree.locate(trajectory.back().x(), trajectory.back().y(), trajectory.back().z())).template extent<Type, Position, Extent>()*ratio;
-        gref = -trajectory.back().a()*c*trajectory.back().dtdl()*(one+trajectory.back().phi()/c2); 
+        gref = -trajectory.front().a()*c*trajectory.front().dtdl()*(one+trajectory.front().phi()/c2); 
 
         // Advance
         while (data != empty) {
@@ -532,7 +698,7 @@ Trajectory& Integrator::integrate(Trajectory& trajectory, const Cosmology& cosmo
             }
             
             // Photon extra
-            data = (Order == 0) ? (octree.ngp(photon.x(), photon.y(), photon.z())) : ((Order == 1) ? (octree.cic(photon.x(), photon.y(), photon.z())) : (homogeneous));
+            data = ((Order == 0) || (Order == 1)) ? (sample<Order>(octree, photon.x(), photon.y(), photon.z(), photon.t())) : (homogeneous);
             if (std::is_arithmetic<Schwarzschild>::value) {
                 distance = Utility::distance<Dimension>(center, std::array<Type, Dimension>({{photon.x(), photon.y(), photon.z()}}))*scale;
                 data.rho() = zero;
@@ -565,6 +731,7 @@ Trajectory& Integrator::integrate(Trajectory& trajectory, const Cosmology& cosmo
                 ratio = (Order == 0) ? (data.a()*data.a()*(scale/c)/nsteps) : ((Order == 1) ? (data.a()*data.a()*(scale/c)/nsteps) : (photon.a()*photon.a()*(scale/c)/nsteps));
                 dl = std::get<0>(*(octree.locate(photon.x(), photon.y(), photon.z()))).template extent<Type, Position, Extent>()*ratio;
                 trajectory.append(photon);
+                data = (halt(predicate, trajectory)) ? (empty) : (data);
                 if (Verbose) {
                     if (photon.a() > 0.99 || photon.a() < 0.04) {
                         std::cout<<std::setprecision(17)<<"photon = "<<photon<<" "<<dl<<std::endl;
@@ -590,16 +757,27 @@ Trajectory& Integrator::integrate(Trajectory& trajectory, const Cosmology& cosmo
 // Propagation of a ray bundle
 /// \brief          Propagation of a ray bundle.
 /// \details        Propagates a ray bundle calling the integrator for each
-///                 photon.
+///                 photon and then measures it. In incremental mode, the 
+///                 bundle is rejected as soon as a trajectory is empty, too
+///                 short, does not reach amin, or if the lengths of the 
+///                 trajectories already differ too much, and a photon whose
+///                 displacement exceeds the bound set by the shortest 
+///                 completed trajectory is aborted in flight, assuming that
+///                 photons never come back towards their origin.
 /// \tparam         Order Octree interpolation order :  0 for NGP, 1 for CIC
 ///                 or -1 for an homogeneous universe.
 /// \tparam         RK4 Runge-kutta of fourth order or euler.
 /// \tparam         Verbose Verbose mode for debug purposes.
+/// \tparam         Incremental Checks the rejection conditions while the 
+///                 photons advance and aborts the remaining ones as soon as 
+///                 the bundle cannot be accepted anymore.
 /// \tparam         Cosmology Cosmology evolution type.
 /// \tparam         Octree Octree type.
 /// \tparam         Type Scalar type.
 /// \tparam         Dimension Number of space dimension.
 /// \tparam         Homogeneous Homogeneous reference.
+/// \tparam         Executor Optional pool type.
+/// \tparam         Sink Optional output sink type.
 /// \param[in]      photon Central photon initial data.
 /// \param[in]      count Number of other photons to use.
 /// \param[in]      angle Half-angle at the cone vertex.
@@ -619,9 +797,179 @@ Trajectory& Integrator::integrate(Trajectory& trajectory, const Cosmology& cosmo
 ///                 the angular diameter distance use the inhomogeneous value of
 ///                 a. If provided, the homogeneous value of a for the given 
 ///                 radius is used.
+/// \param[in,out]  executor Optional pool of threads on which the photons
+///                 of the bundle are integrated concurrently. It can be the
+///                 same pool as the one running the calling loop.
+/// \param[in]      format Output format : text if zero, columnar binary if
+///                 one, columnar binary in single precision if two.
+/// \param[in,out]  writer Optional sink to which the output is handed,
+///                 such as an asynchronous writer or an aggregator. If null,
+///                 files are written directly.
 /// \return         Central photon trajectory.
-template <int Order, bool RK4, bool Verbose, class Cosmology, class Octree, class Type, unsigned int Dimension, class Homogeneous, class>
-magrathea::Evolution<Photon<Type, Dimension> > Integrator::propagate(const Photon<Type, Dimension>& photon, const unsigned int count, const Type angle, const Type rotation, const std::string& interpolation, const Cosmology& cosmology, const Octree& octree, const Type length, const unsigned int nsteps, const Type amin, const std::string& filenames, const Homogeneous& homogeneous)
+template <int Order, bool RK4, bool Verbose, bool Incremental, class Cosmology, class Octree, class Type, unsigned int Dimension, class Homogeneous, class Executor, class Sink, class>
+magrathea::Evolution<Photon<Type, Dimension> > Integrator::propagate(const Photon<Type, Dimension>& photon, const unsigned int count, const Type angle, const Type rotation, const std::string& interpolation, const Cosmology& cosmology, const Octree& octree, const Type length, const unsigned int nsteps, const Type amin, const std::string& filenames, const Homogeneous& homogeneous, Executor&& executor, const unsigned int format, Sink* const writer)
+{
+    return propagate<Order, RK4, Verbose, Incremental>(photon, count, angle, rotation, std::vector<std::string>(1, interpolation), cosmology, octree, length, nsteps, amin, std::vector<std::string>(1, filenames), homogeneous, std::forward<Executor>(executor), format, writer).front();
+}
+
+// Propagation of a ray bundle along several axes
+/// \brief          Propagation of a ray bundle along several axes.
+/// \details        Propagates a ray bundle calling the integrator for each
+///                 photon once, and then measures it along each of the
+///                 provided interpolation axes. As the interpolation axis
+///                 only matters for the measurement, the cost of the
+///                 integration is shared by all the axes. The rejection
+///                 conditions are the same as for a single axis.
+/// \tparam         Order Octree interpolation order :  0 for NGP, 1 for CIC
+///                 or -1 for an homogeneous universe.
+/// \tparam         RK4 Runge-kutta of fourth order or euler.
+/// \tparam         Verbose Verbose mode for debug purposes.
+/// \tparam         Incremental Checks the rejection conditions while the 
+///                 photons advance and aborts the remaining ones as soon as 
+///                 the bundle cannot be accepted anymore.
+/// \tparam         Cosmology Cosmology evolution type.
+/// \tparam         Octree Octree type.
+/// \tparam         Type Scalar type.
+/// \tparam         Dimension Number of space dimension.
+/// \tparam         Homogeneous Homogeneous reference.
+/// \tparam         Executor Optional pool type.
+/// \tparam         Sink Optional output sink type.
+/// \param[in]      photon Central photon initial data.
+/// \param[in]      count Number of other photons to use.
+/// \param[in]      angle Half-angle at the cone vertex.
+/// \param[in]      rotation Arbitrary rotation to optionally apply on the
+///                 resulting circle of photons.
+/// \param[in]      interpolations Stop conditions : redshift, a, t, r.
+/// \param[in]      cosmology Cosmology evolution.
+/// \param[in]      octree Octree.
+/// \param[in]      length Spatial length in SI units.
+/// \param[in]      nsteps Number of lambda steps per grid.
+/// \param[in]      amin If different from zero, all photons should end by this
+///                 value of a.
+/// \param[in]      filenames File names of the output of each axis. If 
+///                 missing or empty, no output for this axis.
+/// \param[in]      Homogeneous Optional homogeneous trajectory.
+/// \param[in,out]  executor Optional pool of threads on which the photons
+///                 of the bundle are integrated concurrently.
+/// \param[in]      format Output format : text if zero, columnar binary if
+///                 one, columnar binary in single precision if two.
+/// \param[in,out]  writer Optional sink to which the output is handed.
+/// \return         Central photon trajectory measured along each axis, all
+///                 empty if the bundle has been rejected.
+template <int Order, bool RK4, bool Verbose, bool Incremental, class Cosmology, class Octree, class Type, unsigned int Dimension, class Homogeneous, class Executor, class Sink, class>
+std::vector<magrathea::Evolution<Photon<Type, Dimension> > > Integrator::propagate(const Photon<Type, Dimension>& photon, const unsigned int count, const Type angle, const Type rotation, const std::vector<std::string>& interpolations, const Cosmology& cosmology, const Octree& octree, const Type length, const unsigned int nsteps, const Type amin, const std::vector<std::string>& filenames, const Homogeneous& homogeneous, Executor&& executor, const unsigned int format, Sink* const writer)
+{
+    // Initialization
+    static const Type zero = 0;
+    static const Type one = 1;
+    static const Type two = 2;
+    static const unsigned int x = 0;
+    static const unsigned int y = 1;
+    static const unsigned int z = 2;
+    static const Type quarter = (Type(octree.extent().num)/Type(two*octree.extent().den))/two;
+    static const Type limit = one/(two*two*two);
+    std::vector<Photon<Type, Dimension> > initial = launch<true>(photon, count, angle, rotation); 
+    std::vector<magrathea::Evolution<Photon<Type, Dimension> > > trajectories(initial.size());
+    std::atomic<Type> shortest(std::numeric_limits<Type>::max());
+    Type longest = zero;
+    std::atomic<bool> rejected(false);
+    std::mutex mutex;
+    std::vector<magrathea::Evolution<Photon<Type, Dimension> > > copy;
+    std::vector<magrathea::Evolution<Photon<Type, Dimension> > > results(interpolations.size());
+    auto predicate = [&rejected, &shortest](const magrathea::Evolution<Photon<Type, Dimension> >& trajectory){
+        std::array<Type, Dimension> delta = std::array<Type, Dimension>();
+        delta[x] = trajectory.back().x()-trajectory.front().x();
+        delta[y] = trajectory.back().y()-trajectory.front().y();
+        delta[z] = trajectory.back().z()-trajectory.front().z();
+        if (std::sqrt(delta[x]*delta[x]+delta[y]*delta[y]+delta[z]*delta[z])*(one-limit) > shortest.load()) {
+            rejected = true;
+        }
+        return rejected.load();
+    };
+    auto step = [=, &initial, &trajectories, &cosmology, &octree, &amin, &shortest, &longest, &rejected, &mutex, &predicate](const unsigned int itrajectory){
+        std::array<Type, Dimension> delta = std::array<Type, Dimension>();
+        Type last = zero;
+        bool accepted = true;
+        if (!rejected) {
+            trajectories[itrajectory].append(initial[itrajectory]);
+            if (Incremental) {
+                integrate<Order, RK4, Verbose>(trajectories[itrajectory], cosmology, octree, length, nsteps, std::true_type(), predicate);
+            } else {
+                integrate<Order, RK4, Verbose>(trajectories[itrajectory], cosmology, octree, length, nsteps);
+            }
+            if (trajectories[itrajectory].empty()) {
+                accepted = false;
+            } else {
+                delta[x] = trajectories[itrajectory].back().x()-trajectories[itrajectory].front().x();
+                delta[y] = trajectories[itrajectory].back().y()-trajectories[itrajectory].front().y();
+                delta[z] = trajectories[itrajectory].back().z()-trajectories[itrajectory].front().z();
+                last = std::sqrt(delta[x]*delta[x]+delta[y]*delta[y]+delta[z]*delta[z]);
+                accepted = accepted && (last > quarter);
+                accepted = accepted && ((!(std::isnormal(amin) && std::isnormal(trajectories[itrajectory].back().ah()) && (trajectories[itrajectory].back().ah() < one))) || (!(trajectories[itrajectory].back().ah() > amin)));
+                if (Incremental) {
+                    mutex.lock();
+                    shortest = std::min(shortest.load(), last);
+                    longest = std::max(longest, last);
+                    accepted = accepted && ((longest-shortest)/longest < limit);
+                    mutex.unlock();
+                }
+            }
+            if (!accepted) {
+                rejected = true;
+            }
+        }
+    };
+    
+    // Integration
+    execute(executor, trajectories.size(), step);
+    
+    // Finalization
+    for (unsigned int iaxis = 0; (!rejected) && (iaxis < interpolations.size()); ++iaxis) {
+        if (iaxis+1 < interpolations.size()) {
+            copy = trajectories;
+        } else {
+            copy = std::move(trajectories);
+        }
+        results[iaxis] = measure(copy, octree, angle, interpolations[iaxis], length, amin, (iaxis < filenames.size()) ? (filenames[iaxis]) : (std::string()), homogeneous, format, writer);
+    }
+    return results;
+}
+
+// Measurement of a ray bundle
+/// \brief          Measurement of a ray bundle.
+/// \details        Checks the integrated trajectories of a ray bundle and
+///                 computes the angular diameter distance along the central
+///                 one. The bundle is rejected if a trajectory is empty, 
+///                 too short, does not reach amin, or if the lengths of the 
+///                 trajectories differ too much.
+/// \tparam         Octree Octree type.
+/// \tparam         Type Scalar type.
+/// \tparam         Dimension Number of space dimension.
+/// \tparam         Homogeneous Homogeneous reference.
+/// \tparam         Sink Optional output sink type.
+/// \param[in,out]  trajectories Integrated trajectories, the central one 
+///                 first.
+/// \param[in]      octree Octree.
+/// \param[in]      angle Half-angle at the cone vertex.
+/// \param[in]      interpolation Stop condition : redshift, a, t, r.
+/// \param[in]      length Spatial length in SI units.
+/// \param[in]      amin If different from zero, all photons should end by this
+///                 value of a.
+/// \param[in]      filenames File names of the output. If empty, no output. 
+///                 If at least on percent sign, all trajectories are saved.
+///                 Otherwise, only the central one is saved.
+/// \param[in]      Homogeneous Optional homogeneous trajectory. If not provided
+///                 the angular diameter distance use the inhomogeneous value of
+///                 a. If provided, the homogeneous value of a for the given 
+///                 radius is used.
+/// \param[in]      format Output format : text if zero, columnar binary if
+///                 one, columnar binary in single precision if two.
+/// \param[in,out]  writer Optional sink to which the output is handed,
+///                 such as an asynchronous writer or an aggregator. If null,
+///                 files are written directly.
+/// \return         Central photon trajectory.
+template <class Octree, class Type, unsigned int Dimension, class Homogeneous, class Sink, class>
+magrathea::Evolution<Photon<Type, Dimension> > Integrator::measure(std::vector<magrathea::Evolution<Photon<Type, Dimension> > >& trajectories, const Octree& octree, const Type angle, const std::string& interpolation, const Type length, const Type amin, const std::string& filenames, const Homogeneous& homogeneous, const unsigned int format, Sink* const writer)
 {
     // Initialization
     static const Type zero = 0;
@@ -636,8 +984,6 @@ magrathea::Evolution<Photon<Type, Dimension> > Integrator::propagate(const Photo
     static const unsigned int digits = std::numeric_limits<Type>::max_digits10;
     static const Type quarter = (Type(octree.extent().num)/Type(two*octree.extent().den))/two;
     static const Type limit = one/(two*two*two);
-    std::vector<Photon<Type, Dimension> > initial = launch<true>(photon, count, angle, rotation); 
-    std::vector<magrathea::Evolution<Photon<Type, Dimension> > > trajectories(initial.size());
     unsigned int ntrajectories = trajectories.size();
     unsigned int size = zero;
     std::vector<Type> last(ntrajectories);
@@ -645,12 +991,12 @@ magrathea::Evolution<Photon<Type, Dimension> > Integrator::propagate(const Photo
     std::vector<std::array<std::vector<Type>, Dimension> > xyz(ntrajectories);
     std::array<Type, Dimension> coord = std::array<Type, Dimension>();
     std::pair<std::vector<Type>, std::vector<Type> > flrw;
+    std::ostringstream buffer;
     std::ofstream stream;
+    bool all = false;
     
-    // Integration
+    // Selection
     for (unsigned int itrajectory = 0; itrajectory < ntrajectories; ++itrajectory) {
-        trajectories[itrajectory].append(initial[itrajectory]);
-        integrate<Order, RK4, Verbose>(trajectories[itrajectory], cosmology, octree, length, nsteps);
         size = trajectories[itrajectory].size();
         for (unsigned int idim = 0; idim < Dimension; ++idim) {
             xyz[itrajectory][idim].resize(size);
@@ -763,14 +1109,15 @@ magrathea::Evolution<Photon<Type, Dimension> > Integrator::propagate(const Photo
     
     // Output
     if ((ntrajectories > 0) && (!filenames.empty())) {
-        if (filenames.find(percent) == std::string::npos) {
-            stream.open(filenames);
-            Output::save(stream, trajectories[center], digits); 
-            stream.close();
-        } else {
-            for (unsigned int itrajectory = 0; itrajectory < ntrajectories; ++itrajectory) {
-                stream.open(Output::name(std::make_pair(filenames, itrajectory)));
-                Output::save(stream, trajectories[itrajectory], digits); 
+        all = (filenames.find(percent) != std::string::npos);
+        for (unsigned int itrajectory = (all) ? (first) : (center); itrajectory < ((all) ? (ntrajectories) : (center+1)); ++itrajectory) {
+            buffer.str(std::string());
+            (format > 0) ? (Output::write(buffer, trajectories[itrajectory], format > 1)) : (Output::save(buffer, trajectories[itrajectory], digits)); 
+            if (writer) {
+                writer->push((all) ? (Output::name(std::make_pair(filenames, itrajectory))) : (filenames), buffer.str());
+            } else {
+                stream.open((all) ? (Output::name(std::make_pair(filenames, itrajectory))) : (filenames), std::ios::out | std::ios::binary);
+                stream<<buffer.str();
                 stream.close();
             }
         }
@@ -804,6 +1151,9 @@ int Integrator::example()
     magrathea::SimpleHyperOctree<double, magrathea::SimpleHyperOctreeIndex<unsigned long long int, 3>, Gravity<float, 3> > octree(0, 2);
     magrathea::HyperSphere<3> sphere = magrathea::HyperSphere<3>::unit();
     magrathea::Evolution<Photon<double, 3> > trajectory;
+    std::vector<Photon<double, 3> > homogeneous;
+    std::vector<magrathea::Evolution<Photon<double, 3> > > bundle(3, trajectory);
+    Pool pool(2);
     Photon<double, 3> photon;
     Cone<> cone(beg, end, 0.42);
     std::vector<Cone<> > cones(3, cone);
@@ -829,6 +1179,10 @@ int Integrator::example()
     // Computation
     std::cout<<std::endl;
     std::cout<<std::setw(width*2)<<"Computation : "                                                                     <<std::endl;
+    std::cout<<std::setw(width*2)<<"integrator.evaluate<1>(cosmology, one) : "                                          <<integrator.evaluate<1>(cosmology, one)<<std::endl;
+    std::cout<<std::setw(width*2)<<"integrator.evaluate<2>(Expansion<double>(cosmology), one) : "                       <<integrator.evaluate<2>(Expansion<double>(cosmology), one)<<std::endl;
+    std::cout<<std::setw(width*2)<<"integrator.sample(octree, 0.1, 0.2, 0.3, one).phi() : "                             <<integrator.sample(octree, 0.1, 0.2, 0.3, one).phi()<<std::endl;
+    std::cout<<std::setw(width*2)<<"integrator.halt(nullptr, trajectory) : "                                            <<integrator.halt(nullptr, trajectory)<<std::endl;
     std::cout<<std::setw(width*2)<<"integrator.dphotondl(array, array, cosmology, octree, one, one, one)[0] : "         <<integrator.dphotondl(array, array, cosmology, octree, one, one, one)[0]<<std::endl;
 
     // Evolution
@@ -836,6 +1190,10 @@ int Integrator::example()
     std::cout<<std::setw(width*3)<<"Evolution : "                                                                                                               <<std::endl;
     std::cout<<std::setw(width*3)<<"integrator.integrate(trajectory, cosmology, octree, one, one).size() : "                                                    <<integrator.integrate(trajectory, cosmology, octree, one, one).size()<<std::endl;
     std::cout<<std::setw(width*3)<<"integrator.propagate(photon, 3, 0.42, 0.1, \"a\", cosmology, octree, one, one).size()"                                      <<integrator.propagate(photon, 3, 0.42, 0.1, "a", cosmology, octree, one, one).size()<<std::endl;
+    std::cout<<std::setw(width*3)<<"integrator.measure(bundle, octree, 0.42, \"a\", one).size()"                                                                  <<integrator.measure(bundle, octree, 0.42, "a", one).size()<<std::endl;
+    std::cout<<std::setw(width*3)<<"integrator.propagate<1, true, false, false>(photon, 3, 0.42, 0.1, \"a\", cosmology, octree, one, one).size()"            <<integrator.propagate<1, true, false, false>(photon, 3, 0.42, 0.1, "a", cosmology, octree, one, one).size()<<std::endl;
+    std::cout<<std::setw(width*3)<<"integrator.propagate(photon, 3, 0.42, 0.1, \"a\", cosmology, octree, one, one, 0., \"\", homogeneous, pool).size()"        <<integrator.propagate(photon, 3, 0.42, 0.1, "a", cosmology, octree, one, one, 0., "", homogeneous, pool).size()<<std::endl;
+    std::cout<<std::setw(width*3)<<"integrator.propagate(photon, 3, 0.42, 0.1, {\"a\", \"r\"}, cosmology, octree, one, one).size()"                             <<integrator.propagate(photon, 3, 0.42, 0.1, std::vector<std::string>({"a", "r"}), cosmology, octree, one, one).size()<<std::endl;
     
     // Finalize
     std::cout<<std::noboolalpha<<std::right<<std::endl;
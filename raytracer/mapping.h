@@ -0,0 +1,379 @@
+/* ********************************* MAPPING ******************************** */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Mapping
+// DESCRIPTION :    Memory-mapped reader of fortran record files
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           mapping.h
+/// \brief          Memory-mapped reader of fortran record files
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef MAPPING_H_INCLUDED
+#define MAPPING_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <type_traits>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstring>
+// Include libs
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+// Include project
+#include "../magrathea/filesystem.h"
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Memory-mapped reader of fortran record files
+/// \brief          Memory-mapped reader of fortran record files.
+/// \details        Maps a whole file in memory and gives access to the
+///                 contents of its fortran records in place, without
+///                 copying them in intermediate buffers. Record markers are
+///                 validated when the records are indexed, and the byte
+///                 order of the file is detected from the first marker.
+///                 Values of a file written with the other byte order are
+///                 swapped one by one when they are accessed.
+class Mapping final
+{
+    // Lifecycle
+    /// \name           Lifecycle
+    //@{
+    public:
+        explicit inline Mapping(const std::string& filename = std::string());
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+        inline ~Mapping();
+    //@}
+
+    // File
+    /// \name           File
+    //@{
+    public:
+        inline bool open(const std::string& filename);
+        inline bool close();
+        inline bool mapped() const;
+        inline bool byteswapped() const;
+        inline unsigned long long int length() const;
+    //@}
+
+    // Records
+    /// \name           Records
+    //@{
+    public:
+        template <typename Marker = unsigned int, class = typename std::enable_if<std::is_integral<Marker>::value>::type> inline unsigned int index();
+        inline unsigned int count() const;
+        template <typename Type = char> inline unsigned long long int size(const unsigned int irecord) const;
+        template <typename Type> inline Type at(const unsigned int irecord, const unsigned long long int i) const;
+        template <typename Type> inline const Type* pointer(const unsigned int irecord) const;
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+
+    // Data members
+    /// \name           Data members
+    //@{
+    protected:
+        char* _data;                                                            ///< Mapped contents.
+        unsigned long long int _length;                                         ///< Length of the file in bytes.
+        bool _byteswap;                                                         ///< Opposite byte order flag.
+        std::vector<std::pair<unsigned long long int, unsigned long long int> > _records; ///< Offset and length of the records.
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- LIFECYCLE -------------------------------- //
+// Explicit constructor
+/// \brief          Explicit constructor.
+/// \details        Maps the provided file if its name is not empty.
+/// \param[in]      filename File name.
+inline Mapping::Mapping(const std::string& filename)
+: _data(nullptr)
+, _length(0)
+, _byteswap(false)
+, _records()
+{
+    if (!filename.empty()) {
+        open(filename);
+    }
+}
+
+// Destructor
+/// \brief          Destructor.
+/// \details        Unmaps the file.
+inline Mapping::~Mapping()
+{
+    close();
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- FILE ---------------------------------- //
+// Open
+/// \brief          Open.
+/// \details        Unmaps the current file and maps the provided one in
+///                 read-only mode. The kernel is advised that the whole file
+///                 will be needed soon, so that it is read ahead in large
+///                 chunks while the first records are processed.
+/// \param[in]      filename File name.
+/// \return         True if the file has been mapped, false otherwise.
+inline bool Mapping::open(const std::string& filename)
+{
+    const int descriptor = ::open(filename.c_str(), O_RDONLY);
+    struct stat status;
+    void* address = MAP_FAILED;
+    close();
+    if (descriptor >= 0) {
+        if ((::fstat(descriptor, &status) == 0) && (status.st_size > 0)) {
+            address = ::mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (address != MAP_FAILED) {
+                _data = static_cast<char*>(address);
+                _length = status.st_size;
+                ::madvise(address, _length, MADV_WILLNEED);
+            }
+        }
+        ::close(descriptor);
+    }
+    return mapped();
+}
+
+// Close
+/// \brief          Close.
+/// \details        Unmaps the file and forgets its records.
+/// \return         True if a file was mapped, false otherwise.
+inline bool Mapping::close()
+{
+    const bool ok = mapped();
+    if (ok) {
+        ::munmap(_data, _length);
+    }
+    _data = nullptr;
+    _length = 0;
+    _byteswap = false;
+    _records.clear();
+    return ok;
+}
+
+// Mapped
+/// \brief          Mapped.
+/// \details        Checks whether a file is currently mapped.
+/// \return         True if mapped, false otherwise.
+inline bool Mapping::mapped() const
+{
+    return _data != nullptr;
+}
+
+// Byteswapped
+/// \brief          Byteswapped.
+/// \details        Checks whether the file has been written with the
+///                 opposite byte order.
+/// \return         True if values are byteswapped on access, false
+///                 otherwise.
+inline bool Mapping::byteswapped() const
+{
+    return _byteswap;
+}
+
+// Length
+/// \brief          Length.
+/// \details        Returns the length of the mapped file.
+/// \return         Length in bytes.
+inline unsigned long long int Mapping::length() const
+{
+    return _length;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// --------------------------------- RECORDS -------------------------------- //
+// Index records
+/// \brief          Index records.
+/// \details        Walks through the fortran records of the file and checks
+///                 that the leading and trailing markers of each record are
+///                 equal and within the file. The byte order is the one
+///                 validating the first record. Indexing stops at the first
+///                 invalid record.
+/// \tparam         Marker Record marker type.
+/// \return         Number of valid records.
+template <typename Marker, class>
+inline unsigned int Mapping::index()
+{
+    static const unsigned long long int width = sizeof(Marker);
+    unsigned long long int offset = 0;
+    Marker head = Marker();
+    Marker tail = Marker();
+    bool valid = true;
+    _records.clear();
+    for (unsigned int iorder = 0; (iorder < 2) && (_records.empty()) && (offset+width+width <= _length); ++iorder) {
+        _byteswap = (iorder > 0);
+        valid = true;
+        while ((valid) && (offset+width+width <= _length)) {
+            std::memcpy(&head, _data+offset, width);
+            if (_byteswap) {
+                magrathea::FileSystem::byteswap(head);
+            }
+            valid = (static_cast<unsigned long long int>(head) <= _length-offset-width-width);
+            if (valid) {
+                std::memcpy(&tail, _data+offset+width+head, width);
+                if (_byteswap) {
+                    magrathea::FileSystem::byteswap(tail);
+                }
+                valid = (head == tail);
+            }
+            if (valid) {
+                _records.push_back(std::make_pair(offset+width, static_cast<unsigned long long int>(head)));
+                offset += width+head+width;
+            }
+        }
+        offset = (_records.empty()) ? (0) : (offset);
+    }
+    _byteswap = (_records.empty()) ? (false) : (_byteswap);
+    return _records.size();
+}
+
+// Count
+/// \brief          Count.
+/// \details        Returns the number of indexed records.
+/// \return         Number of records.
+inline unsigned int Mapping::count() const
+{
+    return _records.size();
+}
+
+// Record size
+/// \brief          Record size.
+/// \details        Returns the number of values of the given type contained
+///                 in a record.
+/// \tparam         Type Value type.
+/// \param[in]      irecord Record number.
+/// \return         Number of values, zero for a non indexed record.
+template <typename Type>
+inline unsigned long long int Mapping::size(const unsigned int irecord) const
+{
+    return (irecord < _records.size()) ? (std::get<1>(_records[irecord])/sizeof(Type)) : (0);
+}
+
+// Access value
+/// \brief          Access value.
+/// \details        Reads the value of the given type at the given position
+///                 of a record directly from the mapped pages, and swaps
+///                 its bytes if needed. No bound checking is performed.
+/// \tparam         Type Value type.
+/// \param[in]      irecord Record number.
+/// \param[in]      i Position of the value in the record.
+/// \return         Value.
+template <typename Type>
+inline Type Mapping::at(const unsigned int irecord, const unsigned long long int i) const
+{
+    Type value;
+    std::memcpy(&value, _data+std::get<0>(_records[irecord])+i*sizeof(Type), sizeof(Type));
+    if (_byteswap) {
+        magrathea::FileSystem::byteswap(value);
+    }
+    return value;
+}
+
+// Record pointer
+/// \brief          Record pointer.
+/// \details        Returns a typed pointer to the contents of a record when
+///                 they can be used in place, that is to say when the file
+///                 has the native byte order and the record is suitably
+///                 aligned.
+/// \tparam         Type Value type.
+/// \param[in]      irecord Record number.
+/// \return         Pointer to the first value or null pointer.
+template <typename Type>
+inline const Type* Mapping::pointer(const unsigned int irecord) const
+{
+    const bool usable = (irecord < _records.size()) && (!_byteswap) && (std::get<0>(_records[irecord])%std::alignment_of<Type>::value == 0);
+    return (usable) ? (reinterpret_cast<const Type*>(_data+std::get<0>(_records[irecord]))) : (nullptr);
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Mapping.
+/// \return         0 if no error.
+int Mapping::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Mapping::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    const std::string filename = "/tmp/mapping_00000";
+    const float values[3] = {4.F, 8.F, 15.F};
+    const unsigned int marker = sizeof(values);
+    std::ofstream stream(filename, std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(&marker), sizeof(marker));
+    stream.write(reinterpret_cast<const char*>(values), sizeof(values));
+    stream.write(reinterpret_cast<const char*>(&marker), sizeof(marker));
+    stream.close();
+
+    // Construction
+    Mapping mapping(filename);
+
+    // Lifecycle
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Lifecycle : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"Mapping().mapped() : "                                                              <<Mapping().mapped()<<std::endl;
+
+    // File
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"File : "                                                                            <<std::endl;
+    std::cout<<std::setw(width*2)<<"mapping.mapped() : "                                                                <<mapping.mapped()<<std::endl;
+    std::cout<<std::setw(width*2)<<"mapping.length() : "                                                                <<mapping.length()<<std::endl;
+
+    // Records
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Records : "                                                                         <<std::endl;
+    std::cout<<std::setw(width*2)<<"mapping.index() : "                                                                 <<mapping.index()<<std::endl;
+    std::cout<<std::setw(width*2)<<"mapping.byteswapped() : "                                                           <<mapping.byteswapped()<<std::endl;
+    std::cout<<std::setw(width*2)<<"mapping.count() : "                                                                 <<mapping.count()<<std::endl;
+    std::cout<<std::setw(width*2)<<"mapping.size<float>(0) : "                                                          <<mapping.size<float>(0)<<std::endl;
+    std::cout<<std::setw(width*2)<<"mapping.at<float>(0, 2) : "                                                         <<mapping.at<float>(0, 2)<<std::endl;
+    std::cout<<std::setw(width*2)<<"mapping.pointer<float>(0)[1] : "                                                    <<mapping.pointer<float>(0)[1]<<std::endl;
+    std::cout<<std::setw(width*2)<<"mapping.close() : "                                                                 <<mapping.close()<<std::endl;
+    std::cout<<std::setw(width*2)<<"mapping.count() : "                                                                 <<mapping.count()<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Mapping::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // MAPPING_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
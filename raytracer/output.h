@@ -26,6 +26,7 @@
 #include <fstream>
 #include <sstream>
 #include <cstdio>
+#include <cstring>
 #include <type_traits>
 #include <algorithm>
 #include <limits>
@@ -37,6 +38,8 @@
 // Include project
 #include "../magrathea/simplehyperoctree.h"
 #include "../magrathea/simplehyperoctreeindex.h"
+#include "../magrathea/filesystem.h"
+#include "../magrathea/datahandler.h"
 #include "utility.h"
 #include "gravity.h"
 #include "photon.h"
@@ -60,6 +63,11 @@ class Output final
         template <class Type, class = typename std::enable_if<!std::is_convertible<typename std::remove_cv<typename std::remove_reference<Type>::type>::type, std::string>::value>::type> static inline std::string name(const Type& value);
         template <template <class, class> class Type, class First, class Second, class = typename std::enable_if<(std::tuple_size<Type<First, Second> >::value == std::tuple_size<std::pair<First, Second> >::value) && (std::is_convertible<First, std::string>::value)>::type> static inline std::string name(const Type<First, Second>& value);
         template <class Type, class... Types, class = typename std::enable_if<sizeof...(Types) != 0>::type> static inline std::string name(Type&& value, Types&&... values);
+        template <class Type, class Function, class = typename std::enable_if<std::is_arithmetic<typename std::remove_cv<Type>::type>::value>::type> static inline unsigned int traverse(Type& value, Function&& function, const std::string& path = std::string());
+        template <unsigned int Current = 0, class Type, class Function, class = typename std::enable_if<(Current < std::tuple_size<typename std::remove_cv<Type>::type>::value)>::type> static inline unsigned int traverse(Type& value, Function&& function, const std::string& path = std::string());
+        template <unsigned int Current, class... Dummy, class Type, class Function, class = typename std::enable_if<(sizeof...(Dummy) == 0) && (Current == std::tuple_size<typename std::remove_cv<Type>::type>::value)>::type> static inline unsigned int traverse(Type& value, Function&& function, const std::string& path = std::string());
+        template <typename Type> static inline Type decode(const char* source, const char kind, const unsigned int size);
+        static inline bool transcode(char* destination, const char kind, const unsigned int size, const char* source, const char origin, const unsigned int length);
     //@}
     
     // Save
@@ -72,6 +80,15 @@ class Output final
         template <class Container, typename Type = typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Container>()[0])>::type>::type, typename Integral = std::true_type, class = typename std::enable_if<!std::is_void<typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Container>()[0])>::type>::type>::value>::type> static bool save(std::ostream& stream, const Container& x, const Container& y, const Container& ymean, const Container& ystd, const unsigned int digits = 0, const Integral count = Integral());
     //@}
 
+    // Binary
+    /// \name           Binary
+    //@{
+    public:
+        template <class Trajectory, class = typename std::enable_if<!std::is_void<typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Trajectory>()[0].type())>::type>::type>::value>::type> static bool write(std::ostream& stream, const Trajectory& trajectory, const bool downcast = false);
+        template <class Trajectory, class = typename std::enable_if<!std::is_void<typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Trajectory>()[0].type())>::type>::type>::value>::type> static bool read(std::istream& stream, Trajectory& trajectory);
+        template <class Trajectory, class = typename std::enable_if<!std::is_void<typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Trajectory>()[0].type())>::type>::type>::value>::type> static bool convert(std::istream& input, std::ostream& output, const unsigned int digits = 0);
+    //@}
+
     // Test
     /// \name           Test
     //@{
@@ -139,6 +156,171 @@ inline std::string Output::name(Type&& value, Types&&... values)
 {
     return name(value)+name(values...);
 }
+
+// Traverse an arithmetic value
+/// \brief          Traverse an arithmetic value.
+/// \details        Terminal case of the traversal: calls the function on the
+///                 raw bytes of the value with its path, its kind (<tt>f</tt>
+///                 for floating point, <tt>i</tt> for signed and <tt>u</tt>
+///                 for unsigned integers) and its size.
+/// \tparam         Type Arithmetic type, possibly const.
+/// \tparam         Function Function type.
+/// \param[in,out]  value Value.
+/// \param[in,out]  function Function taking a path, a pointer to the bytes,
+///                 a kind and a size.
+/// \param[in]      path Path of the value.
+/// \return         Number of traversed values.
+template <class Type, class Function, class>
+inline unsigned int Output::traverse(Type& value, Function&& function, const std::string& path)
+{
+    function(path, reinterpret_cast<typename std::conditional<std::is_const<Type>::value, const char*, char*>::type>(&value), (std::is_floating_point<Type>::value) ? ('f') : ((std::is_signed<Type>::value) ? ('i') : ('u')), static_cast<unsigned int>(sizeof(Type)));
+    return 1;
+}
+
+// Traverse a tuple-like value
+/// \brief          Traverse a tuple-like value.
+/// \details        Recursively traverses the element of the given index of a
+///                 tuple or an array, and then the following elements, so
+///                 that all arithmetic values are visited in the order of
+///                 the text output. The path of an element is the path of
+///                 its parent followed by its index.
+/// \tparam         Current Current index.
+/// \tparam         Type Tuple-like type, possibly const.
+/// \tparam         Function Function type.
+/// \param[in,out]  value Value.
+/// \param[in,out]  function Function taking a path, a pointer to the bytes,
+///                 a kind and a size.
+/// \param[in]      path Path of the value.
+/// \return         Number of traversed values.
+template <unsigned int Current, class Type, class Function, class>
+inline unsigned int Output::traverse(Type& value, Function&& function, const std::string& path)
+{
+    return traverse(std::get<Current>(value), function, (path.empty()) ? (std::to_string(Current)) : (path+"."+std::to_string(Current)))+traverse<Current+1>(value, function, path);
+}
+
+// Traverse the end of a tuple-like value
+/// \brief          Traverse the end of a tuple-like value.
+/// \details        Terminal case of the recursion over the elements of a
+///                 tuple or an array.
+/// \tparam         Current Current index.
+/// \tparam         Dummy Dummy type.
+/// \tparam         Type Tuple-like type, possibly const.
+/// \tparam         Function Function type.
+/// \return         Zero.
+template <unsigned int Current, class... Dummy, class Type, class Function, class>
+inline unsigned int Output::traverse(Type&, Function&&, const std::string&)
+{
+    return 0;
+}
+
+// Decode a value
+/// \brief          Decode a value.
+/// \details        Converts raw bytes of the given kind and size to a value.
+/// \tparam         Type Value type.
+/// \param[in]      source Pointer to the bytes.
+/// \param[in]      kind Kind of the bytes.
+/// \param[in]      size Number of bytes.
+/// \return         Converted value, or zero if the representation is not
+///                 supported.
+template <typename Type>
+inline Type Output::decode(const char* source, const char kind, const unsigned int size)
+{
+    float f32 = 0;
+    double f64 = 0;
+    long double f80 = 0;
+    signed char i8 = 0;
+    short int i16 = 0;
+    int i32 = 0;
+    long long int i64 = 0;
+    unsigned char u8 = 0;
+    unsigned short int u16 = 0;
+    unsigned int u32 = 0;
+    unsigned long long int u64 = 0;
+    Type result = Type();
+    if (kind == 'f') {
+        if (size == sizeof(f32)) {
+            std::memcpy(&f32, source, size);
+            result = f32;
+        } else if (size == sizeof(f64)) {
+            std::memcpy(&f64, source, size);
+            result = f64;
+        } else if (size == sizeof(f80)) {
+            std::memcpy(&f80, source, size);
+            result = f80;
+        }
+    } else if (kind == 'i') {
+        if (size == sizeof(i8)) {
+            std::memcpy(&i8, source, size);
+            result = i8;
+        } else if (size == sizeof(i16)) {
+            std::memcpy(&i16, source, size);
+            result = i16;
+        } else if (size == sizeof(i32)) {
+            std::memcpy(&i32, source, size);
+            result = i32;
+        } else if (size == sizeof(i64)) {
+            std::memcpy(&i64, source, size);
+            result = i64;
+        }
+    } else if (kind == 'u') {
+        if (size == sizeof(u8)) {
+            std::memcpy(&u8, source, size);
+            result = u8;
+        } else if (size == sizeof(u16)) {
+            std::memcpy(&u16, source, size);
+            result = u16;
+        } else if (size == sizeof(u32)) {
+            std::memcpy(&u32, source, size);
+            result = u32;
+        } else if (size == sizeof(u64)) {
+            std::memcpy(&u64, source, size);
+            result = u64;
+        }
+    }
+    return result;
+}
+
+// Transcode a value
+/// \brief          Transcode a value.
+/// \details        Converts raw bytes of a given kind and size to raw bytes
+///                 of another kind and size, for example to downcast double
+///                 precision values to single precision.
+/// \param[out]     destination Pointer to the destination bytes.
+/// \param[in]      kind Kind of the destination.
+/// \param[in]      size Number of destination bytes.
+/// \param[in]      source Pointer to the source bytes.
+/// \param[in]      origin Kind of the source.
+/// \param[in]      length Number of source bytes.
+/// \return         True if the destination representation is supported,
+///                 false otherwise.
+inline bool Output::transcode(char* destination, const char kind, const unsigned int size, const char* source, const char origin, const unsigned int length)
+{
+    float f32 = 0;
+    double f64 = 0;
+    long double f80 = 0;
+    signed char i8 = 0;
+    short int i16 = 0;
+    int i32 = 0;
+    long long int i64 = 0;
+    unsigned char u8 = 0;
+    unsigned short int u16 = 0;
+    unsigned int u32 = 0;
+    unsigned long long int u64 = 0;
+    const char* result = nullptr;
+    if ((kind == origin) && (size == length)) {
+        result = source;
+    } else if (kind == 'f') {
+        result = (size == sizeof(f32)) ? (reinterpret_cast<const char*>(&(f32 = decode<float>(source, origin, length)))) : ((size == sizeof(f64)) ? (reinterpret_cast<const char*>(&(f64 = decode<double>(source, origin, length)))) : ((size == sizeof(f80)) ? (reinterpret_cast<const char*>(&(f80 = decode<long double>(source, origin, length)))) : (nullptr)));
+    } else if (kind == 'i') {
+        result = (size == sizeof(i8)) ? (reinterpret_cast<const char*>(&(i8 = decode<signed char>(source, origin, length)))) : ((size == sizeof(i16)) ? (reinterpret_cast<const char*>(&(i16 = decode<short int>(source, origin, length)))) : ((size == sizeof(i32)) ? (reinterpret_cast<const char*>(&(i32 = decode<int>(source, origin, length)))) : ((size == sizeof(i64)) ? (reinterpret_cast<const char*>(&(i64 = decode<long long int>(source, origin, length)))) : (nullptr))));
+    } else if (kind == 'u') {
+        result = (size == sizeof(u8)) ? (reinterpret_cast<const char*>(&(u8 = decode<unsigned char>(source, origin, length)))) : ((size == sizeof(u16)) ? (reinterpret_cast<const char*>(&(u16 = decode<unsigned short int>(source, origin, length)))) : ((size == sizeof(u32)) ? (reinterpret_cast<const char*>(&(u32 = decode<unsigned int>(source, origin, length)))) : ((size == sizeof(u64)) ? (reinterpret_cast<const char*>(&(u64 = decode<unsigned long long int>(source, origin, length)))) : (nullptr))));
+    }
+    if (result) {
+        std::memmove(destination, result, size);
+    }
+    return result;
+}
 // -------------------------------------------------------------------------- //
 
 
@@ -239,6 +421,173 @@ bool Output::save(std::ostream& stream, const Container& x, const Container& y,
 
 
 
+// --------------------------------- BINARY --------------------------------- //
+// Write a binary trajectory
+/// \brief          Write a binary trajectory.
+/// \details        Writes a trajectory in a columnar binary format: a header
+///                 with the byte order mark, the number of steps and the
+///                 list of fields, each one described by its path in the
+///                 step, its kind and its size, followed by the values of
+///                 each field stored contiguously over all steps. Fields
+///                 are listed in the order of the text output.
+/// \tparam         Trajectory Trajectory type.
+/// \param[in,out]  stream Output binary stream.
+/// \param[in]      trajectory Trajectory.
+/// \param[in]      downcast Stores floating point fields in single precision
+///                 if true.
+/// \return         True on success, false otherwise.
+template <class Trajectory, class>
+bool Output::write(std::ostream& stream, const Trajectory& trajectory, const bool downcast)
+{
+    // Initialization
+    typedef typename std::remove_cv<typename std::remove_reference<decltype(trajectory[0])>::type>::type Step;
+    static const std::string magic = "MAGTRAJ1";
+    static const unsigned int version = 1;
+    const unsigned long long int size = trajectory.size();
+    const Step reference = (size > 0) ? (Step(trajectory[0])) : (Step());
+    std::vector<std::string> names;
+    std::vector<char> kinds;
+    std::vector<unsigned int> sizes;
+    std::vector<std::vector<char> > columns;
+    unsigned int nfields = 0;
+    unsigned int ifield = 0;
+    bool ok = true;
+
+    // Describe fields
+    nfields = traverse(reference.get(), [=, &names, &kinds, &sizes](const std::string& path, const char*, const char kind, const unsigned int length){names.push_back(path); kinds.push_back(kind); sizes.push_back(((downcast) && (kind == 'f') && (length > sizeof(float))) ? (sizeof(float)) : (length));});
+    columns.resize(nfields);
+    for (ifield = 0; ifield < nfields; ++ifield) {
+        columns[ifield].resize(size*sizes[ifield]);
+    }
+
+    // Gather columns
+    for (unsigned long long int istep = 0; istep < size; ++istep) {
+        ifield = 0;
+        traverse(trajectory[istep].get(), [=, &ok, &ifield, &kinds, &sizes, &columns](const std::string&, const char* data, const char kind, const unsigned int length){ok = transcode(&columns[ifield][istep*sizes[ifield]], kinds[ifield], sizes[ifield], data, kind, length) && ok; ++ifield;});
+    }
+
+    // Write header and columns
+    if ((ok) && (stream)) {
+        stream.write(magic.data(), magic.size());
+        magrathea::DataHandler::write(stream, magrathea::FileSystem::bom<unsigned int>(), version, nfields, size);
+        for (ifield = 0; ifield < nfields; ++ifield) {
+            magrathea::DataHandler::write(stream, static_cast<unsigned int>(names[ifield].size()));
+            stream.write(names[ifield].data(), names[ifield].size());
+            magrathea::DataHandler::write(stream, kinds[ifield], sizes[ifield]);
+        }
+        for (ifield = 0; ifield < nfields; ++ifield) {
+            stream.write(columns[ifield].data(), columns[ifield].size());
+        }
+    }
+    return (ok) && (stream.good());
+}
+
+// Read a binary trajectory
+/// \brief          Read a binary trajectory.
+/// \details        Reads a trajectory written in the columnar binary format.
+///                 The list of fields should match the one of the steps of
+///                 the trajectory, but fields may have been stored with
+///                 another precision, in which case they are converted back.
+///                 The size of the columns is checked against the remaining
+///                 length of the stream before any allocation, and the
+///                 trajectory is left empty on failure.
+/// \tparam         Trajectory Trajectory type.
+/// \param[in,out]  stream Input binary stream.
+/// \param[out]     trajectory Trajectory.
+/// \return         True on success, false otherwise.
+template <class Trajectory, class>
+bool Output::read(std::istream& stream, Trajectory& trajectory)
+{
+    // Initialization
+    typedef typename std::remove_cv<typename std::remove_reference<decltype(trajectory[0])>::type>::type Step;
+    static const std::string magic = "MAGTRAJ1";
+    std::string mark(magic.size(), char());
+    std::array<unsigned int, 3> types = std::array<unsigned int, 3>();
+    unsigned long long int size = 0;
+    Step reference;
+    std::vector<std::string> names;
+    std::vector<std::string> fields;
+    std::vector<char> kinds;
+    std::vector<unsigned int> sizes;
+    std::vector<std::vector<char> > columns;
+    std::streampos position;
+    unsigned long long int remaining = 0;
+    unsigned int length = 0;
+    unsigned int ifield = 0;
+    bool ok = false;
+
+    // Read header
+    trajectory.clear();
+    stream.read(&mark[0], mark.size());
+    magrathea::DataHandler::read(stream, types);
+    magrathea::DataHandler::read(stream, size);
+    ok = (stream.good()) && (mark == magic) && (types[0] == magrathea::FileSystem::bom<unsigned int>()) && (types[1] == 1);
+    traverse(reference.data(), [&fields](const std::string& path, char*, const char, const unsigned int){fields.push_back(path);});
+    ok = (ok) && (types[2] == fields.size());
+    names.resize((ok) ? (types[2]) : (0));
+    kinds.resize(names.size());
+    sizes.resize(names.size());
+    for (ifield = 0; (ok) && (ifield < names.size()); ++ifield) {
+        ok = magrathea::DataHandler::read(stream, length) && (length <= std::numeric_limits<unsigned char>::max());
+        names[ifield].resize((ok) ? (length) : (0));
+        if ((ok) && (length > 0)) {
+            stream.read(&names[ifield][0], names[ifield].size());
+        }
+        ok = (ok) && (magrathea::DataHandler::read(stream, kinds[ifield], sizes[ifield])) && (names[ifield] == fields[ifield]) && (sizes[ifield] > 0);
+    }
+
+    // Check the length
+    position = stream.tellg();
+    stream.seekg(0, std::ios::end);
+    ok = (ok) && (position >= 0) && (stream.tellg() >= position);
+    remaining = (ok) ? (stream.tellg()-position) : (0);
+    stream.seekg(position);
+    for (ifield = 0; (ok) && (ifield < names.size()); ++ifield) {
+        ok = (size <= remaining/sizes[ifield]);
+        remaining -= (ok) ? (size*sizes[ifield]) : (0);
+    }
+
+    // Read columns
+    columns.resize((ok) ? (names.size()) : (0));
+    for (ifield = 0; (ok) && (ifield < names.size()); ++ifield) {
+        columns[ifield].resize(size*sizes[ifield]);
+        stream.read(columns[ifield].data(), columns[ifield].size());
+        ok = stream.good();
+    }
+
+    // Scatter columns
+    if (ok) {
+        trajectory.resize(size);
+        for (unsigned long long int istep = 0; istep < size; ++istep) {
+            ifield = 0;
+            traverse(trajectory[istep].data(), [=, &ok, &ifield, &kinds, &sizes, &columns](const std::string&, char* data, const char kind, const unsigned int length){ok = transcode(data, kind, length, &columns[ifield][istep*sizes[ifield]], kinds[ifield], sizes[ifield]) && ok; ++ifield;});
+        }
+    }
+    if (!ok) {
+        trajectory.clear();
+    }
+    return ok;
+}
+
+// Convert a binary trajectory to text
+/// \brief          Convert a binary trajectory to text.
+/// \details        Reads a trajectory written in the columnar binary format
+///                 and writes it with the text format of the save function.
+/// \tparam         Trajectory Trajectory type.
+/// \param[in,out]  input Input binary stream.
+/// \param[in,out]  output Output text stream.
+/// \param[in]      digits Optional precision.
+/// \return         True on success, false otherwise.
+template <class Trajectory, class>
+bool Output::convert(std::istream& input, std::ostream& output, const unsigned int digits)
+{
+    Trajectory trajectory;
+    return (read(input, trajectory)) && (save(output, trajectory, digits));
+}
+// -------------------------------------------------------------------------- //
+
+
+
 // ---------------------------------- TEST ---------------------------------- //
 // Example function
 /// \brief          Example function.
@@ -252,8 +601,14 @@ int Output::example()
     const unsigned int width = 40;
     magrathea::SimpleHyperOctree<double, magrathea::SimpleHyperOctreeIndex<unsigned long long int, 3>, unsigned int> octree(0, 1);
     std::array<std::vector<double>, 4> cosmology;
-    std::vector<Photon<double, 3> > trajectory;
+    std::vector<Photon<double, 3> > trajectory(2);
+    std::vector<Photon<double, 3> > copy;
+    std::tuple<int, std::array<double, 2> > tuple;
     std::ostringstream oss;
+    std::stringstream binary;
+    std::istringstream corrupted;
+    std::array<char, sizeof(double)> bytes = std::array<char, sizeof(double)>();
+    double value = 42;
     
     // Construction
     Output output;
@@ -271,6 +626,9 @@ int Output::example()
     std::cout<<std::setw(width*2)<<"output.name(42) : "                                                                 <<output.name(42)<<std::endl;
     std::cout<<std::setw(width*2)<<"output.name(std::make_pair(\"filename_%05d.txt\", 42)) : "                          <<output.name(std::make_pair("filename_%05d.txt", 42))<<std::endl;
     std::cout<<std::setw(width*2)<<"output.name(\"filename_\", std::make_pair(\"%05d.txt\", 42), \".txt\") : "          <<output.name("filename_", std::make_pair("%05d.txt", 42), ".txt")<<std::endl;
+    std::cout<<std::setw(width*2)<<"output.traverse(tuple, [](...){}) : "                                               <<output.traverse(tuple, [](const std::string&, char*, const char, const unsigned int){})<<std::endl;
+    std::cout<<std::setw(width*2)<<"output.decode<int>(&value, 'f', sizeof(value)) : "                                  <<output.decode<int>(reinterpret_cast<const char*>(&value), 'f', sizeof(value))<<std::endl;
+    std::cout<<std::setw(width*2)<<"output.transcode(bytes, 'f', 4, &value, 'f', 8) : "                                 <<output.transcode(bytes.data(), 'f', 4, reinterpret_cast<const char*>(&value), 'f', sizeof(value))<<std::endl;
 
     // Save
     std::cout<<std::endl;
@@ -280,6 +638,17 @@ int Output::example()
     std::cout<<std::setw(width)<<"output.save(oss, trajectory) : "                                                      <<output.save(oss, trajectory)<<std::endl;
     std::cout<<std::setw(width)<<"output.save(oss, cosmology[0], cosmology[1], cosmology[2], cosmology[3]) : "          <<output.save(oss, cosmology[0], cosmology[1], cosmology[2], cosmology[3])<<std::endl;
 
+    // Binary
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Binary : "                                                                          <<std::endl;
+    std::cout<<std::setw(width*2)<<"output.write(binary, trajectory, true) : "                                          <<output.write(binary, trajectory, true)<<std::endl;
+    std::cout<<std::setw(width*2)<<"output.read(binary, copy) : "                                                       <<output.read(binary, copy)<<std::endl;
+    std::cout<<std::setw(width*2)<<"copy.size() : "                                                                     <<copy.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"output.read(corrupted, copy) : "                                                    ; corrupted.str(binary.str().replace(20, 8, 8, char(0x7F))); std::cout<<output.read(corrupted, copy)<<std::endl;
+    std::cout<<std::setw(width*2)<<"copy.size() : "                                                                     <<copy.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"output.write(binary, trajectory) : "                                                <<output.write(binary, trajectory)<<std::endl;
+    std::cout<<std::setw(width*2)<<"output.convert<decltype(copy)>(binary, oss) : "                                     <<output.convert<decltype(copy)>(binary, oss)<<std::endl;
+
     // Finalize
     std::cout<<std::noboolalpha<<std::right<<std::endl;
     std::cout<<"END = Output::example()"<<std::endl;
@@ -0,0 +1,485 @@
+/* ********************************** POOL ********************************** */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Pool
+// DESCRIPTION :    Shared pool of threads for nested parallel loops
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           pool.h
+/// \brief          Shared pool of threads for nested parallel loops
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef POOL_H_INCLUDED
+#define POOL_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <type_traits>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <utility>
+// Include libs
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+// Include project
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Shared pool of threads for nested parallel loops
+/// \brief          Shared pool of threads for nested parallel loops.
+/// \details        Runs parallel loops as tasks on a fixed set of threads.
+///                 A loop can be scheduled from inside another one: the
+///                 calling thread always takes part in its own loop and,
+///                 while waiting for the other tasks to finish, executes
+///                 the pending tasks of this loop instead of blocking.
+///                 Nested loops therefore share the same threads without
+///                 oversubscription and without deadlock, and a thread
+///                 waiting for a short loop never gets stuck in the tasks
+///                 of an unrelated longer one. Worker threads can optionally be pinned
+///                 to distinct cores.
+class Pool final
+{
+    // Lifecycle
+    /// \name           Lifecycle
+    //@{
+    public:
+        explicit inline Pool(const unsigned int nthreads = std::thread::hardware_concurrency(), const bool pin = false);
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+        inline ~Pool();
+    //@}
+
+    // Data
+    /// \name           Data
+    //@{
+    public:
+        inline unsigned int size() const;
+        inline bool pinned() const;
+        inline unsigned int pending();
+    //@}
+
+    // Execution
+    /// \name           Execution
+    //@{
+    public:
+        template <typename Type, class Function, class Timings = std::vector<std::pair<double, double> >, class = typename std::enable_if<std::is_integral<Type>::value>::type> double schedule(const Type nsteps, Function&& function, Timings&& timings = Timings(), const Type grain = Type(1), const unsigned int nthreads = 0);
+        template <class Function, class = typename std::enable_if<!std::is_function<typename std::result_of<Function(unsigned int)>::type>::value>::type> void execute(const unsigned int ntasks, Function&& function);
+        inline bool help();
+    //@}
+
+    // Internal
+    /// \name           Internal
+    //@{
+    protected:
+        template <typename Type> inline void wait(const Type& remaining);
+        template <typename Type, class Function> static inline auto invoke(Function&& function, const Type i, const Type itask) -> decltype(function(i, itask));
+        template <typename Type, class Function> static inline auto invoke(Function&& function, const Type i, const Type) -> decltype(function(i));
+        inline void work();
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+
+    // Data members
+    /// \name           Data members
+    //@{
+    protected:
+        std::vector<std::thread> _threads;                                      ///< Worker threads.
+        std::deque<std::pair<const void*, std::function<void()> > > _tasks;     ///< Pending tasks and their owning loop.
+        std::mutex _mutex;                                                      ///< Mutex protecting the tasks.
+        std::condition_variable _condition;                                     ///< Signal of new or finished tasks.
+        bool _stop;                                                             ///< Stop flag of the workers.
+        bool _pinned;                                                           ///< Pinning flag of the workers.
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- LIFECYCLE -------------------------------- //
+// Explicit constructor
+/// \brief          Explicit constructor.
+/// \details        Starts the worker threads. As the calling thread always
+///                 takes part in the loops, one thread less than the
+///                 requested concurrency is created. When pinning is
+///                 requested and supported, the worker of index i is bound
+///                 to the core of index i modulo the number of cores, so
+///                 that the first core is left to the calling thread.
+/// \param[in]      nthreads Total concurrency, including the calling thread.
+/// \param[in]      pin Pins the workers to distinct cores if true.
+inline Pool::Pool(const unsigned int nthreads, const bool pin)
+: _threads()
+, _tasks()
+, _mutex()
+, _condition()
+, _stop(false)
+, _pinned(false)
+{
+    const unsigned int ncores = std::max(1U, std::thread::hardware_concurrency());
+    _threads.reserve(std::max(1U, nthreads)-1);
+    for (unsigned int ithread = 1; ithread < nthreads; ++ithread) {
+        _threads.push_back(std::thread(&Pool::work, this));
+#if defined(__linux__)
+        if (pin) {
+            cpu_set_t cores;
+            CPU_ZERO(&cores);
+            CPU_SET(ithread%ncores, &cores);
+            _pinned = (pthread_setaffinity_np(_threads.back().native_handle(), sizeof(cores), &cores) == 0) || (_pinned);
+        }
+#else
+        static_cast<void>(pin);
+        static_cast<void>(ncores);
+#endif
+    }
+}
+
+// Destructor
+/// \brief          Destructor.
+/// \details        Lets the workers execute the remaining tasks and joins
+///                 them.
+inline Pool::~Pool()
+{
+    _mutex.lock();
+    _stop = true;
+    _mutex.unlock();
+    _condition.notify_all();
+    std::for_each(_threads.begin(), _threads.end(), [](std::thread& current){current.join();});
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- DATA ---------------------------------- //
+// Size
+/// \brief          Size.
+/// \details        Returns the total concurrency of the pool, including the
+///                 calling thread.
+/// \return         Number of threads.
+inline unsigned int Pool::size() const
+{
+    return _threads.size()+1;
+}
+
+// Pinned
+/// \brief          Pinned.
+/// \details        Checks whether the workers have been pinned to cores.
+/// \return         True if pinned, false otherwise.
+inline bool Pool::pinned() const
+{
+    return _pinned;
+}
+
+// Pending tasks
+/// \brief          Pending tasks.
+/// \details        Returns the number of tasks waiting for a thread.
+/// \return         Number of pending tasks.
+inline unsigned int Pool::pending()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _tasks.size();
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// -------------------------------- EXECUTION ------------------------------- //
+// Dynamic scheduling of a loop on the pool
+/// \brief          Dynamic scheduling of a loop on the pool.
+/// \details        Executes a function for each loop index with a guided 
+///                 scheduling : one task per thread of the pool, or per 
+///                 requested thread, claims chunks of decreasing size from
+///                 a shared counter. The calling thread runs the first task
+///                 and then helps with the pending tasks of this loop until
+///                 all of them are finished. The busy and idle times of 
+///                 each task are written in the timings container. If the function also takes a second argument,
+///                 it receives the index of the task running the iteration,
+///                 which is never used by two iterations at the same time
+///                 and can therefore select per-task data without locking.
+/// \tparam         Type Loop index type.
+/// \tparam         Function Function type taking a loop index, and optionally
+///                 a task index, as arguments.
+/// \tparam         Timings Container of pairs of busy and idle times.
+/// \param[in]      nsteps Total number of steps.
+/// \param[in]      function Function.
+/// \param[out]     timings Busy and idle times in seconds for each task.
+/// \param[in]      grain Minimal number of indices claimed at once.
+/// \param[in]      nthreads Number of tasks, or zero for the size of the
+///                 pool.
+/// \return         Elapsed time in seconds.
+template <typename Type, class Function, class Timings, class>
+double Pool::schedule(const Type nsteps, Function&& function, Timings&& timings, const Type grain, const unsigned int nthreads)
+{
+    static const Type zero = Type();
+    static const Type one = Type(1);
+    const std::chrono::high_resolution_clock::time_point tbegin = std::chrono::high_resolution_clock::now();
+    const Type ntasks = std::max(one, std::min(Type((nthreads > 0) ? (nthreads) : (size())), nsteps));
+    const Type minimum = std::max(one, grain);
+    std::atomic<Type> counter(zero);
+    std::vector<double> busy(ntasks, 0.);
+    Type remaining = ntasks;
+    double elapsed = 0.;
+    auto worker = [=, &nsteps, &function, &counter, &busy, &remaining](const Type itask){
+        std::chrono::high_resolution_clock::time_point tstart;
+        Type first = counter.load();
+        Type size = zero;
+        do {
+            do {
+                size = (first < nsteps) ? (std::min(nsteps-first, std::max(minimum, (nsteps-first)/(ntasks+ntasks)))) : (zero);
+            } while ((size > zero) && (!counter.compare_exchange_weak(first, first+size)));
+            tstart = std::chrono::high_resolution_clock::now();
+            for (Type i = first; i < first+size; ++i) {
+                invoke(function, i, itask);
+            }
+            busy[itask] += std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::high_resolution_clock::now()-tstart).count();
+            first = counter.load();
+        } while (size > zero);
+        _mutex.lock();
+        --remaining;
+        _mutex.unlock();
+        _condition.notify_all();
+    };
+    _mutex.lock();
+    for (Type itask = one; itask < ntasks; ++itask) {
+        _tasks.emplace_back(&remaining, std::bind(worker, itask));
+    }
+    _mutex.unlock();
+    _condition.notify_all();
+    worker(zero);
+    wait(remaining);
+    elapsed = std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::high_resolution_clock::now()-tbegin).count();
+    timings.resize(ntasks);
+    for (Type itask = zero; itask < ntasks; ++itask) {
+        std::get<0>(timings[itask]) = busy[itask];
+        std::get<1>(timings[itask]) = std::max(0., elapsed-busy[itask]);
+    }
+    return elapsed;
+}
+
+// Static execution of tasks on the pool
+/// \brief          Static execution of tasks on the pool.
+/// \details        Executes a function once for each task index. The calling
+///                 thread runs the first task and then helps with the
+///                 pending tasks of this execution until all of them are
+///                 finished. A single task is directly executed
+///                 by the calling thread without involving the pool.
+/// \tparam         Function Function type taking a task index as argument.
+/// \param[in]      ntasks Number of tasks.
+/// \param[in]      function Function.
+template <class Function, class>
+void Pool::execute(const unsigned int ntasks, Function&& function)
+{
+    unsigned int remaining = ntasks;
+    auto worker = [=, &function, &remaining](const unsigned int itask){
+        function(itask);
+        _mutex.lock();
+        --remaining;
+        _mutex.unlock();
+        _condition.notify_all();
+    };
+    if (ntasks > 1) {
+        _mutex.lock();
+        for (unsigned int itask = 1; itask < ntasks; ++itask) {
+            _tasks.emplace_back(&remaining, std::bind(worker, itask));
+        }
+        _mutex.unlock();
+        _condition.notify_all();
+        worker(0);
+        wait(remaining);
+    } else if (ntasks > 0) {
+        function(0U);
+    }
+}
+
+// Help with a pending task
+/// \brief          Help with a pending task.
+/// \details        Executes one pending task in the calling thread, if any.
+/// \return         True if a task has been executed, false otherwise.
+inline bool Pool::help()
+{
+    std::function<void()> task;
+    _mutex.lock();
+    if (!_tasks.empty()) {
+        task = std::move(std::get<1>(_tasks.front()));
+        _tasks.pop_front();
+    }
+    _mutex.unlock();
+    if (task) {
+        task();
+    }
+    return static_cast<bool>(task);
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// -------------------------------- INTERNAL -------------------------------- //
+// Wait for tasks
+/// \brief          Wait for tasks.
+/// \details        Executes the pending tasks owned by the given counter of
+///                 remaining tasks in the calling thread, and blocks once
+///                 all of them have been taken, until the counter, protected
+///                 by the mutex of the pool, reaches zero. Tasks of other
+///                 loops are left to their own threads, so that a loop never
+///                 waits for work it does not depend on. Nested loops still
+///                 complete, as each task taken by another thread only
+///                 waits for its own nested tasks.
+/// \tparam         Type Counter type.
+/// \param[in]      remaining Number of remaining tasks, whose address
+///                 identifies the owned tasks.
+template <typename Type>
+inline void Pool::wait(const Type& remaining)
+{
+    const void* const owner = &remaining;
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto it = _tasks.end();
+    while (remaining > Type()) {
+        it = std::find_if(_tasks.begin(), _tasks.end(), [=](const std::pair<const void*, std::function<void()> >& task){return std::get<0>(task) == owner;});
+        if (it != _tasks.end()) {
+            std::function<void()> task = std::move(std::get<1>(*it));
+            _tasks.erase(it);
+            lock.unlock();
+            task();
+            lock.lock();
+        } else {
+            _condition.wait(lock);
+        }
+    }
+}
+
+// Invoke with the task index
+/// \brief          Invoke with the task index.
+/// \details        Calls a loop function taking both the loop index and the
+///                 task index.
+/// \tparam         Type Index type.
+/// \tparam         Function Function type.
+/// \param[in]      function Function.
+/// \param[in]      i Loop index.
+/// \param[in]      itask Task index.
+/// \return         Result of the function.
+template <typename Type, class Function>
+inline auto Pool::invoke(Function&& function, const Type i, const Type itask) -> decltype(function(i, itask))
+{
+    return function(i, itask);
+}
+
+// Invoke without the task index
+/// \brief          Invoke without the task index.
+/// \details        Calls a loop function only taking the loop index.
+/// \tparam         Type Index type.
+/// \tparam         Function Function type.
+/// \param[in]      function Function.
+/// \param[in]      i Loop index.
+/// \return         Result of the function.
+template <typename Type, class Function>
+inline auto Pool::invoke(Function&& function, const Type i, const Type) -> decltype(function(i))
+{
+    return function(i);
+}
+
+// Worker loop
+/// \brief          Worker loop.
+/// \details        Waits for tasks and executes them until the pool is
+///                 stopped and no task remains.
+inline void Pool::work()
+{
+    std::function<void()> task;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while ((!_stop) || (!_tasks.empty())) {
+        if (!_tasks.empty()) {
+            task = std::move(std::get<1>(_tasks.front()));
+            _tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        } else {
+            _condition.wait(lock);
+        }
+    }
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Pool.
+/// \return         0 if no error.
+int Pool::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Pool::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    std::atomic<unsigned int> counter(0);
+    std::vector<unsigned int> sums(4, 0);
+    std::vector<std::pair<double, double> > timings;
+
+    // Construction
+    Pool pool(4);
+
+    // Lifecycle
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Lifecycle : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"Pool().size() > 0 : "                                                               <<(Pool().size() > 0)<<std::endl;
+    std::cout<<std::setw(width*2)<<"Pool(2).size() : "                                                                  <<Pool(2).size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"Pool(2).pinned() : "                                                                <<Pool(2).pinned()<<std::endl;
+
+    // Data
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Data : "                                                                            <<std::endl;
+    std::cout<<std::setw(width*2)<<"pool.size() : "                                                                     <<pool.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"pool.pinned() : "                                                                   <<pool.pinned()<<std::endl;
+    std::cout<<std::setw(width*2)<<"pool.pending() : "                                                                  <<pool.pending()<<std::endl;
+
+    // Execution
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Execution : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"pool.schedule(42, [](unsigned int){;}) >= 0 : "                                     <<(pool.schedule(42U, [](unsigned int){;}) >= 0)<<std::endl;
+    std::cout<<std::setw(width*2)<<"pool.schedule(8, [&](unsigned int){pool.schedule(8, ++counter);}, timings) >= 0 : " <<(pool.schedule(8U, [&pool, &counter](unsigned int){pool.schedule(8U, [&counter](unsigned int){++counter;});}, timings) >= 0)<<std::endl;
+    std::cout<<std::setw(width*2)<<"counter : "                                                                         <<counter<<std::endl;
+    std::cout<<std::setw(width*2)<<"pool.schedule(42, [&](unsigned int i, unsigned int itask){sums[itask] += i;}) : "   <<(pool.schedule(42U, [&sums](unsigned int i, unsigned int itask){sums[itask] += i;}) >= 0)<<std::endl;
+    std::cout<<std::setw(width*2)<<"std::accumulate(sums.begin(), sums.end(), 0U) : "                                   <<std::accumulate(sums.begin(), sums.end(), 0U)<<std::endl;
+    std::cout<<std::setw(width*2)<<"pool.execute(4, [&](unsigned int){pool.execute(4, ++counter);}) : "                ; pool.execute(4, [&pool, &counter](unsigned int){pool.execute(4, [&counter](unsigned int){++counter;});}); std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"counter : "                                                                         <<counter<<std::endl;
+    std::cout<<std::setw(width*2)<<"timings.size() : "                                                                  <<timings.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"pool.help() : "                                                                     <<pool.help()<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Pool::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // POOL_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
@@ -0,0 +1,296 @@
+/* ******************************* PREFETCHER ******************************* */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Prefetcher
+// DESCRIPTION :    Double buffered loading of a sequence of octrees
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           prefetcher.h
+/// \brief          Double buffered loading of a sequence of octrees
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef PREFETCHER_H_INCLUDED
+#define PREFETCHER_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <type_traits>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <utility>
+#include <tuple>
+// Include libs
+// Include project
+#include "../magrathea/simplehyperoctree.h"
+#include "../magrathea/simplehyperoctreeindex.h"
+#include "gravity.h"
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Double buffered loading of a sequence of octrees
+/// \brief          Double buffered loading of a sequence of octrees.
+/// \details        Loads a sequence of octrees, typically the cones
+///                 processed by one rank, one step ahead of their use. While
+///                 the current octree is used by the caller, the next one is
+///                 loaded asynchronously into a second buffer, so that
+///                 moving to the next octree only waits for the part of the
+///                 loading that has not been overlapped. Each loading also
+///                 returns a value associated with its octree. The memory
+///                 footprint is bounded by the current and the incoming
+///                 octrees, regardless of the length of the sequence.
+/// \tparam         Octree Octree type.
+/// \tparam         Type Type of the value associated with each octree.
+template <class Octree, typename Type = double>
+class Prefetcher final
+{
+    // Lifecycle
+    /// \name           Lifecycle
+    //@{
+    public:
+        template <class Function = std::function<Type(Octree&, const unsigned int)> > explicit inline Prefetcher(Function&& loader = Function());
+        Prefetcher(const Prefetcher<Octree, Type>&) = delete;
+        Prefetcher<Octree, Type>& operator=(const Prefetcher<Octree, Type>&) = delete;
+        inline ~Prefetcher();
+    //@}
+
+    // Sequence
+    /// \name           Sequence
+    //@{
+    public:
+        inline bool start(const unsigned int nitems);
+        inline bool advance(Octree& octree);
+        inline bool pending() const;
+        inline bool last() const;
+        inline unsigned int position() const;
+        inline unsigned int size() const;
+        inline Type value() const;
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+
+    // Data members
+    /// \name           Data members
+    //@{
+    protected:
+        std::function<Type(Octree&, const unsigned int)> _loader;              ///< Loader of an item returning its associated value.
+        Octree _octree;                                                         ///< Incoming octree.
+        std::future<Type> _incoming;                                            ///< Asynchronous loading of the next item.
+        Type _value;                                                            ///< Value associated with the current item.
+        unsigned int _position;                                                 ///< Number of items already delivered.
+        unsigned int _nitems;                                                   ///< Total number of items.
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- LIFECYCLE -------------------------------- //
+// Explicit constructor
+/// \brief          Explicit constructor.
+/// \details        Constructs an empty prefetcher: nothing is loaded until
+///                 the sequence is started.
+/// \tparam         Function Loader type.
+/// \param[in]      loader Function filling an octree with the item of the
+///                 given index and returning its associated value.
+template <class Octree, typename Type>
+template <class Function>
+inline Prefetcher<Octree, Type>::Prefetcher(Function&& loader)
+: _loader(std::forward<Function>(loader))
+, _octree()
+, _incoming()
+, _value()
+, _position(0)
+, _nitems(0)
+{
+    ;
+}
+
+// Destructor
+/// \brief          Destructor.
+/// \details        Waits for the completion of a pending loading.
+template <class Octree, typename Type>
+inline Prefetcher<Octree, Type>::~Prefetcher()
+{
+    if (_incoming.valid()) {
+        _incoming.wait();
+    }
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// -------------------------------- SEQUENCE -------------------------------- //
+// Start
+/// \brief          Start.
+/// \details        Starts loading the first item of a new sequence in the
+///                 background.
+/// \param[in]      nitems Number of items of the sequence.
+/// \return         True if the loading has been started.
+template <class Octree, typename Type>
+inline bool Prefetcher<Octree, Type>::start(const unsigned int nitems)
+{
+    if (_incoming.valid()) {
+        _incoming.wait();
+    }
+    _position = 0;
+    _nitems = (_loader) ? (nitems) : (0);
+    _octree.clear();
+    if (_nitems > 0) {
+        _incoming = std::async(std::launch::async, _loader, std::ref(_octree), 0);
+    }
+    return _incoming.valid();
+}
+
+// Advance
+/// \brief          Advance.
+/// \details        Waits for the incoming item, swaps it with the provided
+///                 octree, releases the previous one and starts the loading
+///                 of the following item.
+/// \param[in,out]  octree Octree receiving the next item.
+/// \return         True if the octree has been replaced, false if the
+///                 sequence was already exhausted.
+template <class Octree, typename Type>
+inline bool Prefetcher<Octree, Type>::advance(Octree& octree)
+{
+    const bool ok = _incoming.valid();
+    if (ok) {
+        _value = _incoming.get();
+        std::swap(octree, _octree);
+        _octree.clear();
+        _octree.shrink();
+        ++_position;
+        if (_position < _nitems) {
+            _incoming = std::async(std::launch::async, _loader, std::ref(_octree), _position);
+        }
+    }
+    return ok;
+}
+
+// Pending
+/// \brief          Pending.
+/// \details        Checks whether an item is being loaded.
+/// \return         True if a loading is pending, false otherwise.
+template <class Octree, typename Type>
+inline bool Prefetcher<Octree, Type>::pending() const
+{
+    return _incoming.valid();
+}
+
+// Last item
+/// \brief          Last item.
+/// \details        Checks whether the last delivered item is the last one of
+///                 the sequence.
+/// \return         True if the sequence cannot advance anymore.
+template <class Octree, typename Type>
+inline bool Prefetcher<Octree, Type>::last() const
+{
+    return !(_position < _nitems);
+}
+
+// Position
+/// \brief          Position.
+/// \details        Returns the number of items already delivered, so that
+///                 the index of the current item is the position minus one.
+/// \return         Number of delivered items.
+template <class Octree, typename Type>
+inline unsigned int Prefetcher<Octree, Type>::position() const
+{
+    return _position;
+}
+
+// Size
+/// \brief          Size.
+/// \details        Returns the total number of items of the sequence.
+/// \return         Number of items.
+template <class Octree, typename Type>
+inline unsigned int Prefetcher<Octree, Type>::size() const
+{
+    return _nitems;
+}
+
+// Value
+/// \brief          Value.
+/// \details        Returns the value returned by the loading of the current
+///                 item.
+/// \return         Associated value.
+template <class Octree, typename Type>
+inline Type Prefetcher<Octree, Type>::value() const
+{
+    return _value;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Prefetcher.
+/// \return         0 if no error.
+template <class Octree, typename Type>
+int Prefetcher<Octree, Type>::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Prefetcher::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    typedef magrathea::SimpleHyperOctree<double, magrathea::SimpleHyperOctreeIndex<unsigned long long int, 3>, Gravity<float, 3> > Tree;
+    auto loader = [](Tree& tree, const unsigned int i){tree.assign(i, 0); return double(i)/2;};
+    Tree tree;
+
+    // Construction
+    Prefetcher<Tree> prefetcher(loader);
+
+    // Lifecycle
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Lifecycle : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"Prefetcher<Tree>().size() : "                                                       <<Prefetcher<Tree>().size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"Prefetcher<Tree>(loader).pending() : "                                              <<Prefetcher<Tree>(loader).pending()<<std::endl;
+
+    // Sequence
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Sequence : "                                                                        <<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.start(3) : "                                                             <<prefetcher.start(3)<<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.size() : "                                                               <<prefetcher.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.advance(tree) : "                                                        <<prefetcher.advance(tree)<<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.position() : "                                                           <<prefetcher.position()<<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.value() : "                                                              <<prefetcher.value()<<std::endl;
+    std::cout<<std::setw(width*2)<<"tree.size() : "                                                                     <<tree.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.advance(tree) : "                                                        <<prefetcher.advance(tree)<<std::endl;
+    std::cout<<std::setw(width*2)<<"tree.size() : "                                                                     <<tree.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.advance(tree) : "                                                        <<prefetcher.advance(tree)<<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.value() : "                                                              <<prefetcher.value()<<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.last() : "                                                               <<prefetcher.last()<<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.pending() : "                                                            <<prefetcher.pending()<<std::endl;
+    std::cout<<std::setw(width*2)<<"prefetcher.advance(tree) : "                                                        <<prefetcher.advance(tree)<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Prefetcher::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // PREFETCHER_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
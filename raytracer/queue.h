@@ -0,0 +1,281 @@
+/* ********************************** QUEUE ********************************* */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Queue
+// DESCRIPTION :    Bounded blocking queue between pipeline stages
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           queue.h
+/// \brief          Bounded blocking queue between pipeline stages
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef QUEUE_H_INCLUDED
+#define QUEUE_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <type_traits>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <utility>
+// Include libs
+// Include project
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Bounded blocking queue between pipeline stages
+/// \brief          Bounded blocking queue between pipeline stages.
+/// \details        First-in first-out queue shared by producer and consumer
+///                 threads. Producers wait while the queue is full, so that
+///                 a fast stage cannot run arbitrarily ahead of a slow one,
+///                 and consumers wait while the queue is empty. Once closed,
+///                 no element can be pushed anymore and consumers drain the
+///                 remaining elements before being released.
+/// \tparam         Type Element type.
+template <class Type>
+class Queue final
+{
+    // Lifecycle
+    /// \name           Lifecycle
+    //@{
+    public:
+        explicit inline Queue(const unsigned int capacity = 1);
+        Queue(const Queue<Type>&) = delete;
+        Queue<Type>& operator=(const Queue<Type>&) = delete;
+    //@}
+
+    // Data
+    /// \name           Data
+    //@{
+    public:
+        inline unsigned int size();
+        inline unsigned int capacity() const;
+        inline bool closed();
+    //@}
+
+    // Operations
+    /// \name           Operations
+    //@{
+    public:
+        template <class Element, class = typename std::enable_if<std::is_convertible<Element, Type>::value>::type> inline bool push(Element&& element);
+        inline bool pop(Type& element);
+        inline void close();
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+
+    // Data members
+    /// \name           Data members
+    //@{
+    protected:
+        std::deque<Type> _elements;                                             ///< Queued elements.
+        std::mutex _mutex;                                                      ///< Mutex protecting the elements.
+        std::condition_variable _condition;                                     ///< Signal of pushed, popped or closed.
+        unsigned int _capacity;                                                 ///< Maximum number of queued elements.
+        bool _closed;                                                           ///< Closing flag.
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- LIFECYCLE -------------------------------- //
+// Explicit constructor
+/// \brief          Explicit constructor.
+/// \details        Constructs an empty open queue.
+/// \param[in]      capacity Maximum number of queued elements.
+template <class Type>
+inline Queue<Type>::Queue(const unsigned int capacity)
+: _elements()
+, _mutex()
+, _condition()
+, _capacity(std::max(1U, capacity))
+, _closed(false)
+{
+    ;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- DATA ---------------------------------- //
+// Size
+/// \brief          Size.
+/// \details        Returns the current number of queued elements.
+/// \return         Number of queued elements.
+template <class Type>
+inline unsigned int Queue<Type>::size()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _elements.size();
+}
+
+// Capacity
+/// \brief          Capacity.
+/// \details        Returns the maximum number of queued elements.
+/// \return         Capacity of the queue.
+template <class Type>
+inline unsigned int Queue<Type>::capacity() const
+{
+    return _capacity;
+}
+
+// Closed
+/// \brief          Closed.
+/// \details        Checks whether the queue has been closed.
+/// \return         True if closed, false otherwise.
+template <class Type>
+inline bool Queue<Type>::closed()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _closed;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- OPERATIONS ------------------------------- //
+// Push
+/// \brief          Push.
+/// \details        Appends an element at the end of the queue, waiting for
+///                 a free slot if the queue is full.
+/// \tparam         Element Element type.
+/// \param[in]      element Element to be appended.
+/// \return         True if the element has been queued, false if the queue
+///                 has been closed.
+template <class Type>
+template <class Element, class>
+inline bool Queue<Type>::push(Element&& element)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    bool ok = false;
+    while ((!_closed) && (_elements.size() >= _capacity)) {
+        _condition.wait(lock);
+    }
+    if (!_closed) {
+        _elements.push_back(std::forward<Element>(element));
+        ok = true;
+    }
+    lock.unlock();
+    _condition.notify_all();
+    return ok;
+}
+
+// Pop
+/// \brief          Pop.
+/// \details        Removes the first element of the queue, waiting for an
+///                 element if the queue is empty and still open.
+/// \param[out]     element Removed element.
+/// \return         True if an element has been removed, false if the queue
+///                 is closed and empty.
+template <class Type>
+inline bool Queue<Type>::pop(Type& element)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    bool ok = false;
+    while ((!_closed) && (_elements.empty())) {
+        _condition.wait(lock);
+    }
+    if (!_elements.empty()) {
+        element = std::move(_elements.front());
+        _elements.pop_front();
+        ok = true;
+    }
+    lock.unlock();
+    _condition.notify_all();
+    return ok;
+}
+
+// Close
+/// \brief          Close.
+/// \details        Closes the queue and releases all waiting threads.
+///                 Already queued elements can still be popped.
+template <class Type>
+inline void Queue<Type>::close()
+{
+    _mutex.lock();
+    _closed = true;
+    _mutex.unlock();
+    _condition.notify_all();
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Queue.
+/// \return         0 if no error.
+template <class Type>
+int Queue<Type>::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Queue::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    unsigned int value = 0;
+    unsigned int sum = 0;
+    std::thread thread;
+
+    // Construction
+    Queue<unsigned int> queue(2);
+
+    // Lifecycle
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Lifecycle : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"Queue<unsigned int>().capacity() : "                                                <<Queue<unsigned int>().capacity()<<std::endl;
+    std::cout<<std::setw(width*2)<<"Queue<unsigned int>(2).capacity() : "                                               <<Queue<unsigned int>(2).capacity()<<std::endl;
+
+    // Data
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Data : "                                                                            <<std::endl;
+    std::cout<<std::setw(width*2)<<"queue.size() : "                                                                    <<queue.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"queue.capacity() : "                                                                <<queue.capacity()<<std::endl;
+    std::cout<<std::setw(width*2)<<"queue.closed() : "                                                                  <<queue.closed()<<std::endl;
+
+    // Operations
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Operations : "                                                                      <<std::endl;
+    thread = std::thread([&queue](){for (unsigned int i = 1; i <= 16; ++i) {queue.push(i);} queue.close();});
+    while (queue.pop(value)) {
+        sum += value;
+    }
+    thread.join();
+    std::cout<<std::setw(width*2)<<"sum of 16 values pushed by another thread : "                                       <<sum<<std::endl;
+    std::cout<<std::setw(width*2)<<"queue.closed() : "                                                                  <<queue.closed()<<std::endl;
+    std::cout<<std::setw(width*2)<<"queue.push(42) : "                                                                  <<queue.push(42)<<std::endl;
+    std::cout<<std::setw(width*2)<<"queue.pop(value) : "                                                                <<queue.pop(value)<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Queue::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // QUEUE_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
@@ -47,6 +47,14 @@
 #include "input.h"
 #include "output.h"
 #include "integrator.h"
+#include "expansion.h"
+#include "checkpoint.h"
+#include "pool.h"
+#include "timeline.h"
+#include "prefetcher.h"
+#include "writer.h"
+#include "aggregator.h"
+#include "accumulator.h"
 // Misc
 using namespace magrathea;
 // -------------------------------------------------------------------------- //
@@ -107,6 +115,8 @@ int main(int argc, char* argv[])
     const uint test = std::stoul(parameter["test"]);
     const uint seed = std::stoul(parameter["seed"]);
     const uint allocation = std::stoul(parameter["allocation"]);
+    const uint chunk = std::stoul(parameter["chunk"]);
+    const uint compression = std::stoul(parameter["compression"]);
     const uint alphacoeff = std::stoul(parameter["alphacoeff"]);
     const uint microcoeff = std::stoul(parameter["microcoeff"]);
     const real mpc = std::stod(parameter["mpc"]);
@@ -117,12 +127,15 @@ int main(int argc, char* argv[])
     const std::string cubefmt = parameter["cubefmt"];
     const std::string conedir = parameter["conedir"];
     const std::string conefmt = parameter["conefmt"];
+    const std::string snapdir = parameter["snapdir"];
+    const std::string snapfmt = parameter["snapfmt"];
     const std::string outputdir = parameter["outputdir"];
     const std::string outputsep = parameter["outputsep"];
     const std::string outputint = parameter["outputint"];
     const std::string outputopening = parameter["outputopening"];
     const std::string outputprefix = parameter["outputprefix"];
     const std::string outputsuffix = parameter["outputsuffix"];
+    const std::string outputbinary = parameter["outputbinary"];
     const std::string outputvisu = parameter["outputvisu"];
     const std::string outputhomo = parameter["outputhomo"];
     const std::string outputschw = parameter["outputschw"];
@@ -135,6 +148,9 @@ int main(int argc, char* argv[])
     const std::string outputref = parameter["outputref"];
     const std::string outputtree = parameter["outputtree"];
     const std::string outputstat = parameter["outputstat"];
+    const std::string outputload = parameter["outputload"];
+    const std::string outputchkp = parameter["outputchkp"];
+    const std::string outputaggr = parameter["outputaggr"];
     const uint correction = std::stoul(parameter["correction"]);
     const uint coarsecorrection = std::stoul(parameter["coarsecorrection"]);
     const uint acorrection = std::stoul(parameter["acorrection"]);
@@ -152,6 +168,17 @@ int main(int argc, char* argv[])
     const std::string statistic = parameter["statistic"];
     const uint makestat = std::stoul(parameter["makestat"]);
     const integer savemode = std::stol(parameter["savemode"]);
+    const uint saveformat = std::stoul(parameter["saveformat"]);
+    const uint writebuffer = std::stoul(parameter["writebuffer"]);
+    const uint aggregate = std::stoul(parameter["aggregate"]);
+    const uint grain = std::stoul(parameter["grain"]);
+    const uint concurrency = std::stoul(parameter["concurrency"]);
+    const uint pinning = std::stoul(parameter["pinning"]);
+    const uint balance = std::stoul(parameter["balance"]);
+    const real checkpoint = std::stod(parameter["checkpoint"]);
+    const uint nsnapshots = std::stoul(parameter["nsnapshots"]);
+    const uint regionlevel = std::stoul(parameter["regionlevel"]);
+    const uint multicone = std::stoul(parameter["multicone"]);
     const uint savetree = std::stoul(parameter["savetree"]);
     const real lboxmpch0 = std::stod(parameter["lboxmpch0"]);
     const real lboxmpc0 = std::stod(parameter["lboxmpc0"]);
@@ -177,17 +204,23 @@ int main(int argc, char* argv[])
     const real yshiftinc = std::stod(parameter["yshiftinc"]);
     const real yshiftcnt = std::stoul(parameter["yshiftcnt"]);
     
+    // Check parameters
+    if ((tdependent > zero) && (!(propagation || preparation || visualization || homogeneous || schwarzschild)) && (nsnapshots == zero)) {
+        std::cerr<<"ERROR : the time-dependent mode requires at least one snapshot (nsnapshots)"<<std::endl;
+        return 1;
+    }
+    
     // Initialization
     std::vector<std::string> interpolations = (interpolation == all) ? (std::vector<std::string>({"redshift", "t", "a", "r"})) : (std::vector<std::string>({interpolation}));
     std::vector<std::string> statistics = (statistic == all) ? (std::vector<std::string>({"distance", "distance2", "homogeneous", "inhomogeneous"})) : (std::vector<std::string>({statistic}));
     uint interpcnt = interpolations.size();
     uint statcnt = statistics.size();
-    uint interpcase = zero;
-    uint statcase = zero;
-    std::string interp;
-    std::string stat;
+    std::vector<uint> interpcases(interpcnt);
+    std::vector<uint> statcases(statcnt);
+    const std::string trajectorysuffix = (saveformat > zero) ? (outputbinary) : (outputsuffix);
     Timer<real> timer;
     FileList conefile(conefmt, zero, ncones, zero, conedir);
+    FileList snapfile(snapfmt, zero, nsnapshots, zero, snapdir);
     SimpleHyperOctree<real, SimpleHyperOctreeIndex<uint, dimension>, std::string, dimension, position, extent> filetree;
     SimpleHyperOctree<real, SimpleHyperOctreeIndex<indexing, dimension>, Gravity<floating, dimension>, dimension, position, extent> octree;
     SimpleHyperOctree<real, SimpleHyperOctreeIndex<indexing, dimension>, Gravity<floating, dimension>, dimension, position, extent> homotree;
@@ -197,45 +230,65 @@ int main(int argc, char* argv[])
     HyperCube<dimension, point> cube(center, diameter);
     HyperSphere<dimension, point> microsphere(center, diameter/microcoeff);
     std::vector<std::string> filelist;
+    std::vector<std::vector<uint> > candidates;
+    std::vector<std::vector<uint> > selection;
+    std::vector<std::vector<element> > buffers;
     std::vector<point> tiling(ncones);
     std::vector<Cone<point> > cone(ncones);
     std::vector<evolution> trajectory(ntrajectories);
+    std::vector<std::vector<evolution> > bundle;
+    std::vector<unsigned char> finished;
     std::vector<Photon<real, dimension> > photons(ntrajectories);
     std::vector<real> random(ntrajectories);
     std::vector<SimpleHyperOctreeIndex<indexing, dimension> > index;
     std::deque<std::atomic<uint> > count;
-    std::array<std::vector<real>, two+two> cosmology;
-    Cone<point> conic;
+    Expansion<real> cosmology;
     Photon<real, dimension> photon;
     Evolution<Photon<real, dimension> > reference;
+    std::vector<Evolution<Photon<real, dimension> > > references;
     real alpha = (two*pi)/alphacoeff;
     real h = zero;
     real omegam = zero;
     real lboxmpch = zero;
     real amin = zero;
-    uint nfiles = zero;
     uint nbundle = zero;
     uint size = zero;
+    uint nrounds = one;
+    uint icone = zero;
+    bool idle = false;
     real opening = zero;
-    integer nthreads = std::thread::hardware_concurrency();
+    integer nthreads = (concurrency > zero) ? (concurrency) : (std::thread::hardware_concurrency());
     integer ntasks = nthreads*zero;
     integer rank = zero;
     std::ofstream stream;
     std::string filename;
+    std::vector<std::string> filenames;
+    std::vector<std::string> referencenames;
     std::mutex mutex;
+    Pool& pool = Utility::pool(nthreads, pinning > zero);
+    Writer writer(static_cast<unsigned long long int>(writebuffer)*std::mega::num);
+    Aggregator aggregator;
     uint statmod = zero;
-    uint statlength = zero;
     uint statsize = zero;
     uint statgsize = zero;
-    std::vector<real> statrefx;
-    std::vector<real> statrefy;
-    std::vector<real> statrefz;
-    std::vector<std::vector<real> > statx;
-    std::vector<std::vector<real> > staty;
+    std::vector<std::vector<real> > statrefx(interpcnt);
+    std::vector<std::vector<real> > statrefy(interpcnt*statcnt);
+    std::vector<std::vector<real> > statrefz(interpcnt);
+    std::vector<Photon<real, dimension> > statreference;
+    std::vector<Accumulator<real> > statseries(interpcnt*statcnt);
+    std::vector<std::vector<Accumulator<real> > > accumulators;
+    Accumulator<real> statglobal;
     std::vector<real> statmean;
     std::vector<real> statstd;
     std::vector<real> statgmean;
     std::vector<real> statgstd;
+    std::vector<std::pair<real, real> > timings;
+    Checkpoint<real> progress(nbundlecnt*openingcnt, ntrajectories);
+    std::string progressfile;
+    uint iconfiguration = zero;
+    uint iprogress = zero;
+    Timeline<decltype(octree), real> timeline(nsnapshots, [=, &snapfile, &cosmology, &h, &omegam, &lboxmpch, &rank](decltype(octree)& tree, const uint i){std::vector<real> a(std::get<1>(cosmology).rbegin(), std::get<1>(cosmology).rend()); std::vector<real> t(std::get<0>(cosmology).rbegin(), std::get<0>(cosmology).rend()); tree.clear(); Input::load(tree, Output::name(snapfile[i], outputsep, std::make_pair(outputint, rank))); Input::correct(tree, correction, coarsecorrection); Input::sistemize(tree, h, omegam, lboxmpch, mpc, rhoch2); tree.shrink(); tree.update(); return (tree.size() > zero) ? (Utility::interpolate(static_cast<real>(std::get<1>(tree[zero]).a()), a, t)) : (real());});
+    Prefetcher<decltype(octree), real> prefetcher([=, &conefile, &cone, &h, &omegam, &lboxmpch, &rank, &ntasks](decltype(octree)& tree, const uint i){real a = zero; const uint itree = rank+i*ntasks; tree.clear(); if (itree < ncones) {if (regionlevel > zero) {Input::load(tree, conefile[itree], Cone<point>(cone[itree].vertex(), cone[itree].base(), cone[itree].angle()+openingcnt*openingmin), regionlevel);} else {Input::load(tree, conefile[itree]);} Input::correct(tree, correction, coarsecorrection, acorrection, a); tree.shrink(); Input::sistemize(tree, h, omegam, lboxmpch, mpc, rhoch2); tree.shrink(); tree.update();} return a;});
     
     // Message passing interface
     MPI_Init(&argc, &argv);
@@ -255,8 +308,15 @@ int main(int argc, char* argv[])
     octree.clear();
     
     // Construct octree
-    if (propagation || visualization || test) {
-        Input::load(octree, conefile[rank]);
+    if (propagation && (multicone > zero)) {
+        nrounds = (ncones+ntasks-one)/ntasks;
+        prefetcher.start(nrounds);
+    } else if (propagation || visualization || test) {
+        if (regionlevel > zero) {
+            Input::load(octree, conefile[rank], Cone<point>(cone[rank].vertex(), cone[rank].base(), (test) ? (openingmin) : (cone[rank].angle()+openingcnt*openingmin)), regionlevel);
+        } else {
+            Input::load(octree, conefile[rank]);
+        }
         Input::correct(octree, correction, coarsecorrection, acorrection, amin);
         octree.shrink();
         if (propagation || visualization || test) {
@@ -265,22 +325,39 @@ int main(int argc, char* argv[])
             Input::homogenize(octree);
         }
     } else if (preparation) {
-        octree.reserve(allocation);
         Input::filetree(filetree, cubedir, cubefmt);
+        Input::distribute(candidates, filetree, microsphere, cone);
+        buffers.resize(ncones);
+        for (uint icone = zero; icone < ncones; ++icone) {
+            FileSystem::remove(Output::name(conefile[icone], outputsep, std::make_pair(outputint, rank)));
+        }
+        for (uint ifile = zero, iselected = zero; ifile < filetree.size(); ++ifile) {
+            if (!candidates[ifile].empty()) {
+                if ((iselected++)%static_cast<uint>(ntasks) == static_cast<uint>(rank)) {
+                    filelist.push_back(std::get<1>(filetree[ifile]));
+                    selection.push_back(candidates[ifile]);
+                }
+            }
+        }
+        Input::scatter(octree, buffers, filelist, ncoarse, microsphere, cone, selection, [=, &conefile, &outputsep, &outputint, &rank](std::vector<element>& buffer, const uint icone){if (buffer.size() > allocation/ncones) {Input::flush(buffer, Output::name(conefile[icone], outputsep, std::make_pair(outputint, rank)));}});
+        for (uint icone = zero; icone < ncones; ++icone) {
+            if (!buffers[icone].empty()) {
+                Input::flush(buffers[icone], Output::name(conefile[icone], outputsep, std::make_pair(outputint, rank)));
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
         for (uint icone = zero; icone < ncones; ++icone) {
             if (icone%static_cast<uint>(ntasks) == static_cast<uint>(rank)) {
                 octree.clear();
-                filelist.clear();
-                conic = cone[icone];
-                Input::prepare(filelist, filetree, microsphere, conic);
-                std::shuffle(std::begin(filelist), std::end(filelist), engine);
-                nfiles = filelist.size();
-                for (uint ifile = zero; ifile < nfiles; ++ifile) {
-                    Input::import(octree, filelist[ifile], ncoarse, [=, &octree, &microsphere, &conic](const element& e){return Input::collide(octree, std::get<0>(e), microsphere, conic);});
+                for (integer irank = zero; irank < ntasks; ++irank) {
+                    filename = Output::name(conefile[icone], outputsep, std::make_pair(outputint, irank));
+                    Input::load(octree, filename);
+                    FileSystem::remove(filename);
                 }
-                Input::save(octree, conefile[icone]);
+                Input::write(octree, conefile[icone], chunk, compression);
             }
         }
+        octree.clear();
     } else if (homogeneous) {
         octree.assign(levelmin, zero);
         Input::homogenize(octree);
@@ -296,177 +373,253 @@ int main(int argc, char* argv[])
         // Initialization
         homotree.assign(ncoarse/two, zero);
         photon = Integrator::launch(center[zero], center[one], center[two], center[zero]+diameter/two, center[one], center[two]);    
-        for (uint itrajectory = zero; itrajectory < ntrajectories; ++itrajectory) {
-            photons[itrajectory] = Integrator::launch(microsphere, cone[rank], cone, engine, distribution);
-            random[itrajectory] = distribution(engine)*two*pi;
+        for (uint iinterp = zero; iinterp < interpcnt; ++iinterp) {
+            if (interpolations[iinterp] == "redshift") {
+                interpcases[iinterp] = zero;
+            } else if (interpolations[iinterp] == "a") {
+                interpcases[iinterp] = one;
+            } else if (interpolations[iinterp] == "t") {
+                interpcases[iinterp] = two;
+            } else if (interpolations[iinterp] == "r") {
+                interpcases[iinterp] = three;
+            } else {
+                interpcases[iinterp] = zero;
+            }
         }
-        // Loop over configurations
-        for (uint ibundle = zero; ibundle < nbundlecnt; ++ibundle) {
-            nbundle = nbundlemin+ibundle;
-            for (uint iopening = zero; iopening < openingcnt; ++iopening) {
-                opening = (iopening+one)*openingmin;
-                for (uint iinterp = zero; iinterp < interpcnt; ++iinterp) {
-                    interp = interpolations[iinterp];
-                    for (uint istat = zero; istat < statcnt; ++istat) {
-                        stat = statistics[istat];
-                        // Reference
-                        filename = Output::name(outputdir, outputprefix, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening), outputsep, interp, outputsep, std::make_pair(outputint, rank));
+        for (uint istat = zero; istat < statcnt; ++istat) {
+            if (statistics[istat] == "distance") {
+                statcases[istat] = zero;
+            } else if (statistics[istat] == "distance2") {
+                statcases[istat] = one;
+            } else if (statistics[istat] == "homogeneous") {
+                statcases[istat] = two;
+            } else if (statistics[istat] == "inhomogeneous") {
+                statcases[istat] = three;
+            } else {
+                statcases[istat] = zero;
+            }
+        }
+        // Output names of a trajectory along each interpolation axis
+        auto names = [=, &filenames](const uint i){
+            std::vector<std::string> result(filenames.size());
+            for (uint iinterp = zero; (!std::signbit(savemode)) && (iinterp < filenames.size()); ++iinterp) {
+                result[iinterp] = Output::name(savemode ? Output::name(filenames[iinterp], outputsep, std::make_pair(outputint, i), outputsep, outputint) : Output::name(filenames[iinterp], outputsep, std::make_pair(outputint, i), outputsep, std::make_pair(outputint, zero)), trajectorysuffix);
+            }
+            return result;
+        };
+        // Derivation of all the statistics from the stored columns of a trajectory : the interpolation axes, then the distances along each axis, a and the redshift
+        auto derive = [=, &interpcases, &statcases, &statrefx](const std::vector<real>& x, const std::vector<real>& y, std::vector<Accumulator<real> >& series){
+            const uint n = x.size()/interpcnt;
+            std::vector<real> abscissa(n);
+            std::vector<real> ordinate(n);
+            for (uint iinterp = zero; (n > zero) && (iinterp < interpcnt); ++iinterp) {
+                abscissa.assign(x.begin()+iinterp*n, x.begin()+(iinterp+one)*n);
+                for (uint istat = zero; istat < statcnt; ++istat) {
+                    for (uint j = zero; j < n; ++j) {
+                        if (statcases[istat] == zero) {
+                            ordinate[j] = y[iinterp*n+j];
+                        } else if (statcases[istat] == one) {
+                            ordinate[j] = y[iinterp*n+j]*y[iinterp*n+j];
+                        } else if (statcases[istat] == two) {
+                            ordinate[j] = y[interpcnt*n]/y[interpcnt*n+j]-one;
+                        } else if (statcases[istat] == three) {
+                            ordinate[j] = y[(interpcnt+one)*n+j];
+                        }
+                    }
+                    series[iinterp*statcnt+istat].add(Utility::reinterpolate(statrefx[iinterp], abscissa, ordinate));
+                }
+            }
+        };
+        // Loop over the cones of the rank
+        for (uint iround = zero; iround < nrounds; ++iround) {
+            // Cone
+            icone = rank+iround*ntasks;
+            idle = !(icone < ncones);
+            if (multicone > zero) {
+                prefetcher.advance(octree);
+                amin = prefetcher.value();
+            }
+            if (checkpoint > zero) {
+                progressfile = Output::name(outputdir, outputprefix, outputsep, outputchkp, outputsep, std::make_pair(outputint, icone));
+                if (!(progress.load(progressfile) && progress.restore(engine))) {
+                    progress.advance(zero).store(engine);
+                }
+                iprogress = (idle) ? (std::numeric_limits<uint>::max()) : (progress.position());
+                MPI_Allreduce(&iprogress, &iconfiguration, one, MPI_UNSIGNED, MPI_MIN, MPI_COMM_WORLD);
+                if (progress.position() != iconfiguration) {
+                    progress.advance(iconfiguration);
+                }
+            } else {
+                progress.advance(zero);
+            }
+            for (uint itrajectory = zero; (!idle) && (itrajectory < ntrajectories); ++itrajectory) {
+                photons[itrajectory] = Integrator::launch(microsphere, cone[icone], cone, engine, distribution);
+                random[itrajectory] = distribution(engine)*two*pi;
+            }
+            // Loop over configurations : each bundle is integrated once and measured along all the interpolation axes
+            for (uint ibundle = zero; ibundle < nbundlecnt; ++ibundle) {
+                nbundle = nbundlemin+ibundle;
+                for (uint iopening = zero; iopening < openingcnt; ++iopening) {
+                    opening = (iopening+one)*openingmin;
+                    // Checkpoint
+                    iconfiguration = ibundle*openingcnt+iopening;
+                    if (iconfiguration < progress.position()) {
+                        continue;
+                    } else if (iconfiguration > progress.position()) {
+                        progress.advance(iconfiguration);
+                    }
+                    // Reference
+                    filenames.clear();
+                    referencenames.clear();
+                    for (uint iinterp = zero; iinterp < interpcnt; ++iinterp) {
+                        filename = Output::name(outputdir, outputprefix, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening), outputsep, interpolations[iinterp], outputsep, std::make_pair(outputint, icone));
                         std::replace(filename.begin(), filename.end(), dot, dotc);
-                        reference = Integrator::propagate<-1>(photon, nbundle, opening, real(), interp, cosmology, homotree, lboxmpch*mpc/h, nsteps*(one << (ncoarse-ncoarse/two))*two, real(), std::signbit(savemode) ? Output::name() : Output::name(filename, outputsuffix));
-                        // Integration without statistics
-                        if (makestat == zero) {
-                            Utility::parallelize(ntrajectories, [=, &photons, &nbundle, &opening, &random, &interp, &cosmology, &octree, &lboxmpch, &mpc, &h, &nsteps, &amin, &filename, &reference, &savemode, &outputsep, &outputint](const uint i){Integrator::propagate(photons[i], nbundle, opening, random[i], interp, cosmology, octree, lboxmpch*mpc/h, nsteps, amin, std::signbit(savemode) ? Output::name() : Output::name(savemode ? Output::name(filename, outputsep, std::make_pair(outputint, i), outputsep, outputint) : Output::name(filename, outputsep, std::make_pair(outputint, i), outputsep, std::make_pair(outputint, zero)), outputsuffix), reference);});
-                        // Integration with statistics
-                        } else {
-                            // Clear statistics arrays
-                            statrefx.clear();
-                            statrefy.clear();
-                            statrefz.clear();
-                            statx.clear();
-                            staty.clear();
-                            statmean.clear();
-                            statstd.clear();
-                            statgmean.clear();
-                            statgstd.clear();
-                            // Interpolation case
-                            if (interp == "redshift") {
-                                interpcase = zero;
-                            } else if (interp == "a") {
-                                interpcase = one;
-                            } else if (interp == "t") {
-                                interpcase = two;
-                            } else if (interp == "r") {
-                                interpcase = three;
-                            } else {
-                                interpcase = zero;
-                            }
-                            // Statistics case
-                            if (stat == "distance") {
-                                statcase = zero;
-                            } else if (stat == "distance2") {
-                                statcase = one;
-                            } else if (stat == "homogeneous") {
-                                statcase = two;
-                            } else if (stat == "inhomogeneous") {
-                                statcase = three;
-                            } else {
-                                statcase = zero;
+                        filenames.emplace_back(filename);
+                        referencenames.emplace_back((std::signbit(savemode) || idle) ? Output::name() : Output::name(filename, outputsuffix));
+                    }
+                    references = Integrator::propagate<-1>(photon, nbundle, opening, real(), interpolations, cosmology, homotree, lboxmpch*mpc/h, nsteps*(one << (ncoarse-ncoarse/two))*two, real(), referencenames);
+                    reference = references.front();
+                    // Integration without statistics
+                    if (makestat == zero) {
+                        pool.schedule((!idle)*ntrajectories, [=, &pool, &photons, &nbundle, &opening, &random, &interpolations, &cosmology, &octree, &lboxmpch, &mpc, &h, &nsteps, &amin, &names, &reference, &writer, &aggregator, &mutex, &progress, &progressfile](const uint i){if (!progress.completed(i)) {(aggregate > zero) ? (Integrator::propagate(photons[i], nbundle, opening, random[i], interpolations, cosmology, octree, lboxmpch*mpc/h, nsteps, amin, names(i), reference, pool, saveformat, &aggregator)) : (Integrator::propagate(photons[i], nbundle, opening, random[i], interpolations, cosmology, octree, lboxmpch*mpc/h, nsteps, amin, names(i), reference, pool, saveformat, &writer)); if (checkpoint > zero) {mutex.lock(); if ((progress.complete(i).due(checkpoint)) && (aggregate == zero)) {writer.flush(); progress.save(progressfile);} mutex.unlock();}}}, timings, grain);
+                    // Integration with statistics
+                    } else {
+                        // Transfer reference
+                        for (uint iinterp = zero; iinterp < interpcnt; ++iinterp) {
+                            statreference.assign(references[iinterp].container().begin(), references[iinterp].container().end());
+                            statreference.erase(std::remove_if(statreference.begin(), statreference.end(), [=, &amin](const Photon<real, dimension>& p){return std::isnormal(amin) && (p.a() < amin);}), statreference.end());
+                            statmod = std::max(one, static_cast<uint>(statreference.size())/std::max(nstat, one));
+                            statrefx[iinterp].clear();
+                            statrefz[iinterp].clear();
+                            for (uint istat = zero; istat < statcnt; ++istat) {
+                                statrefy[iinterp*statcnt+istat].clear();
                             }
-                            // Integration
-                            Utility::parallelize(ntrajectories, [=, &photons, &nbundle, &opening, &random, &interp, &cosmology, &octree, &lboxmpch, &mpc, &h, &nsteps, &amin, &filename, &reference, &savemode, &outputsep, &outputint, &mutex, &interpcase, &statcase, &statx, &staty](const uint i){
-                                evolution result = Integrator::propagate(photons[i], nbundle, opening, random[i], interp, cosmology, octree, lboxmpch*mpc/h, nsteps, amin, std::signbit(savemode) ? Output::name() : Output::name(savemode ? Output::name(filename, outputsep, std::make_pair(outputint, i), outputsep, outputint) : Output::name(filename, outputsep, std::make_pair(outputint, i), outputsep, std::make_pair(outputint, zero)), outputsuffix), reference);
-                                std::vector<std::vector<real> > tmp(two, std::vector<real>(result.size()));
-                                for (uint j = zero; j < result.size(); ++j) {
-                                    if (interpcase == zero) {
-                                        tmp[zero][j] = result[j].redshift();
-                                    } else if (interpcase == one) {
-                                        tmp[zero][j] = result[j].t();
-                                    } else if (interpcase == two) {
-                                        tmp[zero][j] = result[j].a();
-                                    } else if (interpcase == three) {
-                                        tmp[zero][j] = std::sqrt(std::pow(result[j].x()-result[zero].x(), two)+std::pow(result[j].y()-result[zero].y(), two)+std::pow(result[j].z()-result[zero].z(), two));
-                                    }
-                                    if (statcase == zero) {
-                                        tmp[one][j] = result[j].distance();
-                                    } else if (statcase == one) {
-                                        tmp[one][j] = result[j].distance()*result[j].distance();
-                                    } else if (statcase == two) {
-                                        tmp[one][j] = result[zero].a()/result[j].a()-one;
-                                    } else if (statcase == three) {
-                                        tmp[one][j] = result[j].redshift();
-                                    }
-                                }
-                                if (result.size() > zero) {
-                                    mutex.lock();
-                                    statx.emplace_back(std::move(tmp[zero]));
-                                    staty.emplace_back(std::move(tmp[one]));
-                                    mutex.unlock();
-                                }
-                            });
-                            // Transfer reference
-                            reference.container().erase(std::remove_if(reference.container().begin(), reference.container().end(), [=, &amin](const Photon<real, dimension>& p){return std::isnormal(amin) && (p.a() < amin);}), reference.container().end());
-                            statmod = std::max(one, static_cast<uint>(reference.size())/std::max(nstat, one));
-                            for (uint j = zero; j < reference.size(); ++j) {
+                            for (uint j = zero; j < statreference.size(); ++j) {
                                 if (j%statmod == zero) {
-                                    if (interpcase == zero) {
-                                        statrefx.emplace_back(reference[j].redshift());
-                                    } else if (interpcase == one) {
-                                        statrefx.emplace_back(reference[j].t());
-                                    } else if (interpcase == two) {
-                                        statrefx.emplace_back(reference[j].a());
-                                    } else if (interpcase == three) {
-                                        statrefx.emplace_back(std::sqrt(std::pow(reference[j].x()-reference[zero].x(), two)+std::pow(reference[j].y()-reference[zero].y(), two)+std::pow(reference[j].z()-reference[zero].z(), two)));
+                                    if (interpcases[iinterp] == zero) {
+                                        statrefx[iinterp].emplace_back(statreference[j].redshift());
+                                    } else if (interpcases[iinterp] == one) {
+                                        statrefx[iinterp].emplace_back(statreference[j].t());
+                                    } else if (interpcases[iinterp] == two) {
+                                        statrefx[iinterp].emplace_back(statreference[j].a());
+                                    } else if (interpcases[iinterp] == three) {
+                                        statrefx[iinterp].emplace_back(std::sqrt(std::pow(statreference[j].x()-statreference[zero].x(), two)+std::pow(statreference[j].y()-statreference[zero].y(), two)+std::pow(statreference[j].z()-statreference[zero].z(), two)));
                                     }
-                                    if (statcase == zero) {
-                                       statrefy.emplace_back(reference[j].distance());
-                                    } else if (statcase == one) {
-                                        statrefy.emplace_back(reference[j].distance()*reference[j].distance());
-                                    } else if (statcase == two) {
-                                        statrefy.emplace_back(reference[zero].a()/reference[j].a()-one);
-                                    } else if (statcase == three) {
-                                        statrefy.emplace_back(reference[j].redshift());
+                                    for (uint istat = zero; istat < statcnt; ++istat) {
+                                        if (statcases[istat] == zero) {
+                                            statrefy[iinterp*statcnt+istat].emplace_back(statreference[j].distance());
+                                        } else if (statcases[istat] == one) {
+                                            statrefy[iinterp*statcnt+istat].emplace_back(statreference[j].distance()*statreference[j].distance());
+                                        } else if (statcases[istat] == two) {
+                                            statrefy[iinterp*statcnt+istat].emplace_back(statreference[zero].a()/statreference[j].a()-one);
+                                        } else if (statcases[istat] == three) {
+                                            statrefy[iinterp*statcnt+istat].emplace_back(statreference[j].redshift());
+                                        }
                                     }
-                                    statrefz.emplace_back(reference[j].redshift());
+                                    statrefz[iinterp].emplace_back(statreference[j].redshift());
                                 }
                             }
-                            // Resize
-                            statlength = statrefx.size();
-                            statsize = statx.size();
-                            statmean.resize(statlength, real());
-                            statstd.resize(statlength, real());
-                            statgmean.resize(statlength, real());
-                            statgstd.resize(statlength, real());
-                            statmean.shrink_to_fit();
-                            statstd.shrink_to_fit();
-                            statgmean.shrink_to_fit();
-                            statgstd.shrink_to_fit();
-                            // Reinterpolate
-                            Utility::parallelize(statsize, [=, &statrefx, &statx, &staty](const uint j){staty[j] = Utility::reinterpolate(statrefx, statx[j], staty[j]);});
-                            // Reduction
-                            MPI_Allreduce(&statsize, &statgsize, one, MPI_UNSIGNED, MPI_SUM, MPI_COMM_WORLD);
-                            std::fill(statmean.begin(), statmean.end(), real());
-                            for (uint j = zero; j < statsize; ++j) {
-                                for (uint k = zero; k < statlength; ++k) {
-                                    statmean[k] += staty[j][k];
-                                }
+                        }
+                        // Accumulators
+                        for (uint iseries = zero; iseries < statseries.size(); ++iseries) {
+                            statseries[iseries].assign(statrefx[iseries/statcnt].size());
+                        }
+                        accumulators.assign(pool.size(), statseries);
+                        // Restart
+                        for (uint i = zero; i < ntrajectories; ++i) {
+                            if ((progress.completed(i)) && (!std::get<0>(progress.result(i)).empty())) {
+                                derive(std::get<0>(progress.result(i)), std::get<1>(progress.result(i)), accumulators[zero]);
                             }
-                            MPI_Allreduce(statmean.data(), statgmean.data(), statlength, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-                            for (uint k = zero; k < statlength; ++k) {
-                                statmean[k] /= real(statsize);
-                                statgmean[k] /= real(statgsize);
+                        }
+                        // Integration
+                        pool.schedule((!idle)*ntrajectories, [=, &pool, &photons, &nbundle, &opening, &random, &interpolations, &cosmology, &octree, &lboxmpch, &mpc, &h, &nsteps, &amin, &names, &derive, &reference, &writer, &aggregator, &mutex, &interpcases, &accumulators, &progress, &progressfile](const uint i, const uint itask){
+                            if (progress.completed(i)) {
+                                return;
                             }
-                            std::fill(statstd.begin(), statstd.end(), real());
-                            for (uint j = zero; j < statsize; ++j) {
-                                for (uint k = zero; k < statlength; ++k) {
-                                    statstd[k] += (staty[j][k]-statgmean[k])*(staty[j][k]-statgmean[k]);
+                            std::vector<evolution> results = (aggregate > zero) ? (Integrator::propagate(photons[i], nbundle, opening, random[i], interpolations, cosmology, octree, lboxmpch*mpc/h, nsteps, amin, names(i), reference, pool, saveformat, &aggregator)) : (Integrator::propagate(photons[i], nbundle, opening, random[i], interpolations, cosmology, octree, lboxmpch*mpc/h, nsteps, amin, names(i), reference, pool, saveformat, &writer));
+                            const uint n = results.front().size();
+                            std::vector<std::vector<real> > tmp(two);
+                            tmp[zero].resize(interpcnt*n);
+                            tmp[one].resize((interpcnt+two)*n);
+                            for (uint iinterp = zero; iinterp < interpcnt; ++iinterp) {
+                                for (uint j = zero; j < n; ++j) {
+                                    if (interpcases[iinterp] == zero) {
+                                        tmp[zero][iinterp*n+j] = results[iinterp][j].redshift();
+                                    } else if (interpcases[iinterp] == one) {
+                                        tmp[zero][iinterp*n+j] = results[iinterp][j].t();
+                                    } else if (interpcases[iinterp] == two) {
+                                        tmp[zero][iinterp*n+j] = results[iinterp][j].a();
+                                    } else if (interpcases[iinterp] == three) {
+                                        tmp[zero][iinterp*n+j] = std::sqrt(std::pow(results[iinterp][j].x()-results[iinterp][zero].x(), two)+std::pow(results[iinterp][j].y()-results[iinterp][zero].y(), two)+std::pow(results[iinterp][j].z()-results[iinterp][zero].z(), two));
+                                    }
+                                    tmp[one][iinterp*n+j] = results[iinterp][j].distance();
                                 }
                             }
-                            MPI_Allreduce(statstd.data(), statgstd.data(), statlength, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-                            std::fill(statstd.begin(), statstd.end(), real());
-                            for (uint j = zero; j < statsize; ++j) {
-                                for (uint k = zero; k < statlength; ++k) {
-                                    statstd[k] += (staty[j][k]-statmean[k])*(staty[j][k]-statmean[k]);
+                            for (uint j = zero; j < n; ++j) {
+                                tmp[one][interpcnt*n+j] = results.front()[j].a();
+                                tmp[one][(interpcnt+one)*n+j] = results.front()[j].redshift();
+                            }
+                            derive(tmp[zero], tmp[one], accumulators[itask]);
+                            if (checkpoint > zero) {
+                                mutex.lock();
+                                if ((progress.complete(i, tmp[zero], tmp[one]).due(checkpoint)) && (aggregate == zero)) {
+                                    writer.flush();
+                                    progress.save(progressfile);
                                 }
+                                mutex.unlock();
                             }
-                            for (uint k = zero; k < statlength; ++k) {
-                                statstd[k] = std::sqrt(statstd[k]/real(statsize-one));
-                                statgstd[k] = std::sqrt(statgstd[k]/real(statgsize-one));
+                        }, timings, grain);
+                        // Reduction and output of each statistic along each interpolation axis
+                        for (uint iseries = zero; iseries < statseries.size(); ++iseries) {
+                            for (uint j = one; j < accumulators.size(); ++j) {
+                                accumulators[zero][iseries].merge(accumulators[j][iseries]);
                             }
-                            // Output statistics
-                            filename = Output::name(outputdir, outputprefix, outputsep, outputstat, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening), outputsep, interp, outputsep, stat, outputsep, std::make_pair(outputint, rank));
+                            statglobal = accumulators[zero][iseries];
+                            statglobal.reduce(MPI_COMM_WORLD);
+                            statsize = accumulators[zero][iseries].count();
+                            statgsize = statglobal.count();
+                            statmean = accumulators[zero][iseries].mean();
+                            statstd = accumulators[zero][iseries].deviation();
+                            statgmean = statglobal.mean();
+                            statgstd = statglobal.deviation();
+                            filename = Output::name(outputdir, outputprefix, outputsep, outputstat, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening), outputsep, interpolations[iseries/statcnt], outputsep, statistics[iseries%statcnt], outputsep, std::make_pair(outputint, icone));
                             std::replace(filename.begin(), filename.end(), dot, dotc);
-                            stream.open(Output::name(filename, outputsuffix));
-                            Output::save(stream, statrefz, statrefy, statmean, statstd, digits, statsize);
-                            stream.close();
-                            filename = Output::name(outputdir, outputprefix, outputsep, outputstat, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening), outputsep, interp, outputsep, stat);
+                            if (!idle) {
+                                stream.open(Output::name(filename, outputsuffix));
+                                Output::save(stream, statrefz[iseries/statcnt], statrefy[iseries], statmean, statstd, digits, statsize);
+                                stream.close();
+                            }
+                            filename = (multicone > zero) ? (Output::name(outputdir, outputprefix, outputsep, outputstat, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening), outputsep, interpolations[iseries/statcnt], outputsep, statistics[iseries%statcnt], outputsep, std::make_pair(outputint, iround))) : (Output::name(outputdir, outputprefix, outputsep, outputstat, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening), outputsep, interpolations[iseries/statcnt], outputsep, statistics[iseries%statcnt]));
                             std::replace(filename.begin(), filename.end(), dot, dotc);
                             if (rank == zero) {
                                 stream.open(Output::name(filename, outputsuffix));
-                                Output::save(stream, statrefz, statrefy, statgmean, statgstd, digits, statgsize);
+                                Output::save(stream, statrefz[iseries/statcnt], statrefy[iseries], statgmean, statgstd, digits, statgsize);
                                 stream.close();
                             }
                         }
                     }
+                    // Aggregated output
+                    if ((aggregate > zero) && (!std::signbit(savemode))) {
+                        filename = (multicone > zero) ? (Output::name(outputdir, outputprefix, outputsep, outputaggr, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening), outputsep, std::make_pair(outputint, iround))) : (Output::name(outputdir, outputprefix, outputsep, outputaggr, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening)));
+                        std::replace(filename.begin(), filename.end(), dot, dotc);
+                        aggregator.write(Output::name(filename, outputsuffix), MPI_COMM_WORLD);
+                    }
+                    // Load balance
+                    if ((balance > zero) && (!idle)) {
+                        filename = Output::name(outputdir, outputprefix, outputsep, outputload, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening), outputsep, std::make_pair(outputint, icone));
+                        std::replace(filename.begin(), filename.end(), dot, dotc);
+                        stream.open(Output::name(filename, outputsuffix));
+                        stream<<std::setprecision(digits);
+                        for (uint j = zero; j < timings.size(); ++j) {
+                            stream<<j<<" "<<timings[j].first<<" "<<timings[j].second<<std::endl;
+                        }
+                        stream.close();
+                    }
+                    // Checkpoint
+                    if ((checkpoint > zero) && (!idle)) {
+                        writer.flush();
+                        progress.advance(iconfiguration+one).save(progressfile);
+                    }
                 }
             }
         }
@@ -487,7 +640,7 @@ int main(int argc, char* argv[])
         filename = Output::name(outputdir, outputprefix, outputsep, outputhomo, outputsep, outputrk4, outputsep, outputint, outputsuffix);
         Utility::parallelize(std::begin(trajectory), std::end(trajectory), [=, &photon](evolution& e){e.append(photon);});
         Utility::parallelize(stepcnt, [=, &trajectory, &cosmology, &octree, &lboxmpch0, &mpc, &h, &stepmin, &stepinc, &stepmul](const uint i){Integrator::integrate<-1>(trajectory[i], cosmology, octree, lboxmpch0*mpc/h, static_cast<uint>(stepmin*std::pow(stepmul, i)+i*stepinc));});
-        Utility::parallelize(stepcnt, [=, &trajectory, &filename](const uint i){std::ofstream outputstream(Output::name(std::make_pair(filename, i))); Output::save(outputstream, trajectory[i], digits); outputstream.close();});
+        Utility::parallelize(stepcnt, [=, &trajectory, &filename, &writer](const uint i){std::ostringstream outputstream; Output::save(outputstream, trajectory[i], digits); writer.push(Output::name(std::make_pair(filename, i)), outputstream.str());});
         if (savetree > zero) {
             filename = Output::name(outputdir, outputprefix, outputsep, outputhomo, outputsep, outputtree, outputsuffix);
             stream.open(filename);
@@ -499,19 +652,19 @@ int main(int argc, char* argv[])
         filename = Output::name(outputdir, outputprefix, outputsep, outputschw, outputsep, outputngp, outputsep, outputrk4, outputsep, std::make_pair(outputint, levelmin), outputsep, std::make_pair(outputint, levelmax), outputsep, outputint, outputsuffix);
         Utility::parallelize(yshiftcnt, [=, &trajectory, &yshiftmin, &yshiftmul, &yshiftinc](const uint i){real yshift = std::min(yshiftmin*std::pow(yshiftmul, i)+i*yshiftinc, diameter/two); trajectory[i].append(Integrator::launch(x0, y0+yshift, z0, x, y+yshift, z));});
         Utility::parallelize(yshiftcnt, [=, &trajectory, &cosmology, &octree, &lboxmpc0, &mpc](const uint i){Integrator::integrate<0, true>(trajectory[i], cosmology, octree, lboxmpc0*mpc, nsteps);});
-        Utility::parallelize(yshiftcnt, [=, &trajectory, &filename](const uint i){std::ofstream outputstream(Output::name(std::make_pair(filename, i))); Output::save(outputstream, trajectory[i], digits); outputstream.close();});
+        Utility::parallelize(yshiftcnt, [=, &trajectory, &filename, &writer](const uint i){std::ostringstream outputstream; Output::save(outputstream, trajectory[i], digits); writer.push(Output::name(std::make_pair(filename, i)), outputstream.str());});
         trajectory.clear();
         trajectory.resize(yshiftcnt);
         filename = Output::name(outputdir, outputprefix, outputsep, outputschw, outputsep, outputcic, outputsep, outputrk4, outputsep, std::make_pair(outputint, levelmin), outputsep, std::make_pair(outputint, levelmax), outputsep, outputint, outputsuffix);
         Utility::parallelize(yshiftcnt, [=, &trajectory, &yshiftmin, &yshiftmul, &yshiftinc](const uint i){real yshift = std::min(yshiftmin*std::pow(yshiftmul, i)+i*yshiftinc, diameter/two); trajectory[i].append(Integrator::launch(x0, y0+yshift, z0, x, y+yshift, z));});
         Utility::parallelize(yshiftcnt, [=, &trajectory, &cosmology, &octree, &lboxmpc0, &mpc](const uint i){Integrator::integrate<1, true>(trajectory[i], cosmology, octree, lboxmpc0*mpc, nsteps);});
-        Utility::parallelize(yshiftcnt, [=, &trajectory, &filename](const uint i){std::ofstream outputstream(Output::name(std::make_pair(filename, i))); Output::save(outputstream, trajectory[i], digits); outputstream.close();});
+        Utility::parallelize(yshiftcnt, [=, &trajectory, &filename, &writer](const uint i){std::ostringstream outputstream; Output::save(outputstream, trajectory[i], digits); writer.push(Output::name(std::make_pair(filename, i)), outputstream.str());});
         trajectory.clear();
         trajectory.resize(yshiftcnt);
         filename = Output::name(outputdir, outputprefix, outputsep, outputschw, outputsep, outputref, outputsep, outputrk4, outputsep, std::make_pair(outputint, levelmin), outputsep, std::make_pair(outputint, levelmax), outputsep, outputint, outputsuffix);
         Utility::parallelize(yshiftcnt, [=, &trajectory, &yshiftmin, &yshiftmul, &yshiftinc](const uint i){real yshift = std::min(yshiftmin*std::pow(yshiftmul, i)+i*yshiftinc, diameter/two); trajectory[i].append(Integrator::launch(x0, y0+yshift, z0, x, y+yshift, z));});
         Utility::parallelize(yshiftcnt, [=, &trajectory, &cosmology, &octree, &lboxmpc0, &mpc, &massmsun](const uint i){Integrator::integrate<0, true>(trajectory[i], cosmology, octree, lboxmpc0*mpc, nsteps, massmsun*msun);});
-        Utility::parallelize(yshiftcnt, [=, &trajectory, &filename](const uint i){std::ofstream outputstream(Output::name(std::make_pair(filename, i))); Output::save(outputstream, trajectory[i], digits); outputstream.close();});
+        Utility::parallelize(yshiftcnt, [=, &trajectory, &filename, &writer](const uint i){std::ostringstream outputstream; Output::save(outputstream, trajectory[i], digits); writer.push(Output::name(std::make_pair(filename, i)), outputstream.str());});
         if (savetree > zero) {
             filename = Output::name(outputdir, outputprefix, outputsep, outputschw, outputsep, outputtree, outputsuffix);
             stream.open(filename);
@@ -519,6 +672,38 @@ int main(int argc, char* argv[])
             stream.close();
         }
     } else if (tdependent) {
+        // Initialization
+        nbundle = nbundlemin;
+        opening = openingmin;
+        filename = Output::name(outputdir, outputprefix, outputsep, outputtdep, outputsep, std::make_pair(outputint, nbundle), outputsep, std::make_pair(outputopening, opening), outputsep, interpolation, outputsep, std::make_pair(outputint, rank));
+        std::replace(filename.begin(), filename.end(), dot, dotc);
+        photon = Integrator::launch(center[zero], center[one], center[two], center[zero]+diameter/two, center[one], center[two]);
+        homotree.assign(ncoarse/two, zero);
+        reference = Integrator::propagate<-1>(photon, nbundle, opening, real(), interpolation, cosmology, homotree, lboxmpch*mpc/h, nsteps*(one << (ncoarse-ncoarse/two))*two, real(), Output::name(filename, outputsuffix));
+        homotree.clear();
+        homotree.shrink();
+        bundle.resize(ntrajectories);
+        finished.assign(ntrajectories*(nbundle+one), zero);
+        for (uint itrajectory = zero; itrajectory < ntrajectories; ++itrajectory) {
+            photons[itrajectory] = Integrator::launch(microsphere, cone[rank], cone, engine, distribution);
+            random[itrajectory] = distribution(engine)*two*pi;
+        }
+        Utility::parallelize(ntrajectories, [=, &bundle, &photons, &random, &nbundle, &opening](const uint i){std::vector<Photon<real, dimension> > initial = Integrator::launch<true>(photons[i], nbundle, opening, random[i]); bundle[i].resize(initial.size()); for (uint j = zero; j < initial.size(); ++j) {bundle[i][j].append(initial[j]);}});
+        // Integration window by window
+        timeline.start();
+        do {
+            pool.schedule(ntrajectories*(nbundle+one), [=, &bundle, &finished, &cosmology, &timeline, &nbundle, &lboxmpch, &mpc, &h, &nsteps](const uint k){
+                evolution& current = bundle[k/(nbundle+one)][k%(nbundle+one)];
+                if (!finished[k]) {
+                    Integrator::integrate(current, cosmology, timeline, lboxmpch*mpc/h, nsteps, std::true_type(), [=, &timeline](const evolution& e){return (!timeline.last()) && (e.back().t() > timeline.upper());});
+                    finished[k] = (current.empty()) || (timeline.last()) || (!(current.back().t() > timeline.upper()));
+                }
+            }, timings, grain);
+        } while (timeline.advance());
+        // Measurement
+        pool.schedule(ntrajectories, [=, &bundle, &timeline, &opening, &lboxmpch, &mpc, &h, &amin, &filename, &reference, &savemode, &outputsep, &outputint, &writer](const uint i){Integrator::measure(bundle[i], timeline, opening, interpolation, lboxmpch*mpc/h, amin, std::signbit(savemode) ? Output::name() : Output::name(savemode ? Output::name(filename, outputsep, std::make_pair(outputint, i), outputsep, outputint) : Output::name(filename, outputsep, std::make_pair(outputint, i), outputsep, std::make_pair(outputint, zero)), trajectorysuffix), reference, saveformat, &writer);}, timings, grain);
+        bundle.clear();
+        finished.clear();
     } else if (test) {
         photons.resize(one);
         random.resize(one);
@@ -533,7 +718,7 @@ int main(int argc, char* argv[])
         reference = Integrator::propagate<-1>(photon, nbundle, opening, real(), interpolation, cosmology, homotree, lboxmpch*mpc/h, nsteps*(one << (ncoarse-ncoarse/two))*two, real(), Output::name(filename, outputsuffix));
         homotree.clear();
         homotree.shrink();
-        reference = Integrator::propagate(photons[zero], nbundle, opening, random[zero], interpolation, cosmology, octree, lboxmpch*mpc/h, nsteps, amin, std::signbit(savemode) ? Output::name() : Output::name(savemode ? Output::name(filename, outputsep, std::make_pair(outputint, zero), outputsep, outputint) : Output::name(filename, outputsep, std::make_pair(outputint, zero), outputsep, std::make_pair(outputint, zero)), outputsuffix), reference);
+        reference = Integrator::propagate(photons[zero], nbundle, opening, random[zero], interpolation, cosmology, octree, lboxmpch*mpc/h, nsteps, amin, std::signbit(savemode) ? Output::name() : Output::name(savemode ? Output::name(filename, outputsep, std::make_pair(outputint, zero), outputsep, outputint) : Output::name(filename, outputsep, std::make_pair(outputint, zero), outputsep, std::make_pair(outputint, zero)), trajectorysuffix), reference, pool, saveformat, &writer);
         if (!reference.empty()) {
             size = zero;
             count.resize(octree.size());
@@ -563,6 +748,7 @@ int main(int argc, char* argv[])
     }
     
     // Finalization
+    writer.close();
     MPI_Finalize();
     return 0;
 }
@@ -0,0 +1,513 @@
+/* ******************************** TIMELINE ******************************** */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Timeline
+// DESCRIPTION :    Streaming cache of octree snapshots for time-dependent runs
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           timeline.h
+/// \brief          Streaming cache of octree snapshots for time-dependent runs
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef TIMELINE_H_INCLUDED
+#define TIMELINE_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <type_traits>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <utility>
+#include <tuple>
+#include <array>
+// Include libs
+// Include project
+#include "../magrathea/simplehyperoctree.h"
+#include "../magrathea/simplehyperoctreeindex.h"
+#include "gravity.h"
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Streaming cache of octree snapshots for time-dependent runs
+/// \brief          Streaming cache of octree snapshots for time-dependent
+///                 runs.
+/// \details        Holds the two octrees bracketing the current time window
+///                 of a sequence of snapshots, and interpolates their data
+///                 linearly in time. While photons are integrated inside the
+///                 window, the following snapshot is loaded asynchronously,
+///                 so that advancing the window only waits for the part of
+///                 the loading that has not been overlapped. The memory
+///                 footprint is bounded by the two bracketing octrees and
+///                 the incoming one, regardless of the number of snapshots.
+///                 The class provides the interface of an octree used by
+///                 the integrator, with an additional time argument for the
+///                 interpolation.
+/// \tparam         Octree Octree type.
+/// \tparam         Type Time type.
+template <class Octree, typename Type = double>
+class Timeline final
+{
+    // Lifecycle
+    /// \name           Lifecycle
+    //@{
+    public:
+        template <class Function = std::function<Type(Octree&, const unsigned int)> > explicit inline Timeline(const unsigned int nsnapshots = 0, Function&& loader = Function());
+        Timeline(const Timeline<Octree, Type>&) = delete;
+        Timeline<Octree, Type>& operator=(const Timeline<Octree, Type>&) = delete;
+        inline ~Timeline();
+    //@}
+
+    // Window
+    /// \name           Window
+    //@{
+    public:
+        inline bool start();
+        inline bool advance();
+        inline bool ready() const;
+        inline bool last() const;
+        inline unsigned int snapshot() const;
+        inline unsigned int size() const;
+        inline Type lower() const;
+        inline Type upper() const;
+        inline Type weight(const Type t) const;
+        inline const Octree& front() const;
+        inline const Octree& back() const;
+    //@}
+
+    // Octree
+    /// \name           Octree
+    //@{
+    public:
+        template <class Iterator = decltype(std::declval<const Octree>().locate(std::declval<Type>(), std::declval<Type>(), std::declval<Type>()))> inline Iterator locate(const Type x, const Type y, const Type z) const;
+        template <class Data = typename std::tuple_element<1, decltype(Octree::element())>::type> inline Data ngp(const Type x, const Type y, const Type z, const Type t) const;
+        template <class Data = typename std::tuple_element<1, decltype(Octree::element())>::type> inline Data cic(const Type x, const Type y, const Type z, const Type t) const;
+        template <class Data> static inline Data blend(const Data& first, const Data& second, const Type coefficient);
+    //@}
+
+    // Properties
+    /// \name           Properties
+    //@{
+    public:
+        static constexpr decltype(Octree::position()) position();
+        static constexpr decltype(Octree::extent()) extent();
+        static constexpr decltype(Octree::element()) element();
+        static constexpr unsigned int dimension();
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+
+    // Data members
+    /// \name           Data members
+    //@{
+    protected:
+        std::function<Type(Octree&, const unsigned int)> _loader;              ///< Loader of a snapshot returning its time.
+        std::array<Octree, 3> _octrees;                                         ///< Lower, upper and incoming octrees.
+        std::array<Type, 3> _times;                                             ///< Lower, upper and incoming times.
+        std::future<Type> _incoming;                                            ///< Asynchronous loading of the next snapshot.
+        unsigned int _position;                                                 ///< Index of the lower snapshot.
+        unsigned int _nsnapshots;                                               ///< Total number of snapshots.
+        bool _ready;                                                            ///< Whether the window has been started.
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- LIFECYCLE -------------------------------- //
+// Explicit constructor
+/// \brief          Explicit constructor.
+/// \details        Constructs an empty timeline: no snapshot is loaded until
+///                 the window is started.
+/// \tparam         Function Loader type.
+/// \param[in]      nsnapshots Number of snapshots, sorted by increasing time.
+/// \param[in]      loader Function filling an octree with the snapshot of
+///                 the given index and returning the time of the snapshot.
+template <class Octree, typename Type>
+template <class Function>
+inline Timeline<Octree, Type>::Timeline(const unsigned int nsnapshots, Function&& loader)
+: _loader(std::forward<Function>(loader))
+, _octrees()
+, _times()
+, _incoming()
+, _position(0)
+, _nsnapshots(nsnapshots)
+, _ready(false)
+{
+    ;
+}
+
+// Destructor
+/// \brief          Destructor.
+/// \details        Waits for the completion of a pending loading.
+template <class Octree, typename Type>
+inline Timeline<Octree, Type>::~Timeline()
+{
+    if (_incoming.valid()) {
+        _incoming.wait();
+    }
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// --------------------------------- WINDOW --------------------------------- //
+// Start
+/// \brief          Start.
+/// \details        Loads the first two snapshots and starts loading the
+///                 third one in the background.
+/// \return         True if at least one snapshot has been loaded.
+template <class Octree, typename Type>
+inline bool Timeline<Octree, Type>::start()
+{
+    if (_incoming.valid()) {
+        _incoming.wait();
+    }
+    _position = 0;
+    _ready = (_nsnapshots > 0) && (_loader);
+    if (_ready) {
+        _times[0] = _loader(_octrees[0], 0);
+        _times[1] = (_nsnapshots > 1) ? (_loader(_octrees[1], 1)) : (_times[0]);
+        if (_nsnapshots > 2) {
+            _incoming = std::async(std::launch::async, _loader, std::ref(_octrees[2]), 2);
+        }
+    }
+    return _ready;
+}
+
+// Advance
+/// \brief          Advance.
+/// \details        Moves the window to the next pair of snapshots: the
+///                 lower octree is released, the upper one becomes the lower
+///                 one, the incoming one becomes the upper one, and the
+///                 loading of the following snapshot is started.
+/// \return         True if the window has been moved, false if the last
+///                 snapshot was already reached.
+template <class Octree, typename Type>
+inline bool Timeline<Octree, Type>::advance()
+{
+    const bool ok = (_ready) && (_incoming.valid());
+    if (ok) {
+        _times[2] = _incoming.get();
+        std::swap(_octrees[0], _octrees[1]);
+        std::swap(_octrees[1], _octrees[2]);
+        std::swap(_times[0], _times[1]);
+        std::swap(_times[1], _times[2]);
+        _octrees[2].clear();
+        _octrees[2].shrink();
+        ++_position;
+        if (_position+2 < _nsnapshots) {
+            _incoming = std::async(std::launch::async, _loader, std::ref(_octrees[2]), _position+2);
+        }
+    }
+    return ok;
+}
+
+// Ready
+/// \brief          Ready.
+/// \details        Checks whether the window has been started.
+/// \return         True if started, false otherwise.
+template <class Octree, typename Type>
+inline bool Timeline<Octree, Type>::ready() const
+{
+    return _ready;
+}
+
+// Last window
+/// \brief          Last window.
+/// \details        Checks whether the upper snapshot is the last one.
+/// \return         True if the window cannot advance anymore.
+template <class Octree, typename Type>
+inline bool Timeline<Octree, Type>::last() const
+{
+    return !(_position+2 < _nsnapshots);
+}
+
+// Snapshot
+/// \brief          Snapshot.
+/// \details        Returns the index of the lower snapshot.
+/// \return         Snapshot index.
+template <class Octree, typename Type>
+inline unsigned int Timeline<Octree, Type>::snapshot() const
+{
+    return _position;
+}
+
+// Size
+/// \brief          Size.
+/// \details        Returns the total number of snapshots.
+/// \return         Number of snapshots.
+template <class Octree, typename Type>
+inline unsigned int Timeline<Octree, Type>::size() const
+{
+    return _nsnapshots;
+}
+
+// Lower time
+/// \brief          Lower time.
+/// \details        Returns the time of the lower snapshot.
+/// \return         Time.
+template <class Octree, typename Type>
+inline Type Timeline<Octree, Type>::lower() const
+{
+    return _times[0];
+}
+
+// Upper time
+/// \brief          Upper time.
+/// \details        Returns the time of the upper snapshot.
+/// \return         Time.
+template <class Octree, typename Type>
+inline Type Timeline<Octree, Type>::upper() const
+{
+    return _times[1];
+}
+
+// Interpolation weight
+/// \brief          Interpolation weight.
+/// \details        Computes the weight of the upper snapshot at the given
+///                 time, clamped to the window.
+/// \param[in]      t Time.
+/// \return         Weight between zero and one.
+template <class Octree, typename Type>
+inline Type Timeline<Octree, Type>::weight(const Type t) const
+{
+    return (_times[1] > _times[0]) ? (std::min(Type(1), std::max(Type(0), (t-_times[0])/(_times[1]-_times[0])))) : (Type(0));
+}
+
+// Lower octree
+/// \brief          Lower octree.
+/// \details        Returns the octree of the lower snapshot.
+/// \return         Constant reference to the octree.
+template <class Octree, typename Type>
+inline const Octree& Timeline<Octree, Type>::front() const
+{
+    return _octrees[0];
+}
+
+// Upper octree
+/// \brief          Upper octree.
+/// \details        Returns the octree of the upper snapshot.
+/// \return         Constant reference to the octree.
+template <class Octree, typename Type>
+inline const Octree& Timeline<Octree, Type>::back() const
+{
+    return _octrees[1];
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// --------------------------------- OCTREE --------------------------------- //
+// Location
+/// \brief          Location.
+/// \details        Locates the leaf containing the provided position in the
+///                 lower octree, which drives the refinement level and the
+///                 integration step.
+/// \tparam         Iterator Iterator type.
+/// \param[in]      x Position along the first dimension.
+/// \param[in]      y Position along the second dimension.
+/// \param[in]      z Position along the third dimension.
+/// \return         Iterator to the leaf.
+template <class Octree, typename Type>
+template <class Iterator>
+inline Iterator Timeline<Octree, Type>::locate(const Type x, const Type y, const Type z) const
+{
+    return _octrees[0].locate(x, y, z);
+}
+
+// Nearest grid point interpolation
+/// \brief          Nearest grid point interpolation.
+/// \details        Interpolates the data at the provided position in both
+///                 octrees and then linearly in time.
+/// \tparam         Data Data type.
+/// \param[in]      x Position along the first dimension.
+/// \param[in]      y Position along the second dimension.
+/// \param[in]      z Position along the third dimension.
+/// \param[in]      t Time.
+/// \return         Interpolated data.
+template <class Octree, typename Type>
+template <class Data>
+inline Data Timeline<Octree, Type>::ngp(const Type x, const Type y, const Type z, const Type t) const
+{
+    return blend(_octrees[0].ngp(x, y, z), _octrees[1].ngp(x, y, z), weight(t));
+}
+
+// Cloud in cell interpolation
+/// \brief          Cloud in cell interpolation.
+/// \details        Interpolates the data at the provided position in both
+///                 octrees and then linearly in time.
+/// \tparam         Data Data type.
+/// \param[in]      x Position along the first dimension.
+/// \param[in]      y Position along the second dimension.
+/// \param[in]      z Position along the third dimension.
+/// \param[in]      t Time.
+/// \return         Interpolated data.
+template <class Octree, typename Type>
+template <class Data>
+inline Data Timeline<Octree, Type>::cic(const Type x, const Type y, const Type z, const Type t) const
+{
+    return blend(_octrees[0].cic(x, y, z), _octrees[1].cic(x, y, z), weight(t));
+}
+
+// Linear blending
+/// \brief          Linear blending.
+/// \details        Blends two data linearly. If one of them is empty,
+///                 because the position is not covered by one of the
+///                 snapshots, the other one is returned.
+/// \tparam         Data Data type.
+/// \param[in]      first Data at the lower time.
+/// \param[in]      second Data at the upper time.
+/// \param[in]      coefficient Weight of the second data.
+/// \return         Blended data.
+template <class Octree, typename Type>
+template <class Data>
+inline Data Timeline<Octree, Type>::blend(const Data& first, const Data& second, const Type coefficient)
+{
+    static const Data empty = Data();
+    Data result = Data();
+    if (first == empty) {
+        result = second;
+    } else if ((second == empty) || (!(coefficient > Type(0)))) {
+        result = first;
+    } else {
+        Octree::mac(result, first, Type(1)-coefficient);
+        Octree::mac(result, second, coefficient);
+    }
+    return result;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- PROPERTIES ------------------------------- //
+// Position
+/// \brief          Position.
+/// \details        Returns the position of the center of the octrees.
+/// \return         Position ratio.
+template <class Octree, typename Type>
+constexpr decltype(Octree::position()) Timeline<Octree, Type>::position()
+{
+    return Octree::position();
+}
+
+// Extent
+/// \brief          Extent.
+/// \details        Returns the extent of the octrees.
+/// \return         Extent ratio.
+template <class Octree, typename Type>
+constexpr decltype(Octree::extent()) Timeline<Octree, Type>::extent()
+{
+    return Octree::extent();
+}
+
+// Element
+/// \brief          Element.
+/// \details        Returns an element of the octrees.
+/// \return         Element.
+template <class Octree, typename Type>
+constexpr decltype(Octree::element()) Timeline<Octree, Type>::element()
+{
+    return Octree::element();
+}
+
+// Dimension
+/// \brief          Dimension.
+/// \details        Returns the number of space dimension of the octrees.
+/// \return         Number of space dimension.
+template <class Octree, typename Type>
+constexpr unsigned int Timeline<Octree, Type>::dimension()
+{
+    return Octree::dimension();
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Timeline.
+/// \return         0 if no error.
+template <class Octree, typename Type>
+int Timeline<Octree, Type>::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Timeline::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    typedef magrathea::SimpleHyperOctree<double, magrathea::SimpleHyperOctreeIndex<unsigned long long int, 3>, Gravity<float, 3> > Tree;
+    auto loader = [](Tree& tree, const unsigned int i){tree.assign(2, 0); std::for_each(tree.begin(), tree.end(), [=](decltype(Tree::element())& e){std::get<1>(e).phi() = i; std::get<1>(e).a() = 1;}); return double(i);};
+
+    // Construction
+    Timeline<Tree> timeline(4, loader);
+
+    // Lifecycle
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Lifecycle : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"Timeline<Tree>().size() : "                                                         <<Timeline<Tree>().size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"Timeline<Tree>(4, loader).size() : "                                                <<Timeline<Tree>(4, loader).size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"Timeline<Tree>(0, loader).start() : "                                               <<Timeline<Tree>(0, loader).start()<<std::endl;
+    std::cout<<std::setw(width*2)<<"Timeline<Tree>(0, loader).advance() : "                                             <<Timeline<Tree>(0, loader).advance()<<std::endl;
+
+    // Window
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Window : "                                                                          <<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.ready() : "                                                                <<timeline.ready()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.start() : "                                                                <<timeline.start()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.last() : "                                                                 <<timeline.last()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.snapshot() : "                                                             <<timeline.snapshot()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.lower() : "                                                                <<timeline.lower()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.upper() : "                                                                <<timeline.upper()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.weight(0.25) : "                                                           <<timeline.weight(0.25)<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.front().size() : "                                                         <<timeline.front().size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.back().size() : "                                                          <<timeline.back().size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.advance() : "                                                              <<timeline.advance()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.snapshot() : "                                                             <<timeline.snapshot()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.advance() : "                                                              <<timeline.advance()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.last() : "                                                                 <<timeline.last()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.advance() : "                                                              <<timeline.advance()<<std::endl;
+
+    // Octree
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Octree : "                                                                          <<std::endl;
+    std::cout<<std::setw(width*2)<<"std::get<0>(*timeline.locate(0.1, 0.2, 0.3)) : "                                    <<std::get<0>(*timeline.locate(0.1, 0.2, 0.3))<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.ngp(0.1, 0.2, 0.3, 2.25).phi() : "                                         <<timeline.ngp(0.1, 0.2, 0.3, 2.25).phi()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.cic(0.1, 0.2, 0.3, 2.5).phi() : "                                          <<timeline.cic(0.1, 0.2, 0.3, 2.5).phi()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.blend(Gravity<float, 3>(), Gravity<float, 3>(), 0.5) : "                  <<timeline.blend(Gravity<float, 3>(), Gravity<float, 3>(), 0.5)<<std::endl;
+
+    // Properties
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Properties : "                                                                      <<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.dimension() : "                                                            <<timeline.dimension()<<std::endl;
+    std::cout<<std::setw(width*2)<<"timeline.extent().num : "                                                           <<timeline.extent().num<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Timeline::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // TIMELINE_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
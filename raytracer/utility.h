@@ -30,12 +30,16 @@
 #include <utility>
 #include <thread>
 #include <vector>
+#include <memory>
 #include <algorithm>
+#include <functional>
+#include <cmath>
 // Include libs
 // Include project
 #include "../magrathea/hypercube.h"
 #include "../magrathea/hypersphere.h"
 #include "cone.h"
+#include "pool.h"
 // Misc
 // -------------------------------------------------------------------------- //
 
@@ -52,9 +56,15 @@ class Utility final
     /// \name           Parallelization
     //@{
     public:
+        static inline Pool& pool(const unsigned int nthreads = 0, const bool pin = false);
         template <int Default = 0, typename Type, class Function, class = typename std::enable_if<(std::is_convertible<decltype(std::declval<Type>()+std::declval<Type>()), int>::value) && (!std::is_function<typename std::result_of<Function(Type)>::type>::value)>::type> static double parallelize(const Type nsteps, Function&& function, const int nthreads = (Default != 0) ? (Default) : (std::thread::hardware_concurrency()));
         template <int Default = 0, typename Type, class Function, class = typename std::enable_if<(!std::is_void<decltype(std::declval<Type>()/std::declval<Type>())>::value) && (!std::is_function<typename std::result_of<Function(Type)>::type>::value)>::type> static double parallelize(const Type& first, const Type& last, const Type& increment, Function&& function, const int nthreads = (Default != 0) ? (Default) : (std::thread::hardware_concurrency()));
         template <int Default = 0, typename Iterator, class Function, class = typename std::enable_if<(!std::is_void<decltype(*std::declval<Iterator>())>::value) && (!std::is_function<typename std::result_of<Function(decltype(*std::declval<Iterator>()))>::type>::value)>::type> static double parallelize(const Iterator& first, const Iterator& last, Function&& function, const int nthreads = (Default != 0) ? (Default) : (std::thread::hardware_concurrency()));
+        template <int Default = 0, typename Type, class Function, class Timings = std::vector<std::pair<double, double> >, class = typename std::enable_if<(std::is_integral<Type>::value) && (!std::is_function<typename std::result_of<Function(Type)>::type>::value)>::type> static double schedule(const Type nsteps, Function&& function, Timings&& timings = Timings(), const Type grain = Type(1), const int nthreads = (Default != 0) ? (Default) : (std::thread::hardware_concurrency()));
+        template <int Default = 0, typename Iterator, typename Type = typename std::remove_cv<typename std::remove_reference<decltype(*std::declval<Iterator>())>::type>::type, class Function = std::plus<Type>, class = typename std::enable_if<std::is_convertible<typename std::result_of<Function(Type, typename std::remove_cv<typename std::remove_reference<decltype(*std::declval<Iterator>())>::type>::type)>::type, Type>::value>::type> static Type reduce(const Iterator& first, const Iterator& last, const Type& init = Type(), Function&& op = Function(), const int nthreads = (Default != 0) ? (Default) : (std::thread::hardware_concurrency()));
+        template <int Default = 0, typename Iterator, typename Output, typename Type = typename std::remove_cv<typename std::remove_reference<decltype(*std::declval<Iterator>())>::type>::type, class Function = std::plus<Type>, class = typename std::enable_if<std::is_convertible<typename std::result_of<Function(Type, typename std::remove_cv<typename std::remove_reference<decltype(*std::declval<Iterator>())>::type>::type)>::type, Type>::value>::type> static Type inclusive_scan(const Iterator& first, const Iterator& last, const Output& result, Function&& op = Function(), const int nthreads = (Default != 0) ? (Default) : (std::thread::hardware_concurrency()));
+        template <int Default = 0, typename Iterator, typename Output, typename Type = typename std::remove_cv<typename std::remove_reference<decltype(*std::declval<Iterator>())>::type>::type, class Function = std::plus<Type>, class = typename std::enable_if<std::is_convertible<typename std::result_of<Function(Type, typename std::remove_cv<typename std::remove_reference<decltype(*std::declval<Iterator>())>::type>::type)>::type, Type>::value>::type> static Type exclusive_scan(const Iterator& first, const Iterator& last, const Output& result, const Type& init = Type(), Function&& op = Function(), const int nthreads = (Default != 0) ? (Default) : (std::thread::hardware_concurrency()));
+        template <int Default = 0, typename Iterator, typename Type = typename std::remove_cv<typename std::remove_reference<decltype(*std::declval<Iterator>())>::type>::type, class = typename std::enable_if<std::is_integral<Type>::value>::type> static Type compact(const Iterator& first, const Iterator& last, const Type& offset = Type(), const int nthreads = (Default != 0) ? (Default) : (std::thread::hardware_concurrency()));
     //@}
     
     // Geometry
@@ -72,6 +82,8 @@ class Utility final
         template <unsigned int Dimension, class Vector, typename Scalar, typename Type = Scalar> static inline magrathea::HyperSphere<Dimension, Vector, Scalar> spherify(const magrathea::HyperCube<Dimension, Vector, Scalar>& hypercube, Type factor = Type(1));
         template <template <unsigned int, class, typename> class First, template <unsigned int, class, typename> class Second, unsigned int Dimension, class Vector, typename Scalar> static inline bool collide(const First<Dimension, Vector, Scalar>& first, const Second<Dimension, Vector, Scalar>& second);
         template <template <unsigned int, class, typename> class Object, unsigned int Dimension, class Vector, typename Scalar, class = typename std::enable_if<Dimension == 3>::type> static inline bool collide(const Object<Dimension, Vector, Scalar>& object, const Cone<Vector, Scalar>& cone);
+        template <template <unsigned int, class, typename> class First, template <unsigned int, class, typename> class Second, unsigned int Dimension, class Vector, typename Scalar> static inline int classify(const First<Dimension, Vector, Scalar>& first, const Second<Dimension, Vector, Scalar>& second);
+        template <template <unsigned int, class, typename> class Object, unsigned int Dimension, class Vector, typename Scalar, class = typename std::enable_if<Dimension == 3>::type> static inline int classify(const Object<Dimension, Vector, Scalar>& object, const Cone<Vector, Scalar>& cone);
     //@}
     
     // Interpolation
@@ -82,7 +94,20 @@ class Utility final
         template <typename Type, class Container, class = typename std::enable_if<std::is_convertible<Type, typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Container>()[0])>::type>::type>::value>::type> static inline Type interpolate(const Type x0, const Container& x, const Container& y, const Container& dydx);
         template <class Container, class... Containers, class = typename std::enable_if<sizeof...(Containers) == 2 || sizeof...(Containers) == 3>::type> static inline Container reinterpolate(const Container& x0, Containers&&... containers);
         template <int Direction = 0, typename Type, class Container, typename T = Type, class = typename std::enable_if<std::is_convertible<Type, typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Container>()[0])>::type>::type>::value>::type> static inline Type differentiate(const Type x0, const Container& x, const Container& y, const unsigned int neighbourhood = 1);
+        template <int Direction = 0, class Container, typename Type = typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Container>()[0])>::type>::type, typename T = Type, class = typename std::enable_if<std::is_convertible<Type, typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Container>()[0])>::type>::type>::value>::type> static inline Container differentiate(const Container& x0, const Container& x, const Container& y, const unsigned int neighbourhood = 1);
         template <int Derivative = 0, typename Type, class Container, typename T = Type, class = typename std::enable_if<(Derivative >= 0) && (Derivative <= 3) && (std::is_convertible<Type, typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Container>()[0])>::type>::type>::value)>::type> static inline Type filter(const Type x0, const Container& x, const Container& y, const unsigned int neighbourhood = 1);
+        template <int Derivative = 0, class Container, typename Type = typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Container>()[0])>::type>::type, typename T = Type, class = typename std::enable_if<(Derivative >= 0) && (Derivative <= 3) && (std::is_convertible<Type, typename std::remove_cv<typename std::remove_reference<decltype(std::declval<Container>()[0])>::type>::type>::value)>::type> static inline Container filter(const Container& x0, const Container& x, const Container& y, const unsigned int neighbourhood = 1);
+    //@}
+
+    // Stencils
+    /// \name           Stencils
+    //@{
+    protected:
+        template <class Container> static inline std::vector<long long int> locate(const Container& x0, const Container& x, const long long int n);
+        template <typename Type, class Container> static inline Type segment(const long long int i, const Type x0, const Container& x, const Container& y);
+        template <typename Type, class Container> static inline Type segment(const long long int i, const Type x0, const Container& x, const Container& y, const Container& dydx);
+        template <int Direction, typename Type, typename T, class Function> static inline Type fornberg(const Type h, Function&& values);
+        template <int Derivative, typename Type, typename T, class Function> static inline Type savitzky(const Type h, Function&& values);
     //@}
     
     // Evolution
@@ -107,10 +132,33 @@ class Utility final
 
 
 // ----------------------------- PARALLELIZATION ---------------------------- //
+// Process-wide pool of threads
+/// \brief          Process-wide pool of threads.
+/// \details        Returns the pool of threads shared by all the parallel
+///                 loops of the process. It is created with one thread per
+///                 core at first use. If a number of threads is provided and
+///                 differs from the current configuration, the pool is
+///                 replaced by a new one: this should only be done outside
+///                 of any parallel region, typically once at startup.
+/// \param[in]      nthreads Total concurrency, or zero to keep the current
+///                 pool.
+/// \param[in]      pin Pins the workers to distinct cores if true.
+/// \return         Reference to the pool.
+inline Pool& Utility::pool(const unsigned int nthreads, const bool pin)
+{
+    static std::unique_ptr<Pool> instance;
+    if ((!instance) || ((nthreads > 0) && ((instance->size() != nthreads) || (instance->pinned() != pin)))) {
+        instance.reset();
+        instance.reset(new Pool((nthreads > 0) ? (nthreads) : (std::max(1U, std::thread::hardware_concurrency())), pin));
+    }
+    return *instance;
+}
+
 // Parallelize a loop
 /// \brief          Parallelize a loop.
 /// \details        Executes the provided function on each index of the loop
-///                 using the specified number of threads. 
+///                 using the specified number of tasks, split in equal
+///                 static groups and run on the process-wide pool. 
 /// \tparam         Default Default concurrency where zero means hardware
 ///                 concurrency.
 /// \tparam         Type Loop index type.
@@ -126,16 +174,13 @@ double Utility::parallelize(const Type nsteps, Function&& function, const int nt
     const std::chrono::high_resolution_clock::time_point tbegin = std::chrono::high_resolution_clock::now();
     const Type ntasks = std::max(static_cast<int>(1), nthreads);
     const Type group = std::max(Type(nsteps > zero), nsteps/ntasks);
-    std::vector<std::thread> threads;
-    Type istep = zero;
-    threads.reserve(ntasks);
-    for (istep = zero; istep < nsteps-group; istep += group) {
-        threads.push_back(std::thread([=, &nsteps, &group, &function](){for (Type i = istep; i < std::min(istep+group, nsteps); ++i) function(i);}));
+    const Type ngroups = (nsteps > group) ? ((nsteps-Type(1))/group) : (zero);
+    auto task = [=, &nsteps, &group, &ngroups, &function](const unsigned int igroup){for (Type i = Type(igroup)*group; i < ((Type(igroup) < ngroups) ? (Type(igroup+1)*group) : (nsteps)); ++i) function(i);};
+    if (ngroups > zero) {
+        pool().execute(ngroups+1, task);
+    } else {
+        task(0);
     }
-    for (istep = istep; istep < nsteps; ++istep) {
-        function(istep);
-    }
-    std::for_each(threads.begin(), threads.end(), [](std::thread& current){current.join();});
     return std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::high_resolution_clock::now()-tbegin).count();
 }
 
@@ -143,7 +188,7 @@ double Utility::parallelize(const Type nsteps, Function&& function, const int nt
 /// \brief          Parallelize an iteration over a range of values.
 /// \details        Executes the provided function on each values of the range
 ///                 using the provided increment and the specified number of 
-///                 threads.
+///                 tasks, run on the process-wide pool.
 /// \tparam         Default Default concurrency where zero means hardware
 ///                 concurrency.
 /// \tparam         Type Value type.
@@ -162,23 +207,21 @@ double Utility::parallelize(const Type& first, const Type& last, const Type& inc
     const long long int nsteps = (last-first)/increment;
     const long long int size = nsteps+((first < last) ? ((first+Type(nsteps)*increment) < last) : (((first+Type(nsteps))*increment) > last));
     const long long int group = std::max(static_cast<long long int>(size > 0), size/ntasks);
-    std::vector<std::thread> threads;
-    long long int ivalue = 0;
-    threads.reserve(ntasks);
-    for (ivalue = 0; ivalue < size-group; ivalue += group) {
-        threads.push_back(std::thread([=, &first, &increment, &size, &group, &function](){for (long long int i = ivalue; i < std::min(ivalue+group, size); ++i) function(first+Type(i)*increment);}));
-    }
-    for (; ivalue < size; ++ivalue) {
-        function(first+Type(ivalue)*increment);
+    const long long int ngroups = (size > group) ? ((size-1)/group) : (0);
+    auto task = [=, &first, &increment, &size, &group, &ngroups, &function](const unsigned int igroup){for (long long int i = igroup*group; i < ((igroup < ngroups) ? ((igroup+1)*group) : (size)); ++i) function(first+Type(i)*increment);};
+    if (ngroups > 0) {
+        pool().execute(ngroups+1, task);
+    } else {
+        task(0);
     }
-    std::for_each(threads.begin(), threads.end(), [](std::thread& current){current.join();});
     return std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::high_resolution_clock::now()-tbegin).count();
 }
 
 // Parallelize an iteration over a range of iterators
 /// \brief          Parallelize an iteration over a range of iterators.
 /// \details        Executes the provided function on each element of the 
-///                 iterator range using the specified number of threads. 
+///                 iterator range using the specified number of tasks, run
+///                 on the process-wide pool. 
 /// \tparam         Default Default concurrency where zero means hardware
 ///                 concurrency.
 /// \tparam         Iterator Iterator type.
@@ -193,17 +236,214 @@ double Utility::parallelize(const Iterator& first, const Iterator& last, Functio
 {
     const std::chrono::high_resolution_clock::time_point tbegin = std::chrono::high_resolution_clock::now();
     const long long int ntasks = std::max(static_cast<int>(1), nthreads);
+    const long long int size = last-first;
     const long long int group = std::max(static_cast<long long int>(first < last), static_cast<long long int>((last-first)/ntasks));
-    std::vector<std::thread> threads;
-    Iterator it = first;
-    threads.reserve(ntasks);
-    for (it = first; it < last-group; it += group) {
-        threads.push_back(std::thread([=, &last, &group, &function](){std::for_each(it, std::min(it+group, last), function);}));
+    const long long int ngroups = (size > group) ? ((size-1)/group) : (0);
+    auto task = [=, &first, &size, &group, &ngroups, &function](const unsigned int igroup){std::for_each(first+igroup*group, (igroup < ngroups) ? (first+(igroup+1)*group) : (first+size), function);};
+    if (ngroups > 0) {
+        pool().execute(ngroups+1, task);
+    } else {
+        task(0);
     }
-    std::for_each(it, last, function);
-    std::for_each(threads.begin(), threads.end(), [](std::thread& current){current.join();});
     return std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::high_resolution_clock::now()-tbegin).count();
 }
+
+// Schedule a loop dynamically
+/// \brief          Schedule a loop dynamically.
+/// \details        Executes the provided function on each index of the loop
+///                 using the specified number of threads. Contrary to
+///                 parallelize, indices are not split in equal static groups:
+///                 each thread claims chunks of decreasing size from a shared
+///                 counter until the loop is exhausted, so that threads
+///                 handling cheap iterations take over the remaining ones.
+///                 The busy and idle times of each thread are written in 
+///                 the timings container. The loop is forwarded to the
+///                 scheduler of the process-wide pool.
+/// \tparam         Default Default concurrency where zero means hardware
+///                 concurrency.
+/// \tparam         Type Loop index type.
+/// \tparam         Function Function type taking a loop index as argument.
+/// \tparam         Timings Container of pairs of busy and idle times.
+/// \param[in]      nsteps Total number of steps.
+/// \param[in]      function Function.
+/// \param[out]     timings Busy and idle times in seconds for each thread.
+/// \param[in]      grain Minimal number of indices claimed at once.
+/// \param[in]      nthreads Number of threads.
+/// \return         Elapsed time in seconds.
+template <int Default, typename Type, class Function, class Timings, class>
+double Utility::schedule(const Type nsteps, Function&& function, Timings&& timings, const Type grain, const int nthreads)
+{
+    return pool().schedule(nsteps, std::forward<Function>(function), std::forward<Timings>(timings), grain, std::max(static_cast<int>(1), nthreads));
+}
+
+// Parallel reduction
+/// \brief          Parallel reduction.
+/// \details        Combines the elements of the range with the provided
+///                 associative operator. Each task reduces one static group
+///                 on the process-wide pool, and the partial results are
+///                 combined in order, so that the operator does not need to 
+///                 be commutative.
+/// \tparam         Default Default concurrency where zero means hardware
+///                 concurrency.
+/// \tparam         Iterator Random access iterator type.
+/// \tparam         Type Result type.
+/// \tparam         Function Binary associative operator type.
+/// \param[in]      first First iterator.
+/// \param[in]      last Last iterator.
+/// \param[in]      init Initial value.
+/// \param[in]      op Binary associative operator.
+/// \param[in]      nthreads Number of threads.
+/// \return         Reduction of the initial value and of the range.
+template <int Default, typename Iterator, typename Type, class Function, class>
+Type Utility::reduce(const Iterator& first, const Iterator& last, const Type& init, Function&& op, const int nthreads)
+{
+    const long long int ntasks = std::max(static_cast<int>(1), nthreads);
+    const long long int size = std::max(static_cast<long long int>(0), static_cast<long long int>(last-first));
+    const long long int group = std::max(static_cast<long long int>(size > 0), size/ntasks);
+    const long long int ngroups = (size > group) ? ((size-1)/group) : (0);
+    std::vector<Type> partial(ngroups+1, init);
+    Type result = init;
+    auto task = [=, &first, &size, &group, &ngroups, &op, &partial](const unsigned int igroup){Type value = *(first+igroup*group); for (Iterator it = first+igroup*group+1; it < ((igroup < ngroups) ? (first+(igroup+1)*group) : (first+size)); ++it) value = op(value, *it); partial[igroup] = value;};
+    if (ngroups > 0) {
+        pool().execute(ngroups+1, task);
+    } else if (size > 0) {
+        task(0);
+    }
+    for (long long int igroup = 0; (size > 0) && (igroup <= ngroups); ++igroup) {
+        result = op(result, partial[igroup]);
+    }
+    return result;
+}
+
+// Parallel inclusive scan
+/// \brief          Parallel inclusive scan.
+/// \details        Writes in the output range the prefix reductions of the
+///                 input range, each element being included in its own 
+///                 prefix. The range is split in static groups: each task 
+///                 reduces its group, the totals of the groups are scanned 
+///                 serially, and each task finally rescans its group from 
+///                 the total of the preceding ones. The output may be the 
+///                 input itself.
+/// \tparam         Default Default concurrency where zero means hardware
+///                 concurrency.
+/// \tparam         Iterator Random access iterator type.
+/// \tparam         Output Random access output iterator type.
+/// \tparam         Type Result type.
+/// \tparam         Function Binary associative operator type.
+/// \param[in]      first First iterator.
+/// \param[in]      last Last iterator.
+/// \param[out]     result Beginning of the output range.
+/// \param[in]      op Binary associative operator.
+/// \param[in]      nthreads Number of threads.
+/// \return         Reduction of the whole range.
+template <int Default, typename Iterator, typename Output, typename Type, class Function, class>
+Type Utility::inclusive_scan(const Iterator& first, const Iterator& last, const Output& result, Function&& op, const int nthreads)
+{
+    const long long int ntasks = std::max(static_cast<int>(1), nthreads);
+    const long long int size = std::max(static_cast<long long int>(0), static_cast<long long int>(last-first));
+    const long long int group = std::max(static_cast<long long int>(size > 0), size/ntasks);
+    const long long int ngroups = (size > group) ? ((size-1)/group) : (0);
+    std::vector<Type> partial(ngroups+1);
+    auto local = [=, &first, &size, &group, &ngroups, &op, &partial](const unsigned int igroup){Type value = *(first+igroup*group); for (Iterator it = first+igroup*group+1; it < ((igroup < ngroups) ? (first+(igroup+1)*group) : (first+size)); ++it) value = op(value, *it); partial[igroup] = value;};
+    auto task = [=, &first, &result, &size, &group, &ngroups, &op, &partial](const unsigned int igroup){Type value = (igroup > 0) ? (op(partial[igroup-1], *(first+igroup*group))) : (Type(*first)); *(result+igroup*group) = value; for (long long int i = igroup*group+1; i < ((igroup < ngroups) ? ((igroup+1)*group) : (size)); ++i) {value = op(value, *(first+i)); *(result+i) = value;}};
+    if (ngroups > 0) {
+        pool().execute(ngroups+1, local);
+        for (long long int igroup = 1; igroup <= ngroups; ++igroup) {
+            partial[igroup] = op(partial[igroup-1], partial[igroup]);
+        }
+        pool().execute(ngroups+1, task);
+    } else if (size > 0) {
+        task(0);
+        partial[0] = *(result+size-1);
+    }
+    return (size > 0) ? (partial[ngroups]) : (Type());
+}
+
+// Parallel exclusive scan
+/// \brief          Parallel exclusive scan.
+/// \details        Writes in the output range the prefix reductions of the
+///                 input range starting from the initial value, each element
+///                 being excluded from its own prefix. The range is split in
+///                 static groups as for the inclusive scan. The output may
+///                 be the input itself.
+/// \tparam         Default Default concurrency where zero means hardware
+///                 concurrency.
+/// \tparam         Iterator Random access iterator type.
+/// \tparam         Output Random access output iterator type.
+/// \tparam         Type Result type.
+/// \tparam         Function Binary associative operator type.
+/// \param[in]      first First iterator.
+/// \param[in]      last Last iterator.
+/// \param[out]     result Beginning of the output range.
+/// \param[in]      init Initial value.
+/// \param[in]      op Binary associative operator.
+/// \param[in]      nthreads Number of threads.
+/// \return         Reduction of the initial value and of the whole range.
+template <int Default, typename Iterator, typename Output, typename Type, class Function, class>
+Type Utility::exclusive_scan(const Iterator& first, const Iterator& last, const Output& result, const Type& init, Function&& op, const int nthreads)
+{
+    const long long int ntasks = std::max(static_cast<int>(1), nthreads);
+    const long long int size = std::max(static_cast<long long int>(0), static_cast<long long int>(last-first));
+    const long long int group = std::max(static_cast<long long int>(size > 0), size/ntasks);
+    const long long int ngroups = (size > group) ? ((size-1)/group) : (0);
+    std::vector<Type> partial(ngroups+2, init);
+    Type total = init;
+    auto local = [=, &first, &size, &group, &ngroups, &op, &partial](const unsigned int igroup){Type value = *(first+igroup*group); for (Iterator it = first+igroup*group+1; it < ((igroup < ngroups) ? (first+(igroup+1)*group) : (first+size)); ++it) value = op(value, *it); partial[igroup+1] = value;};
+    auto task = [=, &first, &result, &size, &group, &ngroups, &op, &partial, &total](const unsigned int igroup){Type value = partial[igroup]; Type current = Type(); for (long long int i = igroup*group; i < ((igroup < ngroups) ? ((igroup+1)*group) : (size)); ++i) {current = *(first+i); *(result+i) = value; value = op(value, current);} if (igroup == ngroups) total = value;};
+    if (ngroups > 0) {
+        pool().execute(ngroups+1, local);
+        for (long long int igroup = 1; igroup <= ngroups; ++igroup) {
+            partial[igroup] = op(partial[igroup-1], partial[igroup]);
+        }
+        pool().execute(ngroups+1, task);
+    } else if (size > 0) {
+        task(0);
+    }
+    return total;
+}
+
+// Parallel stream compaction
+/// \brief          Parallel stream compaction.
+/// \details        Replaces in place each non-zero flag of the range by the
+///                 one-based rank of its element among the selected ones,
+///                 shifted by the offset, and leaves the zeros unchanged.
+///                 Selected elements can then be scattered in parallel at 
+///                 position <tt>flag-1</tt> of a destination resized to the
+///                 offset plus the returned count. Each task counts the
+///                 selected elements of its static group, and ranks them
+///                 again once the counts of the preceding groups are known.
+/// \tparam         Default Default concurrency where zero means hardware
+///                 concurrency.
+/// \tparam         Iterator Random access iterator type.
+/// \tparam         Type Integral flag type.
+/// \param[in,out]  first First iterator.
+/// \param[in,out]  last Last iterator.
+/// \param[in]      offset Offset added to the ranks.
+/// \param[in]      nthreads Number of threads.
+/// \return         Number of selected elements.
+template <int Default, typename Iterator, typename Type, class>
+Type Utility::compact(const Iterator& first, const Iterator& last, const Type& offset, const int nthreads)
+{
+    static const Type zero = Type();
+    const long long int ntasks = std::max(static_cast<int>(1), nthreads);
+    const long long int size = std::max(static_cast<long long int>(0), static_cast<long long int>(last-first));
+    const long long int group = std::max(static_cast<long long int>(size > 0), size/ntasks);
+    const long long int ngroups = (size > group) ? ((size-1)/group) : (0);
+    std::vector<Type> partial(ngroups+2, zero);
+    Type total = zero;
+    auto local = [=, &first, &size, &group, &ngroups, &partial](const unsigned int igroup){Type value = zero; for (Iterator it = first+igroup*group; it < ((igroup < ngroups) ? (first+(igroup+1)*group) : (first+size)); ++it) value += (*it != zero); partial[igroup+1] = value;};
+    auto task = [=, &first, &size, &group, &ngroups, &partial, &total](const unsigned int igroup){Type value = offset+partial[igroup]; for (Iterator it = first+igroup*group; it < ((igroup < ngroups) ? (first+(igroup+1)*group) : (first+size)); ++it) *it = (*it != zero) ? (++value) : (zero); if (igroup == ngroups) total = value-offset;};
+    if (ngroups > 0) {
+        pool().execute(ngroups+1, local);
+        for (long long int igroup = 1; igroup <= ngroups; ++igroup) {
+            partial[igroup] += partial[igroup-1];
+        }
+        pool().execute(ngroups+1, task);
+    } else if (size > 0) {
+        task(0);
+    }
+    return total;
+}
 // -------------------------------------------------------------------------- //
 
 
@@ -390,7 +630,8 @@ inline bool Utility::collide(const First<Dimension, Vector, Scalar>& first, cons
 // Collision between an hyperobject and a cone
 /// \brief          Collision between an hyperobject and a cone.
 /// \details        Detects collision between a geometrical object and a three
-///                 dimensional cone.
+///                 dimensional cone. Objects straddling the vertex are 
+///                 considered as colliding.
 /// \tparam         Object Object type.
 /// \tparam         Dimension Number of space dimension.
 /// \tparam         Vector Position vector type.
@@ -411,7 +652,62 @@ inline bool Utility::collide(const Object<Dimension, Vector, Scalar>& object, co
     for (unsigned int idim = 0; idim < Dimension; ++idim) {
         distance += cone.template pow<2>(object.position(idim)-(cone.vertex(idim)+(cone.base(idim)-cone.vertex(idim))*(length/norm))); 
     }
-    return ((std::sqrt(distance) < radius(object)+length*std::tan(cone.angle())) && !(length < Scalar()) && (length < norm+radius(object)*Scalar(2)));
+    return ((std::sqrt(distance) < radius(object)+std::max(length, Scalar())*std::tan(cone.angle())) && !(length < -radius(object)) && (length < norm+radius(object)*Scalar(2)));
+}
+
+// Classification of an hyperobject relatively to another one
+/// \brief          Classification of an hyperobject relatively to another one.
+/// \details        Classifies all the hyperspheres contained in the first
+///                 object, including itself, relatively to the second one,
+///                 with the same criterion as the collision. 
+/// \tparam         First First object type.
+/// \tparam         Second Second object type.
+/// \tparam         Dimension Number of space dimension.
+/// \tparam         Vector Position vector type.
+/// \tparam         Scalar Scalar data type.
+/// \param[in]      first First object.
+/// \param[in]      second Second object.
+/// \return         One if all of them collide, minus one if none of them 
+///                 collide, zero otherwise.
+template <template <unsigned int, class, typename> class First, template <unsigned int, class, typename> class Second, unsigned int Dimension, class Vector, typename Scalar>
+inline int Utility::classify(const First<Dimension, Vector, Scalar>& first, const Second<Dimension, Vector, Scalar>& second)
+{
+    const Scalar distance = Utility::distance<Dimension>(first.position(), second.position());
+    return (distance+radius(first) < radius(second))-!(distance < radius(first)+radius(second));
+}
+
+// Classification of an hyperobject relatively to a cone
+/// \brief          Classification of an hyperobject relatively to a cone.
+/// \details        Classifies all the hyperspheres contained in the object,
+///                 including itself, relatively to a three dimensional 
+///                 cone, with the same criterion as the collision. As the
+///                 radius of the cone grows with the length, the criteria
+///                 are evaluated for the worst contained hypersphere.
+/// \tparam         Object Object type.
+/// \tparam         Dimension Number of space dimension.
+/// \tparam         Vector Position vector type.
+/// \tparam         Scalar Scalar data type.
+/// \param[in]      object Geometrical object.
+/// \param[in]      cone Three dimensional cone.
+/// \return         One if all of them collide, minus one if none of them 
+///                 collide, zero otherwise.
+template <template <unsigned int, class, typename> class Object, unsigned int Dimension, class Vector, typename Scalar, class>
+inline int Utility::classify(const Object<Dimension, Vector, Scalar>& object, const Cone<Vector, Scalar>& cone)
+{
+    const Scalar norm = cone.length();
+    const Scalar tangent = std::tan(cone.angle());
+    const Scalar extent = radius(object);
+    Scalar length = Scalar();
+    Scalar distance = Scalar();
+    for (unsigned int idim = 0; idim < Dimension; ++idim) {
+        length += (cone.base(idim)-cone.vertex(idim))*(object.position(idim)-cone.vertex(idim));
+    }
+    length /= norm;
+    for (unsigned int idim = 0; idim < Dimension; ++idim) {
+        distance += cone.template pow<2>(object.position(idim)-(cone.vertex(idim)+(cone.base(idim)-cone.vertex(idim))*(length/norm))); 
+    }
+    distance = std::sqrt(distance);
+    return ((!(length < extent)) && (length+extent < norm) && (distance+extent < (length-extent)*tangent))-((!(distance < extent+(std::max(length, Scalar())+extent)*tangent)) || (length < -extent) || (!(length < norm+extent*Scalar(2))));
 }
 // -------------------------------------------------------------------------- //
 
@@ -434,7 +730,7 @@ inline Type Utility::interpolate(const Type x0, const Container& x, const Contai
     const long long int n = std::min(x.size(), y.size());
     long long int i = std::distance(std::begin(x), std::upper_bound(std::begin(x), std::begin(x)+n, x0, [](const Type x1, const Type x2){return x1 < x2;}));
     i += (n > 1)*((i <= 0)-(i >= n));
-    return (n > 1) ? (y[i-1]+((y[i]-y[i-1])*(x0-x[i-1])/(x[i]-x[i-1]))) : ((n > 0) ? (y[0]) : (zero));
+    return (n > 1) ? (segment(i, x0, x, y)) : ((n > 0) ? (y[0]) : (zero));
 }
 
 // Cubic spline interpolation
@@ -451,18 +747,20 @@ inline Type Utility::interpolate(const Type x0, const Container& x, const Contai
 template <typename Type, class Container, class> 
 inline Type Utility::interpolate(const Type x0, const Container& x, const Container& y, const Container& dydx)
 {
-    static const Type one = Type(1);
+    static const Type zero = Type();
     const long long int n = std::min(x.size(), y.size());
     long long int i = std::distance(std::begin(x), std::upper_bound(std::begin(x), std::begin(x)+n, x0, [](const Type x1, const Type x2){return x1 < x2;}));
-    Type t = one;
     i += (n > 1)*((i <= 0)-(i >= n));
-    t = (n > 1) ? ((x0-x[i-1])/(x[i]-x[i-1])) : (one-one);
-    return (n > 1) ? (one-t)*y[i-1]+t*y[i]+t*(one-t)*((dydx[i-1]*(x[i]-x[i-1])-(y[i]-y[i-1]))*(one-t)+(-dydx[i]*(x[i]-x[i-1])+(y[i]-y[i-1]))*t) : ((n > 0) ? (y[0]) : (one-one));
+    return (n > 1) ? (segment(i, x0, x, y, dydx)) : ((n > 0) ? (y[0]) : (zero));
 }
 
 // Container reinterpolation
 /// \brief          Container reinterpolation.
-/// \details        Interpolates each value of the container.
+/// \details        Interpolates each value of the container. The segments
+///                 of all the values are located at once, with a single 
+///                 merge walk when both the interpolation abscissae and the
+///                 abscissae are sorted, and all the values are then 
+///                 evaluated in one pass.
 /// \tparam         Container Container type.
 /// \tparam         Containers Containers types.
 /// \param[in]      x0 Interpolation abscissae.
@@ -472,9 +770,19 @@ template <class Container, class... Containers, class>
 inline Container Utility::reinterpolate(const Container& x0, Containers&&... containers)
 {
     const long long int n = std::distance(std::begin(x0), std::end(x0));
+    const auto& x = std::get<0>(std::forward_as_tuple(containers...));
+    const auto& y = std::get<1>(std::forward_as_tuple(containers...));
+    const long long int m = std::min(x.size(), y.size());
+    const std::vector<long long int> index = (m > 1) ? (locate(x0, x, m)) : (std::vector<long long int>());
     Container result = x0;
-    for (long long int i = 0; i < n; ++i) {
-        result[i] = interpolate(x0[i], std::forward<Containers>(containers)...);
+    if (m > 1) {
+        for (long long int i = 0; i < n; ++i) {
+            result[i] = segment(index[i], x0[i], std::forward<Containers>(containers)...);
+        }
+    } else {
+        for (long long int i = 0; i < n; ++i) {
+            result[i] = interpolate(x0[i], std::forward<Containers>(containers)...);
+        }
     }
     return result;
 }
@@ -498,28 +806,47 @@ template <int Direction, typename Type, class Container, typename T, class>
 inline Type Utility::differentiate(const Type x0, const Container& x, const Container& y, const unsigned int neighbourhood)
 {
     static const unsigned int one = 1;
-    static const unsigned int size = 9;
-    static const std::array<Type, size> centered({{T(1)/T(280), T(-4)/T(105), T(1)/T(5), T(-4)/T(5), T(0), T(4)/T(5), T(-1)/T(5), T(4)/T(105), T(-1)/T(280)}});
-    static const std::array<Type, size> forward({{T(-761)/T(280), T(8), T(-14), T(56)/T(3), T(-35)/T(2), T(56)/T(5), T(-14)/T(3), T(8)/T(7), T(-1)/T(8)}});
-    static const std::array<Type, size> backward({{T(761)/T(280), T(-8), T(14), T(-56)/T(3), T(35)/T(2), T(-56)/T(5), T(14)/T(3), T(-8)/T(7), T(1)/T(8)}});
     const long long int n = std::min(x.size(), y.size());
     const long long int i = std::distance(std::begin(x), std::upper_bound(std::begin(x), std::begin(x)+n, x0, [](const Type x1, const Type x2){return x1 < x2;}));
     const long long int j = i+((n > 1)*((i <= 0)-(i >= n)));
     const Type h = (n > 1) ? ((x[j]-x[j-1])*std::max(one, neighbourhood)) : (Type());
-    Type result = Type();
-    if (n > 1) {
-        if (Direction == 0) {
-            for (unsigned int k = 0; k < size/2; ++k) {
-                result += centered[k]*interpolate(x0-(size/2-k)*h, x, y)+centered[size-(k+1)]*interpolate(x0+(size/2-k)*h, x, y);
-            }
-            result += centered[size/2]*interpolate(x0, x, y);
-        } else {
-            for (unsigned int k = 0; k < size; ++k) {
-                result += (Direction > 0) ? (forward[size-(k+1)]*interpolate(x0+(size-(k+1))*h, x, y)) : (backward[size-(k+1)]*interpolate(x0-(size-(k+1))*h, x, y));
-            }
-        }
-    }
-    return result/h;
+    return fornberg<Direction, Type, T>(h, [=, &x, &y, &h](const int k){return (n > 1) ? (interpolate(x0+Type(k)*h, x, y)) : (Type());});
+}
+
+// Fornberg differentiation of a container
+/// \brief          Fornberg differentiation of a container.
+/// \details        Computes the values of the derivative at all the given
+///                 positions, with the same results as the differentiation
+///                 of each position. Instead of nine searches per position,
+///                 the stencil points of each of the nine offsets are 
+///                 reinterpolated at once, and the coefficients are then
+///                 applied to the resampled series.
+/// \tparam         Direction Sign for centered, backward or forward 
+///                 differentiation.
+/// \tparam         Container Container type.
+/// \tparam         Type Data type.
+/// \tparam         T Conversion type.
+/// \param[in]      x0 Differentiation abscissae.
+/// \param[in]      x Abscissae.
+/// \param[in]      y Ordinates.
+/// \param[in]      neighbourhood Computing distance.
+/// \return         Derivatives at the provided abscissae.
+template <int Direction, class Container, typename Type, typename T, class>
+inline Container Utility::differentiate(const Container& x0, const Container& x, const Container& y, const unsigned int neighbourhood)
+{
+    static const unsigned int one = 1;
+    static const unsigned int nstencil = 9;
+    static const int offset = (Direction == 0) ? (-static_cast<int>(nstencil/2)) : ((Direction > 0) ? (0) : (-static_cast<int>(nstencil-1)));
+    const long long int size = std::distance(std::begin(x0), std::end(x0));
+    const long long int n = std::min(x.size(), y.size());
+    const std::vector<long long int> index = (n > 1) ? (locate(x0, x, n)) : (std::vector<long long int>());
+    std::vector<Type> h(size, Type());
+    std::array<Container, nstencil> values;
+    Container result = x0;
+    parallelize(size*(n > 1), [=, &x, &index, &h](const unsigned int i){h[i] = (x[index[i]]-x[index[i]-1])*std::max(one, neighbourhood);});
+    parallelize(nstencil*(n > 1), [=, &x0, &x, &y, &h, &values](const unsigned int k){values[k] = x0; for (long long int i = 0; i < size; ++i) values[k][i] = x0[i]+Type(offset+static_cast<int>(k))*h[i]; values[k] = reinterpolate(values[k], x, y);});
+    parallelize(size, [=, &h, &values, &result](const unsigned int i){result[i] = fornberg<Direction, Type, T>(h[i], [=, &values](const int k){return (n > 1) ? (values[k-offset][i]) : (Type());});});
+    return result;
 }
 
 // Savitzky-Golay filter
@@ -541,24 +868,189 @@ template <int Derivative, typename Type, class Container, typename T, class>
 inline Type Utility::filter(const Type x0, const Container& x, const Container& y, const unsigned int neighbourhood)
 {
     static const unsigned int one = 1;
-    static const unsigned int order = 4;
+    const long long int n = std::min(x.size(), y.size());
+    const long long int i = std::distance(std::begin(x), std::upper_bound(std::begin(x), std::begin(x)+n, x0, [](const Type x1, const Type x2){return x1 < x2;}));
+    const long long int j = i+((n > 1)*((i <= 0)-(i >= n)));
+    const Type h = (n > 1) ? ((x[j]-x[j-1])*std::max(one, neighbourhood)) : (Type());
+    return savitzky<Derivative, Type, T>(h, [=, &x, &y, &h](const int k){return (n > 1) ? (interpolate(x0+Type(k)*h, x, y)) : (Type());});
+}
+
+// Savitzky-Golay filter of a container
+/// \brief          Savitzky-Golay filter of a container.
+/// \details        Computes the smoothed values of the n-th derivative at all
+///                 the given positions, with the same results as the 
+///                 filtering of each position. The stencil points of each 
+///                 of the nine offsets are reinterpolated at once, and the 
+///                 coefficients are then applied to the resampled series.
+/// \tparam         Derivative Order of the derivative.
+/// \tparam         Container Container type.
+/// \tparam         Type Data type.
+/// \tparam         T Conversion type.
+/// \param[in]      x0 Differentiation abscissae.
+/// \param[in]      x Abscissae.
+/// \param[in]      y Ordinates.
+/// \param[in]      neighbourhood Computing distance.
+/// \return         Filtered derivatives at the provided abscissae.
+template <int Derivative, class Container, typename Type, typename T, class> 
+inline Container Utility::filter(const Container& x0, const Container& x, const Container& y, const unsigned int neighbourhood)
+{
+    static const unsigned int one = 1;
+    static const unsigned int nstencil = 9;
+    static const int offset = -static_cast<int>(nstencil/2);
+    const long long int size = std::distance(std::begin(x0), std::end(x0));
+    const long long int n = std::min(x.size(), y.size());
+    const std::vector<long long int> index = (n > 1) ? (locate(x0, x, n)) : (std::vector<long long int>());
+    std::vector<Type> h(size, Type());
+    std::array<Container, nstencil> values;
+    Container result = x0;
+    parallelize(size*(n > 1), [=, &x, &index, &h](const unsigned int i){h[i] = (x[index[i]]-x[index[i]-1])*std::max(one, neighbourhood);});
+    parallelize(nstencil*(n > 1), [=, &x0, &x, &y, &h, &values](const unsigned int k){values[k] = x0; for (long long int i = 0; i < size; ++i) values[k][i] = x0[i]+Type(offset+static_cast<int>(k))*h[i]; values[k] = reinterpolate(values[k], x, y);});
+    parallelize(size, [=, &h, &values, &result](const unsigned int i){result[i] = savitzky<Derivative, Type, T>(h[i], [=, &values](const int k){return (n > 1) ? (values[k-offset][i]) : (Type());});});
+    return result;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// -------------------------------- STENCILS -------------------------------- //
+// Segment location
+/// \brief          Segment location.
+/// \details        Finds, for each interpolation abscissa, the index of the
+///                 end of the segment used to interpolate it, as the first 
+///                 abscissa greater than the value clamped to the valid 
+///                 segments. When both ranges are sorted, all the indices
+///                 are found by a single merge walk, otherwise a binary 
+///                 search is done for each value.
+/// \tparam         Container Container type.
+/// \param[in]      x0 Interpolation abscissae.
+/// \param[in]      x Abscissae.
+/// \param[in]      n Number of abscissae to be considered, greater than one.
+/// \return         Segment indices, between one and the number of abscissae
+///                 minus one.
+template <class Container> 
+inline std::vector<long long int> Utility::locate(const Container& x0, const Container& x, const long long int n)
+{
+    typedef typename std::remove_cv<typename std::remove_reference<decltype(x0[0])>::type>::type Type;
+    const long long int size = std::distance(std::begin(x0), std::end(x0));
+    const bool sorted = (std::is_sorted(std::begin(x0), std::end(x0))) && (std::is_sorted(std::begin(x), std::begin(x)+n));
+    std::vector<long long int> index(size);
+    if (sorted) {
+        for (long long int i = 0, j = 1; i < size; ++i) {
+            for (; (j < n-1) && (!(x0[i] < x[j])); ++j) {
+                ;
+            }
+            index[i] = j;
+        }
+    } else {
+        for (long long int i = 0; i < size; ++i) {
+            index[i] = std::distance(std::begin(x), std::upper_bound(std::begin(x), std::begin(x)+n, x0[i], [](const Type x1, const Type x2){return x1 < x2;}));
+            index[i] += (index[i] <= 0)-(index[i] >= n);
+        }
+    }
+    return index;
+}
+
+// Linear segment interpolation
+/// \brief          Linear segment interpolation.
+/// \details        Interpolates the value at the given position linearly on
+///                 the segment ending at the provided index.
+/// \tparam         Type Data type.
+/// \tparam         Container Container type.
+/// \param[in]      i Index of the end of the segment, between one and the
+///                 number of abscissae minus one.
+/// \param[in]      x0 Interpolation abscissa.
+/// \param[in]      x Abscissae.
+/// \param[in]      y Ordinates.
+/// \return         Interpolated ordinate.
+template <typename Type, class Container> 
+inline Type Utility::segment(const long long int i, const Type x0, const Container& x, const Container& y)
+{
+    return y[i-1]+((y[i]-y[i-1])*(x0-x[i-1])/(x[i]-x[i-1]));
+}
+
+// Cubic segment interpolation
+/// \brief          Cubic segment interpolation.
+/// \details        Interpolates the value at the given position using a cubic
+///                 spline with the specified derivative on the segment ending
+///                 at the provided index.
+/// \tparam         Type Data type.
+/// \tparam         Container Container type.
+/// \param[in]      i Index of the end of the segment, between one and the
+///                 number of abscissae minus one.
+/// \param[in]      x0 Interpolation abscissa.
+/// \param[in]      x Abscissae.
+/// \param[in]      y Ordinates.
+/// \param[in]      dydx Derivatives.
+/// \return         Interpolated ordinate.
+template <typename Type, class Container> 
+inline Type Utility::segment(const long long int i, const Type x0, const Container& x, const Container& y, const Container& dydx)
+{
+    static const Type one = Type(1);
+    const Type t = (x0-x[i-1])/(x[i]-x[i-1]);
+    return (one-t)*y[i-1]+t*y[i]+t*(one-t)*((dydx[i-1]*(x[i]-x[i-1])-(y[i]-y[i-1]))*(one-t)+(-dydx[i]*(x[i]-x[i-1])+(y[i]-y[i-1]))*t);
+}
+
+// Fornberg stencil
+/// \brief          Fornberg stencil.
+/// \details        Combines the values at the nine stencil points with the 
+///                 coefficients of a fourth order Fornberg algorithm.
+/// \tparam         Direction Sign for centered, backward or forward 
+///                 differentiation.
+/// \tparam         Type Data type.
+/// \tparam         T Conversion type.
+/// \tparam         Function Function type taking a stencil offset.
+/// \param[in]      h Distance between stencil points.
+/// \param[in]      values Function returning the value at the given offset
+///                 in units of the distance.
+/// \return         Derivative.
+template <int Direction, typename Type, typename T, class Function> 
+inline Type Utility::fornberg(const Type h, Function&& values)
+{
+    static const int size = 9;
+    static const std::array<Type, size> centered({{T(1)/T(280), T(-4)/T(105), T(1)/T(5), T(-4)/T(5), T(0), T(4)/T(5), T(-1)/T(5), T(4)/T(105), T(-1)/T(280)}});
+    static const std::array<Type, size> forward({{T(-761)/T(280), T(8), T(-14), T(56)/T(3), T(-35)/T(2), T(56)/T(5), T(-14)/T(3), T(8)/T(7), T(-1)/T(8)}});
+    static const std::array<Type, size> backward({{T(761)/T(280), T(-8), T(14), T(-56)/T(3), T(35)/T(2), T(-56)/T(5), T(14)/T(3), T(-8)/T(7), T(1)/T(8)}});
+    Type result = Type();
+    if (Direction == 0) {
+        for (int k = 0; k < size/2; ++k) {
+            result += centered[k]*values(k-size/2)+centered[size-(k+1)]*values(size/2-k);
+        }
+        result += centered[size/2]*values(0);
+    } else {
+        for (int k = 0; k < size; ++k) {
+            result += (Direction > 0) ? (forward[size-(k+1)]*values(size-(k+1))) : (backward[size-(k+1)]*values(-(size-(k+1))));
+        }
+    }
+    return result/h;
+}
+
+// Savitzky-Golay stencil
+/// \brief          Savitzky-Golay stencil.
+/// \details        Combines the values at the nine stencil points with the 
+///                 coefficients of a fourth order Savitzky-Golay algorithm.
+/// \tparam         Derivative Order of the derivative.
+/// \tparam         Type Data type.
+/// \tparam         T Conversion type.
+/// \tparam         Function Function type taking a stencil offset.
+/// \param[in]      h Distance between stencil points.
+/// \param[in]      values Function returning the value at the given offset
+///                 in units of the distance.
+/// \return         Filtered derivative.
+template <int Derivative, typename Type, typename T, class Function> 
+inline Type Utility::savitzky(const Type h, Function&& values)
+{
+    static const int order = 4;
     static const std::array<Type, 4> normalization({{T(231), T(1188), T(462), T(198)}});
     static const std::array<Type, order*2+1> zeroth({{T(-21), T(14), T(39), T(54), T(59), T(54), T(39), T(14), T(-21)}});
     static const std::array<Type, order*2+1> first({{T(86), T(-142), T(-193), T(-126), T(0), T(126), T(193), T(142), T(-86)}});
     static const std::array<Type, order*2+1> second({{T(28), T(7), T(-8), T(-17), T(-20), T(-17), T(-8), T(7), T(28)}});
     static const std::array<Type, order*2+1> third({{T(-14), T(7), T(13), T(9), T(0), T(-9), T(-13), T(-7), T(14)}});
     static const std::array<Type, order*2+1> coeff = (Derivative == 0) ? (zeroth) : ((Derivative == 1) ? (first) : ((Derivative == 2) ? (second) : (third)));
-    const long long int n = std::min(x.size(), y.size());
-    const long long int i = std::distance(std::begin(x), std::upper_bound(std::begin(x), std::begin(x)+n, x0, [](const Type x1, const Type x2){return x1 < x2;}));
-    const long long int j = i+((n > 1)*((i <= 0)-(i >= n)));
-    const Type h = (n > 1) ? ((x[j]-x[j-1])*std::max(one, neighbourhood)) : (Type());
     Type result = Type();
-    if (n > 1) {
-        for (unsigned int k = 0; k < order; ++k) {
-            result += coeff[k]*interpolate(x0-(order-k)*h, x, y)+coeff[order+order-k]*interpolate(x0+(order-k)*h, x, y);
-        }
-        result += coeff[order]*interpolate(x0, x, y);
+    for (int k = 0; k < order; ++k) {
+        result += coeff[k]*values(k-order)+coeff[order+order-k]*values(order-k);
     }
+    result += coeff[order]*values(0);
     return result/(normalization[Derivative]*std::pow(h, Type(Derivative)));
 }
 // -------------------------------------------------------------------------- //
@@ -641,9 +1133,9 @@ template <int Direction, class Container, typename Type, class>
 Container Utility::derive(const Container& x, const Container& y, const unsigned int neighbourhood)
 {
     const unsigned int size = std::min(x.size(), y.size());
-    Container result(size);
-    parallelize(size, [=, &x, &y, &result, &neighbourhood](const unsigned int i){result[i] = differentiate<Direction>(x[i], x, y, neighbourhood);});
-    return result;  
+    Container x0(size);
+    std::copy(std::begin(x), std::begin(x)+size, std::begin(x0));
+    return differentiate<Direction>(x0, x, y, neighbourhood);
 }
 // -------------------------------------------------------------------------- //
 
@@ -683,9 +1175,16 @@ int Utility::example()
     // Parallelization
     std::cout<<std::endl;
     std::cout<<std::setw(width*2)<<"Parallelization : "                                                                 <<std::endl;
+    std::cout<<std::setw(width*2)<<"utility.pool().size() > 0 : "                                                       <<(utility.pool().size() > 0)<<std::endl;
     std::cout<<std::setw(width*2)<<"utility.parallelize<1>(42, [](unsigned int){;}) : "                                 <<utility.parallelize<1>(42, [](unsigned int){;})<<std::endl;
     std::cout<<std::setw(width*2)<<"utility.parallelize<1>(0., 42., 0.5, [](double){;}) : "                             <<utility.parallelize<1>(0., 42., 0.5, [](double){;})<<std::endl;
     std::cout<<std::setw(width*2)<<"utility.parallelize<1>(vector.begin(), vector.end(), [](int& d){d += 42;}) : "      <<utility.parallelize<1>(vector.begin(), vector.end(), [](int& d){d += 42;})<<std::endl;
+    std::cout<<std::setw(width*2)<<"utility.schedule<1>(42, [](unsigned int){;}) : "                                    <<utility.schedule<1>(42, [](unsigned int){;})<<std::endl;
+    std::cout<<std::setw(width*2)<<"utility.reduce(y.begin(), y.end()) : "                                              <<utility.reduce(y.begin(), y.end())<<std::endl;
+    std::cout<<std::setw(width*2)<<"utility.inclusive_scan(x.begin(), x.end(), x.begin()) : "                           <<utility.inclusive_scan(x.begin(), x.end(), x.begin())<<std::endl;
+    std::cout<<std::setw(width*2)<<"utility.exclusive_scan(x.begin(), x.end(), x.begin(), 42.) : "                      <<utility.exclusive_scan(x.begin(), x.end(), x.begin(), 42.)<<std::endl;
+    std::cout<<std::setw(width*2)<<"utility.compact(vector.begin(), vector.end(), 42) : "                               <<utility.compact(vector.begin(), vector.end(), 42)<<std::endl;
+    std::iota(x.begin(), x.end(), 0);
 
     // Geometry
     std::cout<<std::endl;
@@ -701,6 +1200,8 @@ int Utility::example()
     std::cout<<std::setw(width*2)<<"utility.spherify(cube, 2) : "                                                       <<utility.spherify(cube, 2)<<std::endl;
     std::cout<<std::setw(width*2)<<"utility.collide(cube, sphere) : "                                                   <<utility.collide(cube, sphere)<<std::endl;
     std::cout<<std::setw(width*2)<<"utility.collide(cube, cone) : "                                                     <<utility.collide(cube, cone)<<std::endl;
+    std::cout<<std::setw(width*2)<<"utility.classify(cube, sphere) : "                                                  <<utility.classify(cube, sphere)<<std::endl;
+    std::cout<<std::setw(width*2)<<"utility.classify(cube, cone) : "                                                    <<utility.classify(cube, cone)<<std::endl;
 
     // Interpolation
     std::cout<<std::endl;
@@ -710,6 +1211,8 @@ int Utility::example()
     std::cout<<std::setw(width)<<"utility.reinterpolate(x, x, y).size() : "     <<utility.reinterpolate(x, x, y).size()<<std::endl;
     std::cout<<std::setw(width)<<"utility.differentiate(0.42, x, y, 10) : "     <<utility.differentiate(0.42, x, y, 10)<<std::endl;
     std::cout<<std::setw(width)<<"utility.filter(0.42, x, y, 10) : "            <<utility.filter(0.42, x, y, 10)<<std::endl;
+    std::cout<<std::setw(width)<<"utility.differentiate(x, x, y, 10)[0] : "     <<utility.differentiate(x, x, y, 10)[0]<<std::endl;
+    std::cout<<std::setw(width)<<"utility.filter(x, x, y, 10)[0] : "            <<utility.filter(x, x, y, 10)[0]<<std::endl;
 
     // Evolution
     std::cout<<std::endl;
@@ -0,0 +1,381 @@
+/* ********************************* WRITER ********************************* */
+/*////////////////////////////////////////////////////////////////////////////*/
+// PROJECT :        RAYTRACING
+// TITLE :          Writer
+// DESCRIPTION :    Asynchronous file writer with bounded memory
+// AUTHOR(S) :      Vincent Reverdy (vince.rev@gmail.com)
+// CONTRIBUTIONS :  [Vincent Reverdy (2012-2013)]
+// LICENSE :        CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+/// \file           writer.h
+/// \brief          Asynchronous file writer with bounded memory
+/// \author         Vincent Reverdy (vince.rev@gmail.com)
+/// \date           2012-2013
+/// \copyright      CECILL-B License
+/*////////////////////////////////////////////////////////////////////////////*/
+#ifndef WRITER_H_INCLUDED
+#define WRITER_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/
+
+
+
+// ------------------------------ PREPROCESSOR ------------------------------ //
+// Include C++
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <tuple>
+#include <utility>
+// Include libs
+// Include project
+// Misc
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- CLASS --------------------------------- //
+// Asynchronous file writer with bounded memory
+/// \brief          Asynchronous file writer with bounded memory.
+/// \details        Background service writing files on behalf of computing
+///                 threads. Computing threads format their output in memory
+///                 and hand the resulting buffers to the writer, which
+///                 returns immediately. A dedicated thread owns all file
+///                 handles, writes consecutive buffers targeting the same
+///                 file through a single handle, and releases the memory of
+///                 each buffer once written. The amount of pending bytes is
+///                 bounded: when the filesystem falls behind, producers wait
+///                 for room instead of accumulating memory.
+class Writer final
+{
+    // Lifecycle
+    /// \name           Lifecycle
+    //@{
+    public:
+        explicit inline Writer(const unsigned long long int capacity = 1ULL << 28);
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+        inline ~Writer();
+    //@}
+
+    // Data
+    /// \name           Data
+    //@{
+    public:
+        inline unsigned long long int size();
+        inline unsigned long long int capacity() const;
+        inline unsigned long long int written();
+        inline unsigned int failures();
+        inline bool closed();
+    //@}
+
+    // Operations
+    /// \name           Operations
+    //@{
+    public:
+        inline bool push(const std::string& filename, std::string&& content, const bool append = false);
+        inline void flush();
+        inline void close();
+    //@}
+
+    // Service
+    /// \name           Service
+    //@{
+    protected:
+        inline void run();
+    //@}
+
+    // Test
+    /// \name           Test
+    //@{
+    public:
+        static int example();
+    //@}
+
+    // Data members
+    /// \name           Data members
+    //@{
+    protected:
+        std::deque<std::tuple<std::string, std::string, bool> > _requests;      ///< Pending requests : file name, content and append flag.
+        std::mutex _mutex;                                                      ///< Mutex protecting the requests and the counters.
+        std::condition_variable _condition;                                     ///< Signal of pushed, written or closed.
+        unsigned long long int _capacity;                                       ///< Maximum number of pending bytes.
+        unsigned long long int _size;                                           ///< Number of pending bytes.
+        unsigned long long int _written;                                        ///< Number of written bytes.
+        unsigned int _failures;                                                 ///< Number of failed requests.
+        bool _busy;                                                             ///< Writing flag of the service thread.
+        bool _closed;                                                           ///< Closing flag.
+        std::thread _thread;                                                    ///< Service thread.
+    //@}
+};
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- LIFECYCLE -------------------------------- //
+// Explicit constructor
+/// \brief          Explicit constructor.
+/// \details        Constructs an open writer and starts its service thread.
+/// \param[in]      capacity Maximum number of pending bytes.
+inline Writer::Writer(const unsigned long long int capacity)
+: _requests()
+, _mutex()
+, _condition()
+, _capacity(std::max(1ULL, capacity))
+, _size(0)
+, _written(0)
+, _failures(0)
+, _busy(false)
+, _closed(false)
+, _thread()
+{
+    _thread = std::thread(&Writer::run, this);
+}
+
+// Destructor
+/// \brief          Destructor.
+/// \details        Writes the pending requests and stops the service thread.
+inline Writer::~Writer()
+{
+    close();
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- DATA ---------------------------------- //
+// Size
+/// \brief          Size.
+/// \details        Returns the number of bytes pushed but not yet written.
+/// \return         Number of pending bytes.
+inline unsigned long long int Writer::size()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _size;
+}
+
+// Capacity
+/// \brief          Capacity.
+/// \details        Returns the maximum number of pending bytes.
+/// \return         Capacity of the writer.
+inline unsigned long long int Writer::capacity() const
+{
+    return _capacity;
+}
+
+// Written
+/// \brief          Written.
+/// \details        Returns the number of bytes already written.
+/// \return         Number of written bytes.
+inline unsigned long long int Writer::written()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _written;
+}
+
+// Failures
+/// \brief          Failures.
+/// \details        Returns the number of requests that could not be written.
+/// \return         Number of failed requests.
+inline unsigned int Writer::failures()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _failures;
+}
+
+// Closed
+/// \brief          Closed.
+/// \details        Checks whether the writer has been closed.
+/// \return         True if closed, false otherwise.
+inline bool Writer::closed()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _closed;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ------------------------------- OPERATIONS ------------------------------- //
+// Push
+/// \brief          Push.
+/// \details        Hands a buffer to the service thread. The call returns as
+///                 soon as the buffer has been queued, and only waits if the
+///                 pending bytes would exceed the capacity. A buffer larger
+///                 than the capacity is accepted once nothing else is
+///                 pending.
+/// \param[in]      filename File name.
+/// \param[in]      content Content to be written, moved into the writer.
+/// \param[in]      append Appends to the file if true, replaces it
+///                 otherwise.
+/// \return         True if the buffer has been queued, false if the writer
+///                 has been closed.
+inline bool Writer::push(const std::string& filename, std::string&& content, const bool append)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    const unsigned long long int length = content.size();
+    bool ok = false;
+    while ((!_closed) && (_size > 0) && (_size+length > _capacity)) {
+        _condition.wait(lock);
+    }
+    if (!_closed) {
+        _requests.emplace_back(filename, std::move(content), append);
+        _size += length;
+        ok = true;
+    }
+    lock.unlock();
+    _condition.notify_all();
+    return ok;
+}
+
+// Flush
+/// \brief          Flush.
+/// \details        Waits until all the buffers pushed so far have been
+///                 written and their files closed.
+inline void Writer::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while ((!_requests.empty()) || (_busy)) {
+        _condition.wait(lock);
+    }
+}
+
+// Close
+/// \brief          Close.
+/// \details        Closes the writer, waits for the pending buffers to be
+///                 written and stops the service thread. No buffer can be
+///                 pushed anymore.
+inline void Writer::close()
+{
+    _mutex.lock();
+    _closed = true;
+    _mutex.unlock();
+    _condition.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// --------------------------------- SERVICE -------------------------------- //
+// Run
+/// \brief          Run.
+/// \details        Body of the service thread. Takes all pending requests at
+///                 once, writes them in order while keeping the current file
+///                 open as long as the following requests append to it, and
+///                 closes the last file before waiting for new requests.
+inline void Writer::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::deque<std::tuple<std::string, std::string, bool> > batch;
+    std::ofstream stream;
+    std::string current;
+    unsigned long long int length = 0;
+    unsigned int failures = 0;
+    while ((!_closed) || (!_requests.empty())) {
+        while ((!_closed) && (_requests.empty())) {
+            _condition.wait(lock);
+        }
+        batch.swap(_requests);
+        _busy = !batch.empty();
+        lock.unlock();
+        length = 0;
+        failures = 0;
+        for (auto it = batch.begin(); it != batch.end(); ++it) {
+            if ((!std::get<2>(*it)) || (std::get<0>(*it) != current) || (!stream.is_open())) {
+                if (stream.is_open()) {
+                    stream.close();
+                    failures += stream.fail();
+                }
+                current = std::get<0>(*it);
+                stream.clear();
+                stream.open(current, (std::get<2>(*it)) ? (std::ios::out | std::ios::binary | std::ios::app) : (std::ios::out | std::ios::binary | std::ios::trunc));
+            }
+            stream.write(std::get<1>(*it).data(), std::get<1>(*it).size());
+            failures += !stream.good();
+            length += std::get<1>(*it).size();
+        }
+        batch.clear();
+        lock.lock();
+        if ((_requests.empty()) && (stream.is_open())) {
+            lock.unlock();
+            stream.close();
+            failures += stream.fail();
+            current.clear();
+            lock.lock();
+        }
+        _size -= length;
+        _written += length;
+        _failures += failures;
+        _busy = false;
+        _condition.notify_all();
+    }
+}
+// -------------------------------------------------------------------------- //
+
+
+
+// ---------------------------------- TEST ---------------------------------- //
+// Example function
+/// \brief          Example function.
+/// \details        Tests and demonstrates the use of Writer.
+/// \return         0 if no error.
+int Writer::example()
+{
+    // Initialize
+    std::cout<<"BEGIN = Writer::example()"<<std::endl;
+    std::cout<<std::boolalpha<<std::left;
+    const unsigned int width = 40;
+    const std::string filename = "writer_example.txt";
+    std::ifstream stream;
+    std::string line;
+
+    // Construction
+    Writer writer(16);
+
+    // Lifecycle
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Lifecycle : "                                                                       <<std::endl;
+    std::cout<<std::setw(width*2)<<"Writer().capacity() : "                                                             <<Writer().capacity()<<std::endl;
+    std::cout<<std::setw(width*2)<<"Writer(16).capacity() : "                                                           <<Writer(16).capacity()<<std::endl;
+
+    // Operations
+    std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"Operations : "                                                                      <<std::endl;
+    std::cout<<std::setw(width*2)<<"writer.push(filename, \"first line\\n\") : "                                        <<writer.push(filename, std::string("first line\n"))<<std::endl;
+    std::cout<<std::setw(width*2)<<"writer.push(filename, \"second line\\n\", true) : "                                 <<writer.push(filename, std::string("second line\n"), true)<<std::endl;
+    std::cout<<std::setw(width*2)<<"writer.flush() : "                                                                  ; writer.flush(); std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"writer.size() : "                                                                   <<writer.size()<<std::endl;
+    std::cout<<std::setw(width*2)<<"writer.written() : "                                                                <<writer.written()<<std::endl;
+    std::cout<<std::setw(width*2)<<"writer.failures() : "                                                               <<writer.failures()<<std::endl;
+    stream.open(filename);
+    std::getline(stream, line);
+    std::getline(stream, line);
+    stream.close();
+    std::remove(filename.c_str());
+    std::cout<<std::setw(width*2)<<"second line read back : "                                                           <<line<<std::endl;
+    std::cout<<std::setw(width*2)<<"writer.close() : "                                                                  ; writer.close(); std::cout<<std::endl;
+    std::cout<<std::setw(width*2)<<"writer.closed() : "                                                                 <<writer.closed()<<std::endl;
+    std::cout<<std::setw(width*2)<<"writer.push(filename, \"third line\\n\") : "                                        <<writer.push(filename, std::string("third line\n"))<<std::endl;
+
+    // Finalize
+    std::cout<<std::noboolalpha<<std::right<<std::endl;
+    std::cout<<"END = Writer::example()"<<std::endl;
+    return 0;
+}
+// -------------------------------------------------------------------------- //
+
+
+
+/*////////////////////////////////////////////////////////////////////////////*/
+#endif // WRITER_H_INCLUDED
+/*////////////////////////////////////////////////////////////////////////////*/